@@ -102,6 +102,26 @@ public:
         updateCameraVectors();
     }
 
+    // restores a state saved from Position, Yaw, Pitch and Zoom, e.g. by an input recording
+    void SetState(const glm::vec3 &position, float yaw, float pitch, float zoom)
+    {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        Zoom = zoom;
+        updateCameraVectors();
+    }
+
+    // places the camera at position facing target, the Euler angles follow so mouse look continues from there
+    void LookAt(const glm::vec3 &position, const glm::vec3 &target)
+    {
+        Position = position;
+        glm::vec3 front = glm::normalize(target - position);
+        Pitch = glm::degrees(asin(glm::clamp(front.y, -1.0f, 1.0f)));
+        Yaw = glm::degrees(atan2(front.z, front.x));
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
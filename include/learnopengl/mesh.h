@@ -7,6 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/DebugViews.h>
+#include <rg/Lod.h>
+#include <rg/MeshSimplifier.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/Trace.h>
 
 #include <string>
 #include <vector>
@@ -27,6 +33,33 @@ struct Vertex {
 
 
 
+// per-instance attributes, laid out to match locations 5-12 of the INSTANCED shader variants
+struct InstanceData {
+    // model matrix (locations 5-8)
+    glm::mat4 ModelMatrix;
+    // normal matrix (locations 9-11)
+    glm::mat3 NormalMatrix;
+    // tint multiplied with the lit colour (location 12)
+    glm::vec4 Tint;
+};
+
+inline InstanceData makeInstance(const glm::mat4 &model, const glm::vec4 &tint = glm::vec4(1.0f))
+{
+    InstanceData instance;
+    instance.ModelMatrix = model;
+    instance.NormalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+    instance.Tint = tint;
+    return instance;
+}
+
+// one level of detail, a range of the mesh's element buffer
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    // object-space distance the simplified surface may deviate from the full detail one
+    float error;
+};
+
 struct Texture {
     unsigned int id;
     string type;
@@ -37,36 +70,55 @@ class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
-    vector<unsigned int> indices;
+    // the full detail indices followed by the coarser levels, as uploaded to the element buffer,
+    // lods[0] covers the indices the mesh was created with
+    vector<unsigned int> elements;
     vector<Texture>      textures;
+    // lods[0] is the full detail mesh, each further level holds roughly half the triangles
+    vector<MeshLod>      lods;
+    // lods[i].error, kept separately for rg::selectLod
+    vector<float>        lodErrors;
 
     unsigned int VAO;
+    // bytes of the vertex and element buffers setupMesh uploaded
+    size_t gpuBytes = 0;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, lodLevels > 1 runs the simplifier to build the coarser levels
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, unsigned int lodLevels = 1)
     {
         this->vertices = vertices;
-        this->indices = indices;
         this->textures = textures;
 
+        // the coarser levels are appended to the element buffer after the full detail indices
+        elements.swap(indices);
+        generateLods(lodLevels, elements);
+
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(elements);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+
+    // bytes of the geometry the mesh keeps on the CPU after the upload
+    size_t CpuBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + elements.capacity() * sizeof(unsigned int) +
+               lods.capacity() * sizeof(MeshLod) + lodErrors.capacity() * sizeof(float);
+    }
+
+    // the sampler every texture is bound to, prefix + type + N where N counts the textures of that type
+    // from 1, e.g. texture_diffuse1
+    void SamplerNames(vector<string> &names) const
     {
-        // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        names.resize(textures.size());
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            const string &name = textures[i].type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if(name == "texture_specular")
@@ -75,30 +127,132 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            names[i] = glslIdentifierPrefix + name + number;
         }
+    }
 
-
+    // render the mesh at level of detail lod
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        RG_PROFILE_ZONE("Mesh::Draw");
+        bindTextures(shader);
 
         // draw mesh
+        const MeshLod &level = lods[lod];
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        rg::debugViews().BeginDraw(shader, this, lod);
+        glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void*)(level.firstIndex * sizeof(unsigned int)));
+        rg::debugViews().EndDraw();
         glBindVertexArray(0);
+        rg::countDraw(level.indexCount / 3);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render instanceCount copies of the mesh, per-instance attributes are sourced from instanceVBO
+    void DrawInstanced(Shader &shader, unsigned int instanceVBO, unsigned int instanceCount, unsigned int lod = 0)
+    {
+        RG_PROFILE_ZONE("Mesh::DrawInstanced");
+        bindTextures(shader);
+
+        const MeshLod &level = lods[lod];
+        glBindVertexArray(VAO);
+        if (instanceVBO != boundInstanceVBO)
+            setupInstanceAttributes(instanceVBO);
+        rg::debugViews().BeginDraw(shader, this, lod);
+        glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                                (void*)(level.firstIndex * sizeof(unsigned int)), instanceCount);
+        rg::debugViews().EndDraw();
+        glBindVertexArray(0);
+        rg::countDraw(level.indexCount / 3, instanceCount);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
 private:
     // render data
     unsigned int VBO, EBO;
+    unsigned int boundInstanceVBO = 0;
+
+    // sampler names of the textures, reused between draws
+    vector<string> samplerNames;
+
+    void bindTextures(Shader &shader)
+    {
+        SamplerNames(samplerNames);
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
+            rg::countUniformUpload();
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+        // the textures plus the vertex array bound by the caller
+        rg::countBindCalls(textures.size() + 1);
+    }
+
+    // hooks the instance buffer into this mesh's VAO, expects the VAO to be bound
+    void setupInstanceAttributes(unsigned int instanceVBO)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        // model matrix, one attribute per column
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, ModelMatrix) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        // normal matrix
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glEnableVertexAttribArray(9 + i);
+            glVertexAttribPointer(9 + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, NormalMatrix) + i * sizeof(glm::vec3)));
+            glVertexAttribDivisor(9 + i, 1);
+        }
+        // tint
+        glEnableVertexAttribArray(12);
+        glVertexAttribPointer(12, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, Tint));
+        glVertexAttribDivisor(12, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        boundInstanceVBO = instanceVBO;
+    }
+
+    // builds lods with the quadric simplifier, every level halves the triangle count of the previous one.
+    // Each pass only measures its error against the level it started from, so the error of a level
+    // is the sum over the passes that led to it, an upper bound on its distance to the full mesh.
+    void generateLods(unsigned int lodLevels, vector<unsigned int> &elements)
+    {
+        lods.push_back({0, (unsigned int)elements.size(), 0.0f});
+        lodErrors.push_back(0.0f);
+        if (lodLevels <= 1 || elements.size() < 3 * 64)
+            return;
+
+        rg::TraceScope trace("generate lods");
+        rg::MeshSimplifier<Vertex> simplifier(vertices);
+        vector<unsigned int> previous = elements;
+        float error = 0.0f;
+        for (unsigned int level = 1; level < lodLevels; level++)
+        {
+            float levelError;
+            vector<unsigned int> simplified = simplifier.simplify(previous, previous.size() / 2, levelError);
+            // stop once the simplifier cannot make meaningful progress anymore
+            if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+                break;
+            error += levelError;
+            lods.push_back({(unsigned int)elements.size(), (unsigned int)simplified.size(), error});
+            lodErrors.push_back(error);
+            elements.insert(elements.end(), simplified.begin(), simplified.end());
+            previous.swap(simplified);
+        }
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const vector<unsigned int> &elements)
     {
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
@@ -114,7 +268,8 @@ private:
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(unsigned int), &elements[0], GL_STATIC_DRAW);
+        gpuBytes = vertices.size() * sizeof(Vertex) + elements.size() * sizeof(unsigned int);
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -12,11 +12,17 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/Frustum.h>
+#include <rg/MemoryStats.h>
+#include <rg/Profiler.h>
+#include <rg/TextureBudget.h>
+#include <rg/Trace.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <vector>
 using namespace std;
@@ -33,72 +39,71 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    unsigned int lodLevels;
+    // object-space bounding sphere of all meshes
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    // and their object-space bounding box
+    glm::vec3 boundsMinimum = glm::vec3(0.0f);
+    glm::vec3 boundsMaximum = glm::vec3(0.0f);
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // lodLevels > 1 simplifies every mesh on import into that many levels of detail
+    Model(string const &path, bool gamma = false, unsigned int lodLevels = 1) : gammaCorrection(gamma), lodLevels(lodLevels)
     {
+        rg::TraceScope trace("load model", path);
         loadModel(path);
+        computeBounds();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // draws the model, and thus all its meshes, at the levels of detail of the placement being drawn
+    void Draw(Shader &shader, const rg::LodLevels &lods = rg::LodLevels())
     {
+        RG_PROFILE_ZONE("Model::Draw");
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, rg::lodLevel(lods, i));
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
-        }
-    }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // draws every instance of the model with one glDrawElementsInstanced call per mesh,
+    // the instance data is streamed into a single buffer shared by all meshes
+    void DrawInstanced(Shader &shader, const vector<InstanceData> &instances)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        RG_PROFILE_ZONE("Model::DrawInstanced");
+        if (instances.empty())
             return;
-        }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        GLsizeiptr size = instances.size() * sizeof(InstanceData);
+        // orphan the previous storage so we never wait on the GPU still reading last frame's instances
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, &instances[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceVBO, instances.size());
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // picks the level of detail for every mesh of the placement at model from the screen-space size of
+    // its simplification error. lods holds the placement's levels of the previous frame, which the
+    // hysteresis starts from, and receives the new ones.
+    void SelectLod(const glm::mat4 &model, const rg::LodSettings &settings, rg::LodLevels &lods) const
     {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
-        {
-            // the node object only contains indices to index the actual objects in the scene.
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
-        }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
-        {
-            processNode(node->mChildren[i], scene);
-        }
-
+        glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+        float scale = rg::maxAxisScale(model);
+        float distance = std::max(glm::length(center - settings.cameraPosition) - boundsRadius * scale, 0.0f);
+        lods.resize(meshes.size(), 0);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            lods[i] = rg::selectLod(meshes[i].lodErrors, lods[i], scale, distance, settings);
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
-    {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+    // the assimp post-processing every model is imported with
+    static constexpr unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
-        // walk through each of the mesh's vertices
+    // walks through each of the mesh's vertices and appends them in our vertex layout
+    static void ConvertVertices(const aiMesh *mesh, vector<Vertex> &vertices)
+    {
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
             Vertex vertex;
@@ -140,9 +145,94 @@ private:
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 
             vertices.push_back(vertex);
+        }
+    }
+
+    void SetShaderTextureNamePrefix(std::string prefix) {
+        for (Mesh& mesh: meshes) {
+            mesh.glslIdentifierPrefix = prefix;
+        }
+    }
+private:
+    unsigned int instanceVBO = 0;
+
+    void computeBounds()
+    {
+        if (meshes.empty())
+            return;
+        glm::vec3 minimum(std::numeric_limits<float>::max());
+        glm::vec3 maximum(-std::numeric_limits<float>::max());
+        for (const Mesh &mesh : meshes)
+            for (const Vertex &vertex : mesh.vertices)
+            {
+                minimum = glm::min(minimum, vertex.Position);
+                maximum = glm::max(maximum, vertex.Position);
+            }
+        boundsCenter = (minimum + maximum) * 0.5f;
+        boundsRadius = glm::length(maximum - boundsCenter);
+        boundsMinimum = minimum;
+        boundsMaximum = maximum;
+    }
 
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    void loadModel(string const &path)
+    {
+        // read file via ASSIMP
+        Assimp::Importer importer;
+        rg::TraceScope importTrace("assimp import", path);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
+        importTrace.End();
+        // check for errors
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return;
+        }
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // process ASSIMP's root node recursively
+        processNode(scene->mRootNode, scene);
 
+        // the imported scene is only needed until the meshes are built
+        aiMemoryInfo sceneMemory;
+        importer.GetMemoryRequirements(sceneMemory);
+        rg::AssetMemory &memory = rg::memoryStats().ModelEntry(path);
+        memory.decoderScratchBytes = std::max<size_t>(memory.decoderScratchBytes, sceneMemory.total);
+        for (const Mesh &mesh : meshes)
+        {
+            memory.gpuBufferBytes += mesh.gpuBytes;
+            memory.cpuGeometryBytes += mesh.CpuBytes();
+        }
+    }
+
+    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode *node, const aiScene *scene)
+    {
+        // process each mesh located at the current node
+        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        {
+            // the node object only contains indices to index the actual objects in the scene.
+            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            meshes.push_back(processMesh(mesh, scene));
         }
+        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        {
+            processNode(node->mChildren[i], scene);
+        }
+
+    }
+
+    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    {
+        // data to fill
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<Texture> textures;
+
+        ConvertVertices(mesh, vertices);
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -179,7 +269,7 @@ private:
 
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, lodLevels);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -221,14 +311,19 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
+    rg::TraceScope trace("load texture", filename);
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
+    rg::TraceScope decodeTrace("stbi_load");
     unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    decodeTrace.End();
     if (data)
     {
+        // leaves out the top mip levels the texture feedback never saw on screen
+        rg::textureBudget().Apply(filename, data, width, height, nrComponents);
         GLenum format;
         if (nrComponents == 1)
             format = GL_RED;
@@ -238,8 +333,15 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        {
+            rg::TraceScope uploadTrace("glTexImage2D");
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        }
+        {
+            rg::TraceScope mipmapTrace("glGenerateMipmap");
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        rg::memoryStats().AddTexture(textureID, filename, "texture", width, height, nrComponents, true);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
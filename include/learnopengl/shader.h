@@ -5,10 +5,18 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <rg/ProgramCache.h>
+#include <rg/RenderStats.h>
+#include <rg/Trace.h>
+
+class ShaderBatch;
+
 class Shader
 {
 public:
@@ -16,9 +24,20 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : Shader(vertexPath, fragmentPath, std::vector<std::string>(), geometryPath)
+    {
+    }
+    // same as above, every name in defines is injected as "#define NAME" right after the #version line
+    // of each stage, used to compile permutations of one source file (see rg::ShaderPermutations).
+    // With a batch the program is only submitted to the driver, ID is valid but the program must not
+    // be used before batch->finish() (or poll() returning true).
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines,
+           const char* geometryPath = nullptr, ShaderBatch *batch = nullptr)
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
+        rg::TraceScope trace("submit shader", traceDetail(vertexPathString, defines));
 
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
@@ -64,114 +83,201 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        if (!defines.empty())
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            vertexCode = injectDefines(vertexCode, defines);
+            fragmentCode = injectDefines(fragmentCode, defines);
+            if(geometryPath != nullptr)
+                geometryCode = injectDefines(geometryCode, defines);
         }
+        // 2. try the program binary cache
+        cacheKey = rg::programCache().key({vertexCode, fragmentCode, geometryCode});
+        ID = rg::programCache().load(cacheKey);
+        if (ID != 0)
+            return;
+        vertexFile = vertexPathString;
+        fragmentFile = fragmentPathString;
+        if(geometryPath != nullptr)
+            geometryFile = geometryPath;
+        // 3. submit the compile and link, the status is only queried in finish() so the driver
+        // is free to work on them in the background
+        compileStart = std::chrono::steady_clock::now();
+        stages[0] = submitStage(GL_VERTEX_SHADER, vertexCode);
+        stages[1] = submitStage(GL_FRAGMENT_SHADER, fragmentCode);
+        if(geometryPath != nullptr)
+            stages[2] = submitStage(GL_GEOMETRY_SHADER, geometryCode);
         // shader Program
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
+        for (unsigned int stage : stages)
+        {
+            if (stage != 0)
+                glAttachShader(ID, stage);
+        }
+        rg::programCache().prepare(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        pending = true;
+        if (batch == nullptr)
+            finish();
+        else
+            submitToBatch(*batch);
+    }
+    // waits for a submitted program and reports its errors, does nothing if the program is finished
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (!pending)
+            return;
+        pending = false;
+        rg::TraceScope trace("finish shader", vertexFile);
+        bool compiled = checkCompileErrors(stages[0], "VERTEX", vertexFile);
+        compiled = checkCompileErrors(stages[1], "FRAGMENT", fragmentFile) && compiled;
+        if (stages[2] != 0)
+            compiled = checkCompileErrors(stages[2], "GEOMETRY", geometryFile) && compiled;
+        // a failed stage already explains the failed link
+        if (compiled)
+            checkCompileErrors(ID, "PROGRAM", vertexFile + " + " + fragmentFile);
+        rg::programCache().store(ID, cacheKey, std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - compileStart).count());
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        for (unsigned int &stage : stages)
+        {
+            if (stage != 0)
+                glDeleteShader(stage);
+            stage = 0;
+        }
+    }
+    // true once finish() would not block, always true without KHR_parallel_shader_compile
+    // ------------------------------------------------------------------------
+    bool completed() const
+    {
+        if (!pending || !GLAD_GL_KHR_parallel_shader_compile)
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
         glUseProgram(ID); 
+        rg::countBindCalls();
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
         glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
         glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
         glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::countUniformUpload();
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
         glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
         glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::countUniformUpload();
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
         glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
         glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::countUniformUpload();
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
         glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
         glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
         glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::countUniformUpload();
+    }
+
+    // inserts the defines after the #version line, #line keeps the compiler's line numbers matching the file,
+    // also used by tools/shader_stats.cpp to see exactly the source the driver gets
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string &code, const std::vector<std::string> &defines)
+    {
+        std::string::size_type versionEnd = 0;
+        if (code.compare(0, 8, "#version") == 0)
+            versionEnd = code.find('\n') + 1;
+        std::string header;
+        for (const std::string &define : defines)
+            header += "#define " + define + "\n";
+        header += versionEnd == 0 ? "#line 1\n" : "#line 2\n";
+        return code.substr(0, versionEnd) + header + code.substr(versionEnd);
     }
 
 private:
+    bool pending = false;
+    unsigned int stages[3] = {0, 0, 0};
+    std::string vertexFile;
+    std::string fragmentFile;
+    std::string geometryFile;
+    std::string cacheKey;
+    std::chrono::steady_clock::time_point compileStart;
+
+    static unsigned int submitStage(GLenum type, const std::string &code)
+    {
+        const char* source = code.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+    void submitToBatch(ShaderBatch &batch);
+    // the vertex source and its defines, names the program in the startup trace
+    static std::string traceDetail(const std::string &vertexPath, const std::vector<std::string> &defines)
+    {
+        std::string detail = vertexPath;
+        for (const std::string &define : defines)
+            detail += " " + define;
+        return detail;
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type, const std::string &file)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -181,7 +287,7 @@ private:
             if(!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << " in " << file << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
         else
@@ -190,9 +296,66 @@ private:
             if(!success)
             {
                 glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << " in " << file << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
+
+// Compiles many programs at once: shaders constructed with a batch only submit their compile and
+// link, the statuses are collected here afterwards. Drivers with KHR_parallel_shader_compile
+// work on the submitted programs on their own threads, others still avoid the stall between every
+// compile and its status query. Shaders must not move until they are finished.
+class ShaderBatch
+{
+public:
+    ShaderBatch() : start(std::chrono::steady_clock::now())
+    {
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    void add(Shader &shader)
+    {
+        pending.push_back(&shader);
+        submitted++;
+    }
+    // finishes the programs the driver is done with and returns true once none are left,
+    // only non-blocking with KHR_parallel_shader_compile
+    bool poll()
+    {
+        for (unsigned int i = 0; i < pending.size();)
+        {
+            if (pending[i]->completed())
+            {
+                pending[i]->finish();
+                pending[i] = pending.back();
+                pending.pop_back();
+            }
+            else
+                i++;
+        }
+        return pending.empty();
+    }
+    // blocks until every program is linked and reports the errors
+    void finish()
+    {
+        rg::TraceScope trace("finish shader batch");
+        for (Shader *shader : pending)
+            shader->finish();
+        pending.clear();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "SHADER_BATCH:: " << submitted << " programs compiled in " << elapsed << " ms"
+                  << (GLAD_GL_KHR_parallel_shader_compile ? " (parallel)" : "") << std::endl;
+    }
+private:
+    std::vector<Shader*> pending;
+    unsigned int submitted = 0;
+    std::chrono::steady_clock::time_point start;
+};
+
+inline void Shader::submitToBatch(ShaderBatch &batch)
+{
+    batch.add(*this);
+}
 #endif
@@ -0,0 +1,290 @@
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+#include <rg/CameraPath.h>
+#include <rg/GpuProfiler.h>
+#include <rg/InputRecording.h>
+#include <rg/PerfHud.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// command line of the headless benchmark mode:
+// project_base --headless [--width W] [--height H] [--warmup N] [--frames N] [--report PATH]
+//                          [--path CAMERA_PATH | --replay INPUT_RECORDING] [--texture-feedback PATH]
+//                          [--scene-sweep CSV_PATH]
+// --texture-budget PATH and --scene SPEC work with and without --headless
+struct BenchmarkSettings {
+    bool headless = false;
+    int width = 1280;
+    int height = 720;
+    unsigned int warmupFrames = 60;
+    unsigned int measuredFrames = 300;
+    std::string reportPath = "benchmark.json";
+    // the camera flies along this rg::CameraPath, unless a recording is replayed instead
+    std::string cameraPath = "resources/camera_paths/flythrough.txt";
+    std::string replayPath;
+    // writes the rg::TextureFeedback report of the run here
+    std::string textureFeedbackPath;
+    // loads the textures within this rg::TextureBudget
+    std::string textureBudgetPath;
+    // adds an rg::SyntheticScene, see parseSyntheticScene for the format
+    std::string sceneSpec;
+    // runs the rg::SceneSweep of the synthetic scene and writes its CSV here
+    std::string sceneSweepPath;
+};
+
+inline bool parseBenchmarkArgs(int argc, char **argv, BenchmarkSettings &settings) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            settings.headless = true;
+        } else if (arg == "--width" && hasValue) {
+            settings.width = std::atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            settings.height = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            settings.warmupFrames = (unsigned int) std::atoi(argv[++i]);
+        } else if (arg == "--frames" && hasValue) {
+            settings.measuredFrames = (unsigned int) std::atoi(argv[++i]);
+        } else if (arg == "--report" && hasValue) {
+            settings.reportPath = argv[++i];
+        } else if (arg == "--path" && hasValue) {
+            settings.cameraPath = argv[++i];
+        } else if (arg == "--replay" && hasValue) {
+            settings.replayPath = argv[++i];
+        } else if (arg == "--texture-feedback" && hasValue) {
+            settings.textureFeedbackPath = argv[++i];
+        } else if (arg == "--texture-budget" && hasValue) {
+            settings.textureBudgetPath = argv[++i];
+        } else if (arg == "--scene" && hasValue) {
+            settings.sceneSpec = argv[++i];
+        } else if (arg == "--scene-sweep" && hasValue) {
+            settings.sceneSweepPath = argv[++i];
+        } else {
+            std::cout << "ERROR::BENCHMARK:: unknown argument " << arg << "\n"
+                      << "usage: " << argv[0]
+                      << " [--headless] [--width W] [--height H] [--warmup N] [--frames N] [--report PATH]"
+                      << " [--path CAMERA_PATH | --replay INPUT_RECORDING] [--texture-feedback PATH]"
+                      << " [--texture-budget PATH] [--scene SPEC] [--scene-sweep CSV_PATH]"
+                      << std::endl;
+            return false;
+        }
+    }
+    if (settings.width <= 0 || settings.height <= 0 || settings.measuredFrames == 0) {
+        std::cout << "ERROR::BENCHMARK:: resolution and frame count have to be positive" << std::endl;
+        return false;
+    }
+    if (!settings.sceneSweepPath.empty() && !settings.headless) {
+        std::cout << "ERROR::BENCHMARK:: --scene-sweep needs --headless" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Color and depth/stencil renderbuffers the headless mode renders into instead of a window.
+class OffscreenTarget {
+public:
+    unsigned int framebuffer = 0;
+    int width = 0;
+    int height = 0;
+
+    OffscreenTarget() = default;
+    OffscreenTarget(const OffscreenTarget &) = delete;
+    OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+    ~OffscreenTarget() {
+        if (framebuffer == 0)
+            return;
+        glDeleteRenderbuffers(2, renderbuffers);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+
+    bool Create(int w, int h) {
+        width = w;
+        height = h;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete)
+            std::cout << "ERROR::BENCHMARK:: offscreen framebuffer is not complete" << std::endl;
+        return complete;
+    }
+
+    void Bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+private:
+    unsigned int renderbuffers[2] = {};
+};
+
+// Drives the headless run: every frame advances FIXED_TIMESTEP and places the camera on the camera
+// path (looping when the run is longer than the path) or at the next frame of an input recording,
+// so two runs render exactly the same frames. The first warmupFrames are rendered but not
+// measured, they cover shader and driver warm-up. Restart() runs the path again in the same process.
+class Benchmark {
+public:
+    explicit Benchmark(const BenchmarkSettings &settings) : settings(settings) {}
+
+    Benchmark(const Benchmark &) = delete;
+    Benchmark &operator=(const Benchmark &) = delete;
+
+    // reads the camera path or the recording
+    bool Load() {
+        if (!settings.replayPath.empty())
+            return recording.Load(settings.replayPath);
+        return path.Load(settings.cameraPath);
+    }
+
+    bool Running() const {
+        return frame < settings.warmupFrames + settings.measuredFrames;
+    }
+
+    bool Measuring() const {
+        return frame >= settings.warmupFrames;
+    }
+
+    void BeginFrame(Camera &camera) {
+        if (!recording.frames.empty()) {
+            recording.Apply(frame, camera);
+        } else {
+            float t = (float) frame * FIXED_TIMESTEP;
+            path.Apply(path.Duration() > 0.0f ? std::fmod(t, path.Duration()) : 0.0f, camera);
+        }
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    // starts over at the first warm-up frame, gpuFrame is the profiler's next frame number
+    void Restart(unsigned long long gpuFrame) {
+        frame = 0;
+        cpuFrameMs.clear();
+        firstGpuFrame = gpuFrame;
+    }
+
+    void EndFrame() {
+        if (Measuring()) {
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+            cpuFrameMs.push_back(elapsed.count());
+        }
+        frame++;
+    }
+
+    FrameTimePercentiles CpuFrameMs() const {
+        return framePercentiles(cpuFrameMs);
+    }
+
+    // the GPU timings come from the profiler's history, call profiler.Drain() first
+    FrameTimePercentiles GpuFrameMs(const GpuProfiler &profiler) const {
+        std::vector<float> gpuFrameMs;
+        for (const GpuFrameTiming &timing : profiler.History()) {
+            if (timing.frame >= firstGpuFrame + settings.warmupFrames)
+                gpuFrameMs.push_back((float) timing.gpuMs);
+        }
+        return framePercentiles(gpuFrameMs);
+    }
+
+    // the GPU timings come from the profiler's history, call profiler.Drain() first
+    bool WriteReport(const GpuProfiler &profiler, double loadMs) const {
+        std::ofstream out(settings.reportPath);
+        if (!out) {
+            std::cout << "ERROR::BENCHMARK:: could not write " << settings.reportPath << std::endl;
+            return false;
+        }
+
+        std::vector<float> gpuFrameMs;
+        std::vector<std::string> passOrder;
+        std::map<std::string, std::vector<float>> passMs;
+        for (const GpuFrameTiming &timing : profiler.History()) {
+            if (timing.frame < firstGpuFrame + settings.warmupFrames)
+                continue;
+            gpuFrameMs.push_back((float) timing.gpuMs);
+            for (const GpuPassTiming &pass : timing.passes) {
+                std::vector<float> &times = passMs[pass.name];
+                if (times.empty())
+                    passOrder.push_back(pass.name);
+                times.push_back((float) pass.gpuMs);
+            }
+        }
+
+        const char *renderer = (const char *) glGetString(GL_RENDERER);
+        const char *version = (const char *) glGetString(GL_VERSION);
+        out << "{\n"
+            << "  \"renderer\": " << jsonString(renderer ? renderer : "") << ",\n"
+            << "  \"version\": " << jsonString(version ? version : "") << ",\n"
+            << "  \"width\": " << settings.width << ",\n"
+            << "  \"height\": " << settings.height << ",\n"
+            << "  \"warmup_frames\": " << settings.warmupFrames << ",\n"
+            << "  \"measured_frames\": " << cpuFrameMs.size() << ",\n"
+            << "  \"gpu_frames\": " << gpuFrameMs.size() << ",\n"
+            << "  \"dropped_gpu_frames\": " << profiler.droppedFrames << ",\n"
+            << "  \"load_ms\": " << loadMs << ",\n"
+            << "  \"cpu_frame_ms\": " << jsonPercentiles(framePercentiles(cpuFrameMs)) << ",\n"
+            << "  \"gpu_frame_ms\": " << jsonPercentiles(framePercentiles(gpuFrameMs)) << ",\n"
+            << "  \"passes\": [";
+        for (size_t i = 0; i < passOrder.size(); i++) {
+            const std::vector<float> &times = passMs.at(passOrder[i]);
+            out << (i ? "," : "") << "\n    {\"name\": " << jsonString(passOrder[i]) << ", \"frames\": " << times.size()
+                << ", \"gpu_ms\": " << jsonPercentiles(framePercentiles(times)) << "}";
+        }
+        out << "\n  ]\n}\n";
+        std::cout << "BENCHMARK:: wrote " << settings.reportPath << std::endl;
+        return true;
+    }
+
+    // value quoted and escaped for a JSON report
+    static std::string jsonString(const std::string &value) {
+        std::string quoted = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            if ((unsigned char) c >= 0x20)
+                quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+private:
+    BenchmarkSettings settings;
+    CameraPath path;
+    InputRecording recording;
+    unsigned int frame = 0;
+    // GpuFrameTiming::frame of the first frame since the last Restart()
+    unsigned long long firstGpuFrame = 0;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<float> cpuFrameMs;
+
+    static std::string jsonPercentiles(const FrameTimePercentiles &percentiles) {
+        return "{\"mean\": " + std::to_string(percentiles.mean) + ", \"p50\": " + std::to_string(percentiles.p50) +
+               ", \"p95\": " + std::to_string(percentiles.p95) + ", \"p99\": " + std::to_string(percentiles.p99) +
+               ", \"max\": " + std::to_string(percentiles.max) + "}";
+    }
+};
+
+};
+#endif //PROJECT_BASE_BENCHMARK_H
@@ -0,0 +1,115 @@
+#ifndef PROJECT_BASE_CAMERAPATH_H
+#define PROJECT_BASE_CAMERAPATH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+struct CameraKeyframe {
+    // seconds from the start of the path
+    float time = 0.0f;
+    glm::vec3 position = glm::vec3(0.0f);
+    // the point the camera looks at
+    glm::vec3 target = glm::vec3(0.0f, 0.0f, -1.0f);
+};
+
+// A camera flythrough through keyframes, the position and the look-at target are both
+// interpolated with a Catmull-Rom spline so the camera passes every keyframe without corners.
+// The end keyframes are repeated as the missing outer control points.
+//
+// Path files hold one keyframe per line: time position.x position.y position.z target.x target.y target.z,
+// lines starting with # are comments.
+class CameraPath {
+public:
+    std::vector<CameraKeyframe> keyframes;
+
+    bool Load(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::CAMERA_PATH:: could not read " << path << std::endl;
+            return false;
+        }
+        keyframes.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream fields(line);
+            CameraKeyframe keyframe;
+            fields >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+                   >> keyframe.target.x >> keyframe.target.y >> keyframe.target.z;
+            if (!fields) {
+                std::cout << "ERROR::CAMERA_PATH:: malformed keyframe " << keyframes.size() << " in " << path
+                          << std::endl;
+                return false;
+            }
+            keyframes.push_back(keyframe);
+        }
+        std::stable_sort(keyframes.begin(), keyframes.end(), [](const CameraKeyframe &a, const CameraKeyframe &b) {
+            return a.time < b.time;
+        });
+        if (keyframes.size() < 2) {
+            std::cout << "ERROR::CAMERA_PATH:: " << path << " needs at least two keyframes" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    float Duration() const {
+        return keyframes.empty() ? 0.0f : keyframes.back().time;
+    }
+
+    // position and target at time t, clamped to the ends of the path
+    void Evaluate(float t, glm::vec3 &position, glm::vec3 &target) const {
+        if (keyframes.size() == 1 || t <= keyframes.front().time) {
+            position = keyframes.front().position;
+            target = keyframes.front().target;
+            return;
+        }
+        if (t >= keyframes.back().time) {
+            position = keyframes.back().position;
+            target = keyframes.back().target;
+            return;
+        }
+        size_t next = std::upper_bound(keyframes.begin(), keyframes.end(), t,
+                                       [](float time, const CameraKeyframe &keyframe) {
+                                           return time < keyframe.time;
+                                       }) - keyframes.begin();
+        size_t current = next - 1;
+        const CameraKeyframe &k0 = keyframes[current > 0 ? current - 1 : current];
+        const CameraKeyframe &k1 = keyframes[current];
+        const CameraKeyframe &k2 = keyframes[next];
+        const CameraKeyframe &k3 = keyframes[std::min(next + 1, keyframes.size() - 1)];
+        float span = k2.time - k1.time;
+        float u = span > 0.0f ? (t - k1.time) / span : 0.0f;
+        position = catmullRom(k0.position, k1.position, k2.position, k3.position, u);
+        target = catmullRom(k0.target, k1.target, k2.target, k3.target, u);
+    }
+
+    void Apply(float t, Camera &camera) const {
+        glm::vec3 position, target;
+        Evaluate(t, position, target);
+        camera.LookAt(position, target);
+    }
+
+private:
+    static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3,
+                                float u) {
+        float u2 = u * u;
+        float u3 = u2 * u;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2 +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+    }
+};
+
+};
+#endif //PROJECT_BASE_CAMERAPATH_H
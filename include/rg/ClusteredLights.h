@@ -0,0 +1,325 @@
+#ifndef PROJECT_BASE_CLUSTEREDLIGHTS_H
+#define PROJECT_BASE_CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+// a point light, or a spot light when spot is set, with the attenuation terms the shaders use
+struct ClusterLight {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    bool spot = false;
+    float cutOff = 1.0f;
+    float outerCutOff = 0.0f;
+
+    float constant = 1.0f;
+    float linear = 0.09f;
+    float quadratic = 0.032f;
+
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(1.0f);
+};
+
+// distance at which the light's brightest channel falls under threshold
+inline float lightRadius(const ClusterLight &light, float threshold) {
+    glm::vec3 strongest = glm::max(glm::max(light.ambient, light.diffuse), light.specular);
+    float brightest = std::max(strongest.x, std::max(strongest.y, strongest.z));
+    // solve constant + linear * d + quadratic * d^2 = brightest / threshold
+    float c = light.constant - brightest / threshold;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic <= 0.0f)
+        return light.linear > 0.0f ? -c / light.linear : 1e30f;
+    return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+// writes the five RGBA32F texels CalcClusteredLights and deferred_light.fs read for a light
+inline void packLight(const ClusterLight &light, float radius, glm::vec4 *texels) {
+    texels[0] = glm::vec4(light.position, radius);
+    texels[1] = glm::vec4(light.ambient, light.constant);
+    texels[2] = glm::vec4(light.diffuse, light.linear);
+    texels[3] = glm::vec4(light.specular, light.quadratic);
+    if (light.spot) {
+        float coneScale = 1.0f / std::max(light.cutOff - light.outerCutOff, 1e-4f);
+        texels[4] = glm::vec4(glm::normalize(light.direction) * coneScale, -light.outerCutOff * coneScale);
+    } else {
+        texels[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+// Clustered forward lighting: the view frustum is split into TILES_X x TILES_Y screen tiles and
+// SLICES logarithmic depth slices. Every frame the lights are binned into the clusters their
+// attenuation radius touches (slices are spread over the thread pool) and uploaded into texture
+// buffers, the LIGHT_CLUSTERED shader permutations then only loop over their cluster's list.
+class ClusteredLights {
+public:
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    // lights past this in one cluster are dropped and counted in droppedLights
+    static const unsigned int MAX_LIGHTS_PER_CLUSTER = 256;
+    // texels of RGBA32F per light, has to match CalcClusteredLights
+    static const unsigned int LIGHT_TEXELS = 5;
+
+    std::vector<ClusterLight> lights;
+    // a light is binned up to where its intensity drops to this
+    float threshold = 5.0f / 256.0f;
+
+    // statistics of the last Update
+    unsigned int lightIndexCount = 0;
+    unsigned int maxClusterLights = 0;
+    unsigned int droppedLights = 0;
+
+    ClusteredLights() = default;
+    ClusteredLights(const ClusteredLights &) = delete;
+    ClusteredLights &operator=(const ClusteredLights &) = delete;
+
+    // bins and uploads the lights for a perspective camera with the given view matrix
+    void Update(const glm::mat4 &view, float fovY, float aspect, float near, float far,
+                unsigned int viewportWidth, unsigned int viewportHeight) {
+        setupBuffers();
+        if (fovY != this->fovY || aspect != this->aspect || near != this->near || far != this->far)
+            buildClusterBounds(fovY, aspect, near, far);
+        tileSize = glm::vec2((float) viewportWidth / TILES_X, (float) viewportHeight / TILES_Y);
+
+        // per light view-space bounds and the range of clusters they can touch
+        bounds.resize(lights.size());
+        uploadLights.resize(lights.size() * LIGHT_TEXELS);
+        ThreadPool &pool = threadPool();
+        unsigned int chunk = (unsigned int) (lights.size() + pool.size() - 1) / pool.size();
+        pool.parallelFor(pool.size(), [&](unsigned int job) {
+            unsigned int end = std::min<unsigned int>((job + 1) * chunk, lights.size());
+            for (unsigned int i = job * chunk; i < end; i++)
+                prepareLight(i, view);
+        });
+
+        // every job owns one depth slice, so no two jobs write the same cluster
+        std::fill(clusterCounts.begin(), clusterCounts.end(), 0u);
+        std::vector<unsigned int> dropped(SLICES, 0);
+        pool.parallelFor(SLICES, [&](unsigned int slice) {
+            dropped[slice] = binSlice(slice);
+        });
+
+        // compact the fixed size per-cluster lists into one index list
+        ranges.resize(CLUSTER_COUNT * 2);
+        indices.clear();
+        maxClusterLights = 0;
+        droppedLights = 0;
+        for (unsigned int d : dropped)
+            droppedLights += d;
+        for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+            unsigned int count = clusterCounts[cluster];
+            ranges[cluster * 2] = (unsigned int) indices.size();
+            ranges[cluster * 2 + 1] = count;
+            const unsigned int *list = &clusterLists[cluster * MAX_LIGHTS_PER_CLUSTER];
+            indices.insert(indices.end(), list, list + count);
+            maxClusterLights = std::max(maxClusterLights, count);
+        }
+        lightIndexCount = (unsigned int) indices.size();
+        // the texture buffers must not be empty
+        if (indices.empty())
+            indices.push_back(0);
+        if (uploadLights.empty())
+            uploadLights.push_back(glm::vec4(0.0f));
+
+        upload(lightBuffer, uploadLights.size() * sizeof(glm::vec4), &uploadLights[0]);
+        upload(rangeBuffer, ranges.size() * sizeof(unsigned int), &ranges[0]);
+        upload(indexBuffer, indices.size() * sizeof(unsigned int), &indices[0]);
+    }
+
+    // binds the three texture buffers to firstUnit.. firstUnit + 2 and sets the uniforms of a
+    // LIGHT_CLUSTERED shader, which has to be in use
+    void Bind(Shader &shader, unsigned int firstUnit) const {
+        const unsigned int textures[3] = {lightTexture, rangeTexture, indexTexture};
+        for (unsigned int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("clusterLights", firstUnit);
+        shader.setInt("clusterRanges", firstUnit + 1);
+        shader.setInt("clusterIndices", firstUnit + 2);
+        glUniform3i(glGetUniformLocation(shader.ID, "clusterDims"), TILES_X, TILES_Y, SLICES);
+        shader.setVec2("clusterTileSize", tileSize);
+        shader.setVec2("clusterDepthSlicing", depthScale, depthBias);
+        shader.setVec2("clusterNearFar", near, far);
+    }
+
+private:
+    struct LightBounds {
+        glm::vec3 center;
+        float radius;
+        unsigned int minSlice, maxSlice;
+        unsigned int minX, maxX, minY, maxY;
+        bool visible;
+    };
+
+    struct ClusterBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    float fovY = 0.0f, aspect = 0.0f, near = 0.0f, far = 0.0f;
+    float depthScale = 0.0f, depthBias = 0.0f;
+    glm::vec2 tileSize = glm::vec2(1.0f);
+    glm::vec2 tanHalfFov = glm::vec2(1.0f);
+
+    std::vector<ClusterBounds> clusterBounds;
+    std::vector<LightBounds> bounds;
+    std::vector<glm::vec4> uploadLights;
+    std::vector<unsigned int> clusterCounts;
+    std::vector<unsigned int> clusterLists;
+    std::vector<unsigned int> ranges;
+    std::vector<unsigned int> indices;
+
+    unsigned int lightBuffer = 0, lightTexture = 0;
+    unsigned int rangeBuffer = 0, rangeTexture = 0;
+    unsigned int indexBuffer = 0, indexTexture = 0;
+
+    void setupBuffers() {
+        if (lightBuffer != 0)
+            return;
+        createTextureBuffer(lightBuffer, lightTexture, GL_RGBA32F);
+        createTextureBuffer(rangeBuffer, rangeTexture, GL_RG32UI);
+        createTextureBuffer(indexBuffer, indexTexture, GL_R32UI);
+        clusterCounts.resize(CLUSTER_COUNT);
+        clusterLists.resize(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+    }
+
+    static void createTextureBuffer(unsigned int &buffer, unsigned int &texture, GLenum format) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    static void upload(unsigned int buffer, size_t size, const void *data) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    unsigned int sliceOf(float depth) const {
+        float slice = std::log(std::max(depth, near)) * depthScale + depthBias;
+        return (unsigned int) glm::clamp(slice, 0.0f, (float) SLICES - 1.0f);
+    }
+
+    // view-space boxes of every cluster, only change with the projection
+    void buildClusterBounds(float fovY, float aspect, float near, float far) {
+        this->fovY = fovY;
+        this->aspect = aspect;
+        this->near = near;
+        this->far = far;
+        depthScale = SLICES / std::log(far / near);
+        depthBias = -(float) SLICES * std::log(near) / std::log(far / near);
+        tanHalfFov.y = std::tan(fovY * 0.5f);
+        tanHalfFov.x = tanHalfFov.y * aspect;
+
+        clusterBounds.resize(CLUSTER_COUNT);
+        for (unsigned int slice = 0; slice < SLICES; slice++) {
+            float depth0 = near * std::pow(far / near, (float) slice / SLICES);
+            float depth1 = near * std::pow(far / near, (float) (slice + 1) / SLICES);
+            for (unsigned int y = 0; y < TILES_Y; y++) {
+                for (unsigned int x = 0; x < TILES_X; x++) {
+                    glm::vec2 ndc0 = glm::vec2((float) x / TILES_X, (float) y / TILES_Y) * 2.0f - 1.0f;
+                    glm::vec2 ndc1 = glm::vec2((float) (x + 1) / TILES_X, (float) (y + 1) / TILES_Y) * 2.0f - 1.0f;
+                    // the tile's corners at both depths, the camera looks down -z
+                    glm::vec2 a = ndc0 * tanHalfFov * depth0, b = ndc1 * tanHalfFov * depth0;
+                    glm::vec2 c = ndc0 * tanHalfFov * depth1, d = ndc1 * tanHalfFov * depth1;
+                    ClusterBounds &bounds = clusterBounds[x + TILES_X * (y + TILES_Y * slice)];
+                    bounds.min = glm::vec3(glm::min(glm::min(a, b), glm::min(c, d)), -depth1);
+                    bounds.max = glm::vec3(glm::max(glm::max(a, b), glm::max(c, d)), -depth0);
+                }
+            }
+        }
+    }
+
+    void prepareLight(unsigned int i, const glm::mat4 &view) {
+        const ClusterLight &light = lights[i];
+        LightBounds &b = bounds[i];
+        b.center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        b.radius = lightRadius(light, threshold);
+
+        packLight(light, b.radius, &uploadLights[i * LIGHT_TEXELS]);
+
+        float nearDepth = -b.center.z - b.radius;
+        float farDepth = -b.center.z + b.radius;
+        b.visible = b.radius > 0.0f && farDepth > near && nearDepth < far;
+        if (!b.visible)
+            return;
+        b.minSlice = sliceOf(nearDepth);
+        b.maxSlice = sliceOf(farDepth);
+
+        // screen rectangle of the light's view-space box, x / depth is extreme at the box's depth range
+        nearDepth = std::max(nearDepth, near);
+        glm::vec2 lo = glm::vec2(1e30f), hi = glm::vec2(-1e30f);
+        for (float depth : {nearDepth, farDepth}) {
+            for (float sx : {-1.0f, 1.0f}) {
+                for (float sy : {-1.0f, 1.0f}) {
+                    glm::vec2 corner = glm::vec2(b.center.x + sx * b.radius, b.center.y + sy * b.radius);
+                    glm::vec2 ndc = corner / (tanHalfFov * depth);
+                    lo = glm::min(lo, ndc);
+                    hi = glm::max(hi, ndc);
+                }
+            }
+        }
+        if (hi.x < -1.0f || hi.y < -1.0f || lo.x > 1.0f || lo.y > 1.0f) {
+            b.visible = false;
+            return;
+        }
+        glm::vec2 tiles = glm::vec2((float) TILES_X, (float) TILES_Y);
+        glm::vec2 minTile = glm::clamp((lo * 0.5f + 0.5f) * tiles, glm::vec2(0.0f), tiles - 1.0f);
+        glm::vec2 maxTile = glm::clamp((hi * 0.5f + 0.5f) * tiles, glm::vec2(0.0f), tiles - 1.0f);
+        b.minX = (unsigned int) minTile.x;
+        b.minY = (unsigned int) minTile.y;
+        b.maxX = (unsigned int) maxTile.x;
+        b.maxY = (unsigned int) maxTile.y;
+    }
+
+    // returns the number of lights that did not fit
+    unsigned int binSlice(unsigned int slice) {
+        unsigned int dropped = 0;
+        for (unsigned int i = 0; i < bounds.size(); i++) {
+            const LightBounds &b = bounds[i];
+            if (!b.visible || slice < b.minSlice || slice > b.maxSlice)
+                continue;
+            float radius2 = b.radius * b.radius;
+            for (unsigned int y = b.minY; y <= b.maxY; y++) {
+                for (unsigned int x = b.minX; x <= b.maxX; x++) {
+                    unsigned int cluster = x + TILES_X * (y + TILES_Y * slice);
+                    const ClusterBounds &box = clusterBounds[cluster];
+                    glm::vec3 closest = glm::clamp(b.center, box.min, box.max);
+                    glm::vec3 offset = closest - b.center;
+                    if (glm::dot(offset, offset) > radius2)
+                        continue;
+                    unsigned int &count = clusterCounts[cluster];
+                    if (count == MAX_LIGHTS_PER_CLUSTER) {
+                        dropped++;
+                        continue;
+                    }
+                    clusterLists[cluster * MAX_LIGHTS_PER_CLUSTER + count++] = i;
+                }
+            }
+        }
+        return dropped;
+    }
+};
+
+};
+#endif //PROJECT_BASE_CLUSTEREDLIGHTS_H
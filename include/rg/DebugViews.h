@@ -0,0 +1,377 @@
+#ifndef PROJECT_BASE_DEBUGVIEWS_H
+#define PROJECT_BASE_DEBUGVIEWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/RenderStats.h>
+#include <rg/ShaderPermutations.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+enum class DebugView {
+    None = 0,
+    // additive heatmap of how many fragments were written per pixel
+    Overdraw = 1,
+    // every draw coloured by its GPU time, measured with timestamp queries a few frames earlier
+    DrawCost = 2,
+    // every mesh coloured by the level of detail it was drawn with
+    Lod = 3,
+    // polygon edges and the bounding box of every model
+    Wireframe = 4,
+};
+
+const char *const DEBUG_VIEW_NAMES[] = {"None", "Overdraw", "Draw cost", "LOD level", "Wireframe"};
+// file names of the dumps
+const char *const DEBUG_VIEW_FILE_NAMES[] = {"none", "overdraw", "draw_cost", "lod", "wireframe"};
+
+// blue, cyan, green, yellow, red for t from 0 to 1, has to match debug_overdraw.fs
+inline glm::vec3 heatColor(float t) {
+    const glm::vec3 stops[5] = {glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                                glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f)};
+    float x = glm::clamp(t, 0.0f, 1.0f) * 4.0f;
+    int i = std::min((int) x, 3);
+    return glm::mix(stops[i], stops[i + 1], x - (float) i);
+}
+
+// Debug views to find where the scene wastes fill rate and GPU time. The lit shaders are compiled with
+// SHADER_FEATURE_DEBUG_VIEW, which still runs the whole lighting and then replaces the colour with the
+// debugColor uniform: a draw costs what it normally does, so the draw cost view times the real thing.
+// Mesh::Draw, Mesh::DrawInstanced and Impostor::Draw call BeginDraw/EndDraw around their draw call,
+// main does it for the plank.
+//
+// The overdraw view renders into its own R16F target with depth test off and additive blending, each
+// fragment adds one, and EndScene maps the layer count to a heatmap. Alpha tested fragments that are
+// discarded (the leaves) do not count although they were shaded. The views only exist on the forward
+// path, the deferred and visibility buffer paths are replaced by it while a view is on.
+class DebugViews {
+public:
+    static const unsigned int FRAME_LATENCY = 4;
+    // lod passed to BeginDraw for impostors
+    static const unsigned int IMPOSTOR_LOD = 100;
+
+    DebugView view = DebugView::None;
+    // how much of the lit colour the cost and LOD colours replace
+    float tint = 0.85f;
+    // layers at the hot end of the overdraw heatmap
+    float overdrawLayers = 12.0f;
+    // framebuffer the views end up in, 0 is the window
+    unsigned int outputFramebuffer = 0;
+
+    // draw cost of the newest frame read back
+    unsigned int timedDraws = 0;
+    float maxDrawMs = 0.0f;
+    float totalDrawMs = 0.0f;
+    // overdraw of the last dump, average over the pixels anything was drawn to
+    float averageOverdraw = 0.0f;
+    float maxOverdraw = 0.0f;
+    std::string lastDumpPath;
+
+    DebugViews() = default;
+    DebugViews(const DebugViews &) = delete;
+    DebugViews &operator=(const DebugViews &) = delete;
+
+    bool Active() const {
+        return view != DebugView::None;
+    }
+
+    // features to add to the lit shader variants this frame
+    unsigned int ShaderFeatures() const {
+        return Active() ? SHADER_FEATURE_DEBUG_VIEW : SHADER_FEATURE_NONE;
+    }
+
+    // writes the next finished view to debug_<view>_<frame>.ppm
+    void RequestDump() {
+        dumpRequested = true;
+    }
+
+    // call after the window framebuffer was cleared, before the first draw of the scene
+    void BeginFrame(int frameWidth, int frameHeight) {
+        frameNumber++;
+        width = frameWidth;
+        height = frameHeight;
+        occurrences.clear();
+        boxes.clear();
+
+        CostQueries &slot = slots[frameNumber % FRAME_LATENCY];
+        if (slot.submitted)
+            readBack(slot);
+        slot.used = 0;
+        slot.submitted = false;
+
+        if (view == DebugView::Overdraw) {
+            setupOverdrawTarget();
+            glBindFramebuffer(GL_FRAMEBUFFER, overdrawFbo);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glDisable(GL_DEPTH_TEST);
+            glBlendFunc(GL_ONE, GL_ONE);
+        } else if (view == DebugView::Wireframe) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        }
+    }
+
+    // sets the colour of the next draw, key identifies the mesh (or whatever is drawn) for the draw
+    // cost view, a key drawn several times per frame is told apart by the order of its draws
+    void BeginDraw(Shader &shader, const void *key, unsigned int lod) {
+        if (!Active())
+            return;
+        switch (view) {
+            case DebugView::Overdraw:
+                shader.setVec4("debugColor", glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+                break;
+            case DebugView::DrawCost:
+                beginTimedDraw(shader, key);
+                break;
+            case DebugView::Lod:
+                shader.setVec4("debugColor", glm::vec4(lodColor(lod), tint));
+                break;
+            default:
+                shader.setVec4("debugColor", glm::vec4(0.9f, 0.9f, 0.9f, 1.0f));
+                break;
+        }
+    }
+
+    void EndDraw() {
+        if (!timing)
+            return;
+        CostQueries &slot = slots[frameNumber % FRAME_LATENCY];
+        glQueryCounter(slot.queries[2 * slot.used + 1], GL_TIMESTAMP);
+        slot.used++;
+        slot.submitted = true;
+        timing = false;
+    }
+
+    // object-space bounds of a model drawn with transform, shown by the wireframe view
+    void AddBounds(const glm::vec3 &minimum, const glm::vec3 &maximum, const glm::mat4 &transform) {
+        if (view != DebugView::Wireframe)
+            return;
+        glm::mat4 box = glm::translate(transform, minimum);
+        boxes.push_back(glm::scale(box, glm::max(maximum - minimum, glm::vec3(1.0e-4f))));
+    }
+
+    // call after the last scene draw and before ImGui: resolves the overdraw heatmap, draws the
+    // bounding boxes, restores the state BeginFrame changed and writes a requested dump
+    void EndScene(Shader &overdrawShader, Shader &boundsShader, const glm::mat4 &viewMatrix,
+                  const glm::mat4 &projection) {
+        if (view == DebugView::Overdraw) {
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+            glDisable(GL_BLEND);
+            overdrawShader.use();
+            overdrawShader.setInt("layers", 0);
+            overdrawShader.setFloat("maxLayers", overdrawLayers);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, overdrawTexture);
+            glBindVertexArray(fullscreenVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            countDraw(1);
+            glBindVertexArray(0);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glEnable(GL_DEPTH_TEST);
+        } else if (view == DebugView::Wireframe) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            drawBoxes(boundsShader, viewMatrix, projection);
+        }
+
+        if (dumpRequested && Active()) {
+            dumpRequested = false;
+            dump();
+        }
+    }
+
+private:
+    // a draw of the draw cost view, the key and how many draws of it came before in the frame
+    typedef std::pair<const void *, unsigned int> DrawKey;
+
+    struct CostQueries {
+        // a begin and an end timestamp per draw
+        std::vector<GLuint> queries;
+        std::vector<DrawKey> keys;
+        unsigned int used = 0;
+        bool submitted = false;
+    };
+
+    CostQueries slots[FRAME_LATENCY];
+    std::map<DrawKey, float> costs;
+    std::map<const void *, unsigned int> occurrences;
+    unsigned long long frameNumber = 0;
+    bool timing = false;
+    bool dumpRequested = false;
+
+    int width = 0, height = 0;
+    unsigned int overdrawFbo = 0, overdrawTexture = 0;
+    int overdrawWidth = 0, overdrawHeight = 0;
+    unsigned int fullscreenVAO = 0;
+
+    std::vector<glm::mat4> boxes;
+    unsigned int boxVAO = 0, boxVBO = 0, boxEBO = 0;
+
+    static glm::vec3 lodColor(unsigned int lod) {
+        if (lod == IMPOSTOR_LOD)
+            return glm::vec3(0.2f, 0.4f, 1.0f);
+        const glm::vec3 colors[5] = {glm::vec3(0.1f, 0.9f, 0.1f), glm::vec3(0.9f, 0.9f, 0.1f),
+                                     glm::vec3(1.0f, 0.55f, 0.0f), glm::vec3(0.95f, 0.1f, 0.1f),
+                                     glm::vec3(0.9f, 0.1f, 0.9f)};
+        return colors[std::min(lod, 4u)];
+    }
+
+    void beginTimedDraw(Shader &shader, const void *key) {
+        DrawKey draw(key, occurrences[key]++);
+        auto cost = costs.find(draw);
+        // draws not measured yet are grey
+        glm::vec3 color = cost == costs.end() ? glm::vec3(0.5f)
+                                              : heatColor(maxDrawMs > 0.0f ? cost->second / maxDrawMs : 0.0f);
+        shader.setVec4("debugColor", glm::vec4(color, tint));
+
+        CostQueries &slot = slots[frameNumber % FRAME_LATENCY];
+        if (slot.queries.size() < 2 * (slot.used + 1)) {
+            size_t first = slot.queries.size();
+            slot.queries.resize(std::max<size_t>(2 * (slot.used + 1), 2 * first));
+            glGenQueries((GLsizei) (slot.queries.size() - first), &slot.queries[first]);
+            slot.keys.resize(slot.queries.size() / 2);
+        }
+        slot.keys[slot.used] = draw;
+        glQueryCounter(slot.queries[2 * slot.used], GL_TIMESTAMP);
+        timing = true;
+    }
+
+    // keeps the previous costs while the results are not there yet
+    void readBack(const CostQueries &slot) {
+        if (slot.used == 0)
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[2 * slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        costs.clear();
+        timedDraws = slot.used;
+        maxDrawMs = 0.0f;
+        totalDrawMs = 0.0f;
+        for (unsigned int i = 0; i < slot.used; i++) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(slot.queries[2 * i], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(slot.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            float ms = end > begin ? (float) (end - begin) / 1.0e6f : 0.0f;
+            costs[slot.keys[i]] = ms;
+            maxDrawMs = std::max(maxDrawMs, ms);
+            totalDrawMs += ms;
+        }
+    }
+
+    void setupOverdrawTarget() {
+        if (overdrawFbo != 0 && overdrawWidth == width && overdrawHeight == height)
+            return;
+        if (overdrawFbo == 0) {
+            glGenFramebuffers(1, &overdrawFbo);
+            glGenTextures(1, &overdrawTexture);
+            // the fullscreen triangle is generated from gl_VertexID, core profile still wants a VAO
+            glGenVertexArrays(1, &fullscreenVAO);
+        }
+        overdrawWidth = width;
+        overdrawHeight = height;
+        glBindTexture(GL_TEXTURE_2D, overdrawTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, overdrawFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, overdrawTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DEBUG_VIEWS:: overdraw framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+    }
+
+    // the edges of the unit cube scaled to each box
+    void drawBoxes(Shader &boundsShader, const glm::mat4 &viewMatrix, const glm::mat4 &projection) {
+        if (boxes.empty())
+            return;
+        if (boxVAO == 0) {
+            const float corners[] = {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1};
+            const unsigned int edges[] = {0, 1, 1, 2, 2, 3, 3, 0, 4, 5, 5, 6, 6, 7, 7, 4, 0, 4, 1, 5, 2, 6, 3, 7};
+            glGenVertexArrays(1, &boxVAO);
+            glGenBuffers(1, &boxVBO);
+            glGenBuffers(1, &boxEBO);
+            glBindVertexArray(boxVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(edges), edges, GL_STATIC_DRAW);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *) 0);
+        }
+        boundsShader.use();
+        boundsShader.setMat4("view", viewMatrix);
+        boundsShader.setMat4("projection", projection);
+        boundsShader.setVec3("color", glm::vec3(1.0f, 0.8f, 0.1f));
+        glBindVertexArray(boxVAO);
+        for (const glm::mat4 &box : boxes) {
+            boundsShader.setMat4("model", box);
+            glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, (void *) 0);
+            countDraw(0);
+        }
+        glBindVertexArray(0);
+    }
+
+    // binary PPM, there is no image writer in the tree
+    void dump() {
+        std::vector<unsigned char> pixels((size_t) width * (size_t) height * 3);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        if (view == DebugView::Overdraw)
+            measureOverdraw();
+
+        std::string path = std::string("debug_") + DEBUG_VIEW_FILE_NAMES[(int) view] + "_" +
+                           std::to_string(frameNumber) + ".ppm";
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cout << "ERROR::DEBUG_VIEWS:: could not write " << path << std::endl;
+            return;
+        }
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        // GL rows go bottom to top
+        for (int y = height - 1; y >= 0; y--)
+            std::fwrite(&pixels[(size_t) y * (size_t) width * 3], 1, (size_t) width * 3, file);
+        std::fclose(file);
+        lastDumpPath = path;
+        std::cout << "DEBUG_VIEWS:: wrote " << path;
+        if (view == DebugView::Overdraw)
+            std::cout << ", average overdraw " << averageOverdraw << ", max " << maxOverdraw;
+        std::cout << std::endl;
+    }
+
+    void measureOverdraw() {
+        std::vector<float> layers((size_t) overdrawWidth * (size_t) overdrawHeight);
+        glBindTexture(GL_TEXTURE_2D, overdrawTexture);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, layers.data());
+        double sum = 0.0;
+        size_t covered = 0;
+        maxOverdraw = 0.0f;
+        for (float count : layers) {
+            if (count <= 0.0f)
+                continue;
+            sum += count;
+            covered++;
+            maxOverdraw = std::max(maxOverdraw, count);
+        }
+        averageOverdraw = covered ? (float) (sum / (double) covered) : 0.0f;
+    }
+};
+
+inline DebugViews &debugViews() {
+    static DebugViews views;
+    return views;
+}
+
+};
+#endif //PROJECT_BASE_DEBUGVIEWS_H
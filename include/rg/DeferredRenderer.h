@@ -0,0 +1,315 @@
+#ifndef PROJECT_BASE_DEFERREDRENDERER_H
+#define PROJECT_BASE_DEFERREDRENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/ClusteredLights.h>
+#include <rg/Frustum.h>
+#include <rg/RenderStats.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+// Deferred shading: the opaque draws use the GBUFFER shader permutations and write albedo with the
+// specular intensity, the world-space normal with the shininess and the world-space position into
+// a G-buffer. LightPass then copies its depth and stencil into the output framebuffer and adds up
+// the directional light with one fullscreen triangle and every point and spot light with a sphere
+// volume around its attenuation radius. Transparent geometry is drawn forward on top afterwards.
+//
+// The light volumes use the depth-fail stencil test: back faces behind the scene increment and
+// front faces behind the scene decrement the stencil, so only pixels whose surface lies inside the
+// volume are left nonzero and get shaded. The top stencil bit marks pixels the G-buffer pass wrote.
+//
+// The output framebuffer needs a 24 bit depth / 8 bit stencil buffer (the GLFW default) for the copy.
+class DeferredRenderer {
+public:
+    std::vector<ClusterLight> lights;
+    // a light volume reaches out to where the light's intensity drops to this
+    float threshold = 5.0f / 256.0f;
+    // without the stencil test every volume goes out in one instanced draw of its back faces behind
+    // the scene, two draws less per light but the pixels in front of a volume are shaded as well
+    bool stencilVolumes = true;
+
+    // framebuffer the lit image goes to, 0 is the window
+    unsigned int outputFramebuffer = 0;
+
+    // statistics of the last LightPass
+    unsigned int volumeCount = 0;
+
+    DeferredRenderer() = default;
+    DeferredRenderer(const DeferredRenderer &) = delete;
+    DeferredRenderer &operator=(const DeferredRenderer &) = delete;
+
+    // binds the G-buffer for the opaque draws, it follows the framebuffer size
+    void BeginGeometry(unsigned int width, unsigned int height) {
+        setupBuffers(width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        // the alpha channels hold material parameters, nothing may blend into them
+        glDisable(GL_BLEND);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClearStencil(0);
+        glStencilMask(0xFF);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_ALWAYS, GEOMETRY_BIT, GEOMETRY_BIT);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        glStencilMask(GEOMETRY_BIT);
+    }
+
+    // lights the G-buffer into the output framebuffer, directionalShader and volumeShader are
+    // deferred_light.vs/fs with and without DIRECTIONAL, the directional light's uniforms have to be
+    // set already. Leaves the output framebuffer bound with the scene's depth.
+    void LightPass(Shader &directionalShader, Shader &volumeShader, const glm::mat4 &view,
+                   const glm::mat4 &projection, const glm::vec3 &viewPos, bool directional) {
+        glStencilMask(0xFF);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                          GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        // the skybox covers whatever the G-buffer did not
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        const unsigned int textures[3] = {albedoSpecular, normalShininess, position};
+        for (unsigned int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDepthMask(GL_FALSE);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+        if (directional) {
+            directionalShader.use();
+            setSamplers(directionalShader);
+            directionalShader.setVec3("viewPos", viewPos);
+            glDisable(GL_DEPTH_TEST);
+            glStencilFunc(GL_EQUAL, GEOMETRY_BIT, GEOMETRY_BIT);
+            glStencilMask(0);
+            glBindVertexArray(fullscreenVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            countDraw(1);
+        }
+
+        uploadVolumes(projection * view);
+        if (volumeCount > 0) {
+            volumeShader.use();
+            setSamplers(volumeShader);
+            volumeShader.setInt("lights", 3);
+            volumeShader.setMat4("projection", projection);
+            volumeShader.setMat4("view", view);
+            volumeShader.setVec3("viewPos", viewPos);
+            // volumes reaching past the far plane still count their back faces
+            glEnable(GL_DEPTH_CLAMP);
+            glEnable(GL_CULL_FACE);
+            glBindVertexArray(sphereVAO);
+            if (stencilVolumes)
+                drawStencilledVolumes(volumeShader);
+            else
+                drawVolumes(volumeShader);
+            glDisable(GL_DEPTH_CLAMP);
+        }
+
+        // back to the state the forward passes expect
+        glBindVertexArray(0);
+        glDisable(GL_STENCIL_TEST);
+        glStencilMask(0xFF);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glCullFace(GL_BACK);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+private:
+    static const GLint GEOMETRY_BIT = 0x80;
+    static const GLuint VOLUME_BITS = 0x7F;
+    static const unsigned int SPHERE_SLICES = 16;
+    static const unsigned int SPHERE_STACKS = 8;
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int gBuffer = 0;
+    unsigned int albedoSpecular = 0;
+    unsigned int normalShininess = 0;
+    unsigned int position = 0;
+    unsigned int depthStencil = 0;
+
+    unsigned int lightBuffer = 0;
+    unsigned int lightTexture = 0;
+    unsigned int fullscreenVAO = 0;
+    unsigned int sphereVAO = 0;
+    unsigned int sphereIndexCount = 0;
+    std::vector<glm::vec4> uploadLights;
+
+    void setupBuffers(unsigned int width, unsigned int height) {
+        if (lightBuffer == 0) {
+            glGenBuffers(1, &lightBuffer);
+            glGenTextures(1, &lightTexture);
+            glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            // the fullscreen triangle is generated from gl_VertexID, core profile still wants a VAO
+            glGenVertexArrays(1, &fullscreenVAO);
+            setupSphere();
+        }
+        if (width == this->width && height == this->height)
+            return;
+        this->width = width;
+        this->height = height;
+
+        if (gBuffer == 0) {
+            glGenFramebuffers(1, &gBuffer);
+            glGenTextures(1, &albedoSpecular);
+            glGenTextures(1, &normalShininess);
+            glGenTextures(1, &position);
+            glGenRenderbuffers(1, &depthStencil);
+        }
+        // positions need more precision than half floats give a few meters away
+        allocateTarget(albedoSpecular, GL_RGBA8, GL_UNSIGNED_BYTE);
+        allocateTarget(normalShininess, GL_RGBA16F, GL_FLOAT);
+        allocateTarget(position, GL_RGBA32F, GL_FLOAT);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalShininess, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, position, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+        unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DEFERRED:: G-buffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void allocateTarget(unsigned int texture, GLint internalFormat, GLenum type) const {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // a UV sphere pushed out far enough that its flat faces contain the unit sphere
+    void setupSphere() {
+        const float pi = glm::pi<float>();
+        float scale = 1.0f / (std::cos(pi / SPHERE_SLICES) * std::cos(pi / (2 * SPHERE_STACKS)));
+        std::vector<glm::vec3> vertices;
+        for (unsigned int stack = 0; stack <= SPHERE_STACKS; stack++) {
+            float theta = pi * stack / SPHERE_STACKS;
+            for (unsigned int slice = 0; slice <= SPHERE_SLICES; slice++) {
+                float phi = 2.0f * pi * slice / SPHERE_SLICES;
+                vertices.push_back(scale * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                                                     std::sin(theta) * std::sin(phi)));
+            }
+        }
+        // counter-clockwise seen from outside
+        std::vector<unsigned int> indices;
+        for (unsigned int stack = 0; stack < SPHERE_STACKS; stack++) {
+            for (unsigned int slice = 0; slice < SPHERE_SLICES; slice++) {
+                unsigned int a = stack * (SPHERE_SLICES + 1) + slice;
+                unsigned int b = a + SPHERE_SLICES + 1;
+                indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+            }
+        }
+        sphereIndexCount = (unsigned int) indices.size();
+
+        unsigned int vbo, ebo;
+        glGenVertexArrays(1, &sphereVAO);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(sphereVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *) 0);
+        glBindVertexArray(0);
+    }
+
+    void setSamplers(Shader &shader) const {
+        shader.setInt("gAlbedoSpecular", 0);
+        shader.setInt("gNormalShininess", 1);
+        shader.setInt("gPosition", 2);
+    }
+
+    // packs the lights whose volume intersects the view frustum
+    void uploadVolumes(const glm::mat4 &viewProjection) {
+        Frustum frustum(viewProjection);
+        uploadLights.resize(lights.size() * ClusteredLights::LIGHT_TEXELS);
+        volumeCount = 0;
+        for (const ClusterLight &light : lights) {
+            float radius = lightRadius(light, threshold);
+            if (radius <= 0.0f)
+                continue;
+            if (frustum.IntersectsSphere(light.position, radius))
+                packLight(light, radius, &uploadLights[volumeCount++ * ClusteredLights::LIGHT_TEXELS]);
+        }
+        if (volumeCount == 0)
+            return;
+        glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, volumeCount * ClusteredLights::LIGHT_TEXELS * sizeof(glm::vec4),
+                     uploadLights.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void drawStencilledVolumes(Shader &volumeShader) {
+        // the count lives in the low stencil bits, the shading pass resets it for the next light
+        glStencilMask(VOLUME_BITS);
+        for (unsigned int i = 0; i < volumeCount; i++) {
+            volumeShader.setInt("lightOffset", i);
+
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glEnable(GL_DEPTH_TEST);
+            glDisable(GL_CULL_FACE);
+            glStencilFunc(GL_ALWAYS, 0, 0);
+            glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+            glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+            glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+            countDraw(sphereIndexCount / 3);
+
+            // front faces are culled so the volume still shades with the camera inside it
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_FRONT);
+            glStencilFunc(GL_NOTEQUAL, 0, VOLUME_BITS);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+            glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+            countDraw(sphereIndexCount / 3);
+        }
+    }
+
+    void drawVolumes(Shader &volumeShader) {
+        volumeShader.setInt("lightOffset", 0);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GEQUAL);
+        glCullFace(GL_FRONT);
+        glStencilFunc(GL_EQUAL, GEOMETRY_BIT, GEOMETRY_BIT);
+        glStencilMask(0);
+        glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, volumeCount);
+        countDraw(sphereIndexCount / 3, volumeCount);
+    }
+};
+
+};
+#endif //PROJECT_BASE_DEFERREDRENDERER_H
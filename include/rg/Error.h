@@ -11,8 +11,16 @@
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+// Debug builds report GL errors through the KHR_debug callback of rg::GlDebugLayer (rg/GlDebug.h)
+// and release builds run on a no-error context, so GLCALL is the bare call: polling glGetError
+// around every call makes the driver synchronise. RG_GL_CHECK_ERRORS brings the polling back for
+// drivers without KHR_debug.
+#ifdef RG_GL_CHECK_ERRORS
 #define GLCALL(x) \
 do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+#else
+#define GLCALL(x) do { x; } while (0)
+#endif
 
 namespace rg {
 
@@ -0,0 +1,249 @@
+#ifndef PROJECT_BASE_FLIGHTRECORDER_H
+#define PROJECT_BASE_FLIGHTRECORDER_H
+
+#include <rg/GpuProfiler.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/Trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// one frame as the flight recorder saw it, from the start of the frame to the start of the next
+struct FrameRecord {
+    unsigned long long frame = 0;
+    uint64_t startNs = 0;
+    uint64_t endNs = 0;
+    FrameStats stats;
+    // GpuProfiler frame number, only meaningful when gpuProfiled
+    unsigned long long gpuFrame = 0;
+    bool gpuProfiled = false;
+
+    float Ms() const {
+        return (float) (endNs - startNs) / 1.0e6f;
+    }
+};
+
+// Always keeps the last historyFrames frames (their times and counters) and, through rg::profiler()
+// and rg::gpuProfiler(), the CPU zones and GPU passes of the same frames. A frame that takes longer
+// than thresholdFactor times the median of the previous medianFrames frames is a hitch: framesAfter
+// frames later, once the GPU results of the hitch came back, the framesBefore frames before it up
+// to the frames after it are written as a Chrome trace. After a dump no other hitch is dumped for
+// cooldownSeconds, a stutter does not fill the disk.
+//
+// The CPU zones are missing from the dumps when the profiler is compiled out, and only reach back as
+// far as ProfileRing::CAPACITY zones per thread: with thousands of draws a frame that is fewer than
+// framesBefore frames. Every dump records the frames its CPU zones cover in otherData and prints them.
+class FlightRecorder {
+public:
+    bool enabled = true;
+    float thresholdFactor = 2.0f;
+    // frames faster than this are never hitches, however fast the median is
+    float minimumHitchMs = 8.0f;
+    unsigned int medianFrames = 120;
+    unsigned int framesBefore = 120;
+    // at least GpuProfiler::FRAME_LATENCY, so the hitch's own GPU timings are in
+    unsigned int framesAfter = 30;
+    float cooldownSeconds = 10.0f;
+    unsigned int historyFrames = 600;
+
+    // written dumps, and the hitches not dumped because of the cooldown
+    unsigned int dumps = 0;
+    unsigned int skippedHitches = 0;
+    std::string lastDumpPath;
+
+    FlightRecorder() = default;
+    FlightRecorder(const FlightRecorder &) = delete;
+    FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+    // call at the top of the frame loop, before frameStats() is reset and before gpu.BeginFrame()
+    void BeginFrame(const GpuProfiler &gpu) {
+        uint64_t now = traceNowNs();
+        if (open) {
+            FrameRecord &finished = frames.back();
+            finished.endNs = now;
+            finished.stats = frameStats();
+            if (enabled)
+                checkHitch(finished);
+        }
+
+        FrameRecord next;
+        next.frame = frameNumber++;
+        next.startNs = now;
+        next.gpuFrame = gpu.FrameNumber();
+        next.gpuProfiled = gpu.enabled;
+        frames.push_back(next);
+        open = true;
+        while (frames.size() > std::max(historyFrames, framesBefore + framesAfter + 2))
+            frames.pop_front();
+
+        if (pending && frames.size() >= 2 && frames[frames.size() - 2].frame >= pendingHitch + framesAfter) {
+            pending = false;
+            dump(gpu);
+        }
+    }
+
+private:
+    std::deque<FrameRecord> frames;
+    unsigned long long frameNumber = 0;
+    bool open = false;
+
+    bool pending = false;
+    unsigned long long pendingHitch = 0;
+    float pendingMs = 0.0f;
+    float pendingMedianMs = 0.0f;
+    uint64_t lastDumpNs = 0;
+    bool dumped = false;
+
+    // tracks of the dump besides the CPU threads
+    static const uint32_t FRAME_TRACK = 1000;
+    static const uint32_t GPU_TRACK = 1001;
+
+    void checkHitch(const FrameRecord &frame) {
+        // frames.back() is the one just finished, the median is over the ones before it
+        if (pending || frames.size() < medianFrames + 1)
+            return;
+        std::vector<float> previous;
+        previous.reserve(medianFrames);
+        for (size_t i = frames.size() - 1 - medianFrames; i < frames.size() - 1; i++)
+            previous.push_back(frames[i].Ms());
+        std::nth_element(previous.begin(), previous.begin() + previous.size() / 2, previous.end());
+        float medianMs = previous[previous.size() / 2];
+        float ms = frame.Ms();
+        if (ms < minimumHitchMs || ms < thresholdFactor * medianMs)
+            return;
+
+        if (dumped && (float) (frame.endNs - lastDumpNs) / 1.0e9f < cooldownSeconds) {
+            skippedHitches++;
+            return;
+        }
+        pending = true;
+        pendingHitch = frame.frame;
+        pendingMs = ms;
+        pendingMedianMs = medianMs;
+    }
+
+    void dump(const GpuProfiler &gpu) {
+        unsigned long long first = pendingHitch > framesBefore ? pendingHitch - framesBefore : 0;
+        std::vector<const FrameRecord *> window;
+        for (size_t i = 0; i + 1 < frames.size(); i++) {
+            if (frames[i].frame >= first && frames[i].frame <= pendingHitch + framesAfter)
+                window.push_back(&frames[i]);
+        }
+        if (window.empty())
+            return;
+        uint64_t windowStart = window.front()->startNs;
+        uint64_t windowEnd = window.back()->endNs;
+
+        std::string path = "hitch_" + std::to_string(pendingHitch) + ".json";
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::FLIGHT_RECORDER:: could not write " << path << std::endl;
+            return;
+        }
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        writeThreadName(out, FRAME_TRACK, "frames");
+        out << ",\n";
+        writeThreadName(out, GPU_TRACK, "GPU (passes placed at the CPU frame start)");
+
+        for (const FrameRecord *frame : window) {
+            const FrameStats &stats = frame->stats;
+            char detail[160];
+            std::snprintf(detail, sizeof(detail), "%.2f ms, %u draws, %llu triangles, %u bind calls, %u uniforms",
+                          frame->Ms(), stats.drawCalls, stats.triangles, stats.bindCalls, stats.uniformUploads);
+            out << ",\n";
+            writeChromeTraceEvent(out, frame->frame == pendingHitch ? "HITCH frame " + std::to_string(frame->frame)
+                                                                    : "frame " + std::to_string(frame->frame),
+                                  detail, frame->startNs, frame->endNs - frame->startNs, FRAME_TRACK);
+            out << ",\n{\"name\": \"counters\", \"ph\": \"C\", \"ts\": " << frame->startNs / 1000.0
+                << ", \"pid\": 1, \"args\": {\"frame_ms\": " << frame->Ms() << ", \"draw_calls\": " << stats.drawCalls
+                << ", \"triangles\": " << stats.triangles << ", \"bind_calls\": " << stats.bindCalls
+                << ", \"uniform_uploads\": " << stats.uniformUploads << ", \"culled_objects\": "
+                << stats.culledObjects << "}}";
+            writeGpuFrame(out, gpu, *frame);
+        }
+
+        // a thread whose ring is full lost everything before its oldest zone, without any zones (the
+        // profiler compiled out) no frame is covered
+        std::vector<ThreadZones> threads = profiler().Snapshot();
+        bool anyZones = false;
+        uint64_t zonesFromNs = 0;
+        for (const ThreadZones &thread : threads) {
+            anyZones = anyZones || !thread.zones.empty();
+            if (!thread.zones.empty() && thread.zones.size() + 1 >= ProfileRing::CAPACITY)
+                zonesFromNs = std::max(zonesFromNs, thread.zones.front().startNs);
+        }
+        size_t zoneFrames = 0;
+        unsigned long long zonesFromFrame = window.back()->frame + 1;
+        for (auto frame = window.rbegin(); anyZones && frame != window.rend() && (*frame)->startNs >= zonesFromNs;
+             ++frame) {
+            zoneFrames++;
+            zonesFromFrame = (*frame)->frame;
+        }
+
+        size_t zones = 0;
+        for (const ThreadZones &thread : threads) {
+            for (const ProfileZone &zone : thread.zones) {
+                if (zone.endNs < windowStart || zone.startNs > windowEnd)
+                    continue;
+                out << ",\n";
+                writeChromeTraceEvent(out, zone.name, std::string(), zone.startNs, zone.endNs - zone.startNs,
+                                      thread.threadId);
+                zones++;
+            }
+        }
+        out << "\n], \"otherData\": {\"hitch_frame\": " << pendingHitch << ", \"frames\": " << window.size()
+            << ", \"cpu_zone_frames\": " << zoneFrames << ", \"cpu_zones_from_frame\": " << zonesFromFrame << "}}\n";
+
+        dumps++;
+        dumped = true;
+        lastDumpNs = traceNowNs();
+        lastDumpPath = path;
+        std::cout << "FLIGHT_RECORDER:: frame " << pendingHitch << " took " << pendingMs << " ms (median "
+                  << pendingMedianMs << " ms), wrote " << window.size() << " frames and " << zones << " zones to "
+                  << path << std::endl;
+        if (anyZones && zoneFrames < window.size())
+            std::cout << "FLIGHT_RECORDER:: the CPU zones only cover the last " << zoneFrames << " frames, from frame "
+                      << zonesFromFrame << ", the profiler rings hold " << ProfileRing::CAPACITY
+                      << " zones per thread" << std::endl;
+    }
+
+    static void writeThreadName(std::ostream &out, uint32_t track, const std::string &name) {
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track
+            << ", \"args\": {\"name\": " << traceJsonString(name) << "}}";
+    }
+
+    // GPU timestamps are not in the CPU time base, the passes are laid out back to back from the start
+    // of the CPU frame that submitted them
+    static void writeGpuFrame(std::ostream &out, const GpuProfiler &gpu, const FrameRecord &frame) {
+        if (!frame.gpuProfiled)
+            return;
+        for (const GpuFrameTiming &timing : gpu.History()) {
+            if (timing.frame != frame.gpuFrame)
+                continue;
+            uint64_t start = frame.startNs;
+            for (const GpuPassTiming &pass : timing.passes) {
+                uint64_t durationNs = (uint64_t) (pass.gpuMs * 1.0e6);
+                out << ",\n";
+                writeChromeTraceEvent(out, pass.name, std::string(), start, durationNs, GPU_TRACK);
+                start += durationNs;
+            }
+            return;
+        }
+    }
+};
+
+inline FlightRecorder &flightRecorder() {
+    static FlightRecorder recorder;
+    return recorder;
+}
+
+};
+#endif //PROJECT_BASE_FLIGHTRECORDER_H
@@ -0,0 +1,47 @@
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+// largest scale factor of a transform's axes, turns an object-space radius into a world-space one
+inline float maxAxisScale(const glm::mat4 &transform) {
+    return std::sqrt(std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                     std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                              glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])))));
+}
+
+// The six clip planes of a view-projection matrix (Gribb/Hartmann), pointing inwards and not
+// normalized, so sphere tests scale the radius by the length of the plane normal instead.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() : Frustum(glm::mat4(1.0f)) {}
+
+    explicit Frustum(const glm::mat4 &viewProjection) {
+        glm::mat4 m = glm::transpose(viewProjection);
+        planes[0] = m[3] + m[0];
+        planes[1] = m[3] - m[0];
+        planes[2] = m[3] + m[1];
+        planes[3] = m[3] - m[1];
+        planes[4] = m[3] + m[2];
+        planes[5] = m[3] - m[2];
+    }
+
+    // conservative, a sphere close to a frustum corner can pass without being visible
+    bool IntersectsSphere(const glm::vec3 &center, float radius) const {
+        for (const glm::vec4 &plane : planes) {
+            glm::vec3 normal = glm::vec3(plane);
+            if (glm::dot(normal, center) + plane.w < -radius * glm::length(normal))
+                return false;
+        }
+        return true;
+    }
+};
+
+};
+#endif //PROJECT_BASE_FRUSTUM_H
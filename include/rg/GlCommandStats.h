@@ -0,0 +1,412 @@
+#ifndef PROJECT_BASE_GLCOMMANDSTATS_H
+#define PROJECT_BASE_GLCOMMANDSTATS_H
+
+#include <glad/glad.h>
+
+#include <cxxabi.h>
+#include <execinfo.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+enum GlCommandCategory {
+    GL_COMMAND_DRAW,
+    GL_COMMAND_PROGRAM_BIND,
+    GL_COMMAND_VAO_BIND,
+    GL_COMMAND_TEXTURE_BIND,
+    GL_COMMAND_BUFFER_BIND,
+    GL_COMMAND_FRAMEBUFFER_BIND,
+    GL_COMMAND_UNIFORM,
+    GL_COMMAND_BUFFER_UPLOAD,
+    GL_COMMAND_TEXTURE_UPLOAD,
+    GL_COMMAND_STATE,
+};
+
+// what the intercepted GL calls of one frame submitted
+struct GlFrameCounters {
+    unsigned int drawCalls = 0;
+    // indices of indexed draws, vertices of array draws, both per draw call (not times instances)
+    unsigned long long indices = 0;
+    unsigned long long vertices = 0;
+    unsigned long long instances = 0;
+    unsigned int programBinds = 0;
+    unsigned int vaoBinds = 0;
+    unsigned int textureBinds = 0;
+    unsigned int bufferBinds = 0;
+    unsigned int framebufferBinds = 0;
+    unsigned int uniformCalls = 0;
+    unsigned int bufferUploads = 0;
+    // bytes passed to glBufferData (with data) and glBufferSubData
+    unsigned long long bufferBytes = 0;
+    unsigned int textureUploads = 0;
+    // glEnable/glDisable and the depth, stencil, blend, cull, mask and viewport state
+    unsigned int stateToggles = 0;
+    // calls per hooked entry point, indexed like GlCommandStats::Commands()
+    std::vector<unsigned int> calls;
+};
+
+struct GlCallSite {
+    // return address into the caller of the GL function
+    const void *address = nullptr;
+    unsigned int command = 0;
+    unsigned int calls = 0;
+};
+
+struct GlCommand {
+    std::string name;
+    GlCommandCategory category;
+};
+
+// Optional layer over the GL function pointers glad loaded: Install() replaces the pointers of the
+// draw, bind, uniform, upload and state entry points with hooks that count the call and forward
+// it, Uninstall() puts the originals back, so nothing is counted or paid for while it is off. It
+// sees every call made through glad, ImGui's included. Single threaded like the GL context.
+//
+// With callSites on, every call is also counted per return address, CallSiteName() resolves one to
+// function+offset (the executable is linked with -rdynamic, addr2line turns the address into a line).
+class GlCommandStats {
+public:
+    bool callSites = false;
+    // counters of the last finished frame
+    GlFrameCounters lastFrame;
+    std::vector<GlCallSite> lastCallSites;
+
+    GlCommandStats() = default;
+    GlCommandStats(const GlCommandStats &) = delete;
+    GlCommandStats &operator=(const GlCommandStats &) = delete;
+
+    bool Installed() const {
+        return installed;
+    }
+
+    const std::vector<GlCommand> &Commands() const {
+        return commands;
+    }
+
+    // call with the GL functions loaded
+    void Install();
+
+    void Uninstall() {
+        for (const std::function<void()> &undo : restore)
+            undo();
+        restore.clear();
+        installed = false;
+    }
+
+    // call at the start of every frame, the frame before becomes lastFrame
+    void BeginFrame() {
+        if (!installed)
+            return;
+        lastFrame = current;
+        lastCallSites.clear();
+        for (const auto &site : sites)
+            lastCallSites.push_back(site.second);
+        std::sort(lastCallSites.begin(), lastCallSites.end(), [](const GlCallSite &a, const GlCallSite &b) {
+            return a.calls > b.calls;
+        });
+        current = GlFrameCounters();
+        current.calls.assign(commands.size(), 0);
+        sites.clear();
+    }
+
+    // called by the hooks
+    void Record(unsigned int command, const void *returnAddress) {
+        current.calls[command]++;
+        switch (commands[command].category) {
+            case GL_COMMAND_DRAW: current.drawCalls++; break;
+            case GL_COMMAND_PROGRAM_BIND: current.programBinds++; break;
+            case GL_COMMAND_VAO_BIND: current.vaoBinds++; break;
+            case GL_COMMAND_TEXTURE_BIND: current.textureBinds++; break;
+            case GL_COMMAND_BUFFER_BIND: current.bufferBinds++; break;
+            case GL_COMMAND_FRAMEBUFFER_BIND: current.framebufferBinds++; break;
+            case GL_COMMAND_UNIFORM: current.uniformCalls++; break;
+            case GL_COMMAND_BUFFER_UPLOAD: current.bufferUploads++; break;
+            case GL_COMMAND_TEXTURE_UPLOAD: current.textureUploads++; break;
+            case GL_COMMAND_STATE: current.stateToggles++; break;
+        }
+        if (callSites) {
+            GlCallSite &site = sites[siteKey(returnAddress, command)];
+            site.address = returnAddress;
+            site.command = command;
+            site.calls++;
+        }
+    }
+
+    GlFrameCounters &Current() {
+        return current;
+    }
+
+    const std::string &CallSiteName(const void *address) {
+        auto found = siteNames.find(address);
+        if (found != siteNames.end())
+            return found->second;
+        void *frame = const_cast<void *>(address);
+        char **symbols = backtrace_symbols(&frame, 1);
+        std::string name = symbols ? symbols[0] : "?";
+        std::free(symbols);
+        // module(mangled+offset) [address], with the function name demangled
+        size_t open = name.find('('), plus = name.find('+', open);
+        if (open != std::string::npos && plus != std::string::npos && plus > open + 1) {
+            int status = 0;
+            char *demangled = abi::__cxa_demangle(name.substr(open + 1, plus - open - 1).c_str(), nullptr, nullptr,
+                                                  &status);
+            if (status == 0 && demangled)
+                name = name.substr(0, open + 1) + demangled + name.substr(plus);
+            std::free(demangled);
+        }
+        return siteNames.emplace(address, name).first->second;
+    }
+
+    bool WriteJson(const std::string &path) {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::GL_COMMAND_STATS:: could not write " << path << std::endl;
+            return false;
+        }
+        const GlFrameCounters &frame = lastFrame;
+        out << "{\n"
+            << "  \"draw_calls\": " << frame.drawCalls << ",\n"
+            << "  \"indices\": " << frame.indices << ",\n"
+            << "  \"vertices\": " << frame.vertices << ",\n"
+            << "  \"instances\": " << frame.instances << ",\n"
+            << "  \"program_binds\": " << frame.programBinds << ",\n"
+            << "  \"vao_binds\": " << frame.vaoBinds << ",\n"
+            << "  \"texture_binds\": " << frame.textureBinds << ",\n"
+            << "  \"buffer_binds\": " << frame.bufferBinds << ",\n"
+            << "  \"framebuffer_binds\": " << frame.framebufferBinds << ",\n"
+            << "  \"uniform_calls\": " << frame.uniformCalls << ",\n"
+            << "  \"buffer_uploads\": " << frame.bufferUploads << ",\n"
+            << "  \"buffer_bytes\": " << frame.bufferBytes << ",\n"
+            << "  \"texture_uploads\": " << frame.textureUploads << ",\n"
+            << "  \"state_toggles\": " << frame.stateToggles << ",\n"
+            << "  \"calls\": {";
+        bool first = true;
+        for (size_t i = 0; i < frame.calls.size(); i++) {
+            if (frame.calls[i] == 0)
+                continue;
+            out << (first ? "" : ",") << "\n    \"" << commands[i].name << "\": " << frame.calls[i];
+            first = false;
+        }
+        out << "\n  },\n  \"call_sites\": [";
+        for (size_t i = 0; i < lastCallSites.size(); i++) {
+            const GlCallSite &site = lastCallSites[i];
+            out << (i ? "," : "") << "\n    {\"site\": \"" << jsonEscape(CallSiteName(site.address))
+                << "\", \"call\": \"" << commands[site.command].name << "\", \"calls\": " << site.calls << "}";
+        }
+        out << "\n  ]\n}\n";
+        std::cout << "GL_COMMAND_STATS:: wrote " << path << std::endl;
+        return true;
+    }
+
+private:
+    template <typename T>
+    struct Identity {
+        typedef T type;
+    };
+
+    // One instantiation per hooked entry point, Slot tells them apart when two share a signature.
+    template <unsigned int Slot, typename Function>
+    struct Hook;
+
+    template <unsigned int Slot, typename R, typename... Args>
+    struct Hook<Slot, R (APIENTRYP)(Args...)> {
+        typedef R (APIENTRYP Function)(Args...);
+        typedef void (*Account)(GlFrameCounters &, Args...);
+
+        static Function &real() {
+            static Function function = nullptr;
+            return function;
+        }
+
+        static unsigned int &command() {
+            static unsigned int index = 0;
+            return index;
+        }
+
+        static Account &account() {
+            static Account function = nullptr;
+            return function;
+        }
+
+        static R APIENTRY call(Args... args);
+    };
+
+    std::vector<GlCommand> commands;
+    std::vector<std::function<void()>> restore;
+    bool installed = false;
+    GlFrameCounters current;
+    std::unordered_map<unsigned long long, GlCallSite> sites;
+    std::unordered_map<const void *, std::string> siteNames;
+
+    template <unsigned int Slot, typename R, typename... Args>
+    void hook(R (APIENTRYP &pointer)(Args...), const char *name, GlCommandCategory category,
+              typename Identity<void (*)(GlFrameCounters &, Args...)>::type account = nullptr) {
+        typedef Hook<Slot, R (APIENTRYP)(Args...)> H;
+        if (pointer == nullptr)
+            return;
+        H::real() = pointer;
+        H::command() = (unsigned int) commands.size();
+        H::account() = account;
+        commands.push_back({name, category});
+        pointer = &H::call;
+        R (APIENTRYP *slot)(Args...) = &pointer;
+        restore.push_back([slot]() {
+            *slot = H::real();
+        });
+    }
+
+    static unsigned long long siteKey(const void *address, unsigned int command) {
+        return ((unsigned long long) (size_t) address << 8) ^ command;
+    }
+
+    static std::string jsonEscape(const std::string &value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            if ((unsigned char) c >= 0x20)
+                escaped += c;
+        }
+        return escaped;
+    }
+};
+
+inline GlCommandStats &glCommandStats() {
+    static GlCommandStats stats;
+    return stats;
+}
+
+template <unsigned int Slot, typename R, typename... Args>
+R APIENTRY GlCommandStats::Hook<Slot, R (APIENTRYP)(Args...)>::call(Args... args) {
+    GlCommandStats &stats = glCommandStats();
+    stats.Record(command(), __builtin_return_address(0));
+    if (account())
+        account()(stats.Current(), args...);
+    return real()(args...);
+}
+
+#define RG_GL_HOOK(function, category, ...) hook<__COUNTER__>(glad_##function, #function, category, ##__VA_ARGS__)
+
+inline void GlCommandStats::Install() {
+    if (installed)
+        return;
+    commands.clear();
+
+    RG_GL_HOOK(glDrawArrays, GL_COMMAND_DRAW, [](GlFrameCounters &c, GLenum, GLint, GLsizei count) {
+        c.vertices += count;
+        c.instances++;
+    });
+    RG_GL_HOOK(glDrawArraysInstanced, GL_COMMAND_DRAW,
+               [](GlFrameCounters &c, GLenum, GLint, GLsizei count, GLsizei instances) {
+                   c.vertices += count;
+                   c.instances += instances;
+               });
+    RG_GL_HOOK(glDrawElements, GL_COMMAND_DRAW, [](GlFrameCounters &c, GLenum, GLsizei count, GLenum, const void *) {
+        c.indices += count;
+        c.instances++;
+    });
+    RG_GL_HOOK(glDrawElementsInstanced, GL_COMMAND_DRAW,
+               [](GlFrameCounters &c, GLenum, GLsizei count, GLenum, const void *, GLsizei instances) {
+                   c.indices += count;
+                   c.instances += instances;
+               });
+    RG_GL_HOOK(glDrawElementsBaseVertex, GL_COMMAND_DRAW,
+               [](GlFrameCounters &c, GLenum, GLsizei count, GLenum, const void *, GLint) {
+                   c.indices += count;
+                   c.instances++;
+               });
+    RG_GL_HOOK(glDrawElementsInstancedBaseVertex, GL_COMMAND_DRAW,
+               [](GlFrameCounters &c, GLenum, GLsizei count, GLenum, const void *, GLsizei instances, GLint) {
+                   c.indices += count;
+                   c.instances += instances;
+               });
+    RG_GL_HOOK(glDrawRangeElements, GL_COMMAND_DRAW,
+               [](GlFrameCounters &c, GLenum, GLuint, GLuint, GLsizei count, GLenum, const void *) {
+                   c.indices += count;
+                   c.instances++;
+               });
+
+    RG_GL_HOOK(glUseProgram, GL_COMMAND_PROGRAM_BIND);
+    RG_GL_HOOK(glBindVertexArray, GL_COMMAND_VAO_BIND);
+    RG_GL_HOOK(glBindTexture, GL_COMMAND_TEXTURE_BIND);
+    RG_GL_HOOK(glActiveTexture, GL_COMMAND_TEXTURE_BIND);
+    RG_GL_HOOK(glBindBuffer, GL_COMMAND_BUFFER_BIND);
+    RG_GL_HOOK(glBindBufferBase, GL_COMMAND_BUFFER_BIND);
+    RG_GL_HOOK(glBindBufferRange, GL_COMMAND_BUFFER_BIND);
+    RG_GL_HOOK(glBindFramebuffer, GL_COMMAND_FRAMEBUFFER_BIND);
+
+    RG_GL_HOOK(glUniform1i, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform2i, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform3i, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform4i, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform1iv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform1ui, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform1f, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform2f, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform3f, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform4f, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform1fv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform2fv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform3fv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniform4fv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniformMatrix2fv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniformMatrix3fv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniformMatrix4fv, GL_COMMAND_UNIFORM);
+    RG_GL_HOOK(glUniformBlockBinding, GL_COMMAND_UNIFORM);
+
+    RG_GL_HOOK(glBufferData, GL_COMMAND_BUFFER_UPLOAD,
+               [](GlFrameCounters &c, GLenum, GLsizeiptr size, const void *data, GLenum) {
+                   // without data it only (re)allocates, like the orphaning of the instance buffers
+                   if (data != nullptr)
+                       c.bufferBytes += size;
+               });
+    RG_GL_HOOK(glBufferSubData, GL_COMMAND_BUFFER_UPLOAD,
+               [](GlFrameCounters &c, GLenum, GLintptr, GLsizeiptr size, const void *) {
+                   c.bufferBytes += size;
+               });
+    RG_GL_HOOK(glMapBufferRange, GL_COMMAND_BUFFER_UPLOAD,
+               [](GlFrameCounters &c, GLenum, GLintptr, GLsizeiptr length, GLbitfield access) {
+                   if (access & GL_MAP_WRITE_BIT)
+                       c.bufferBytes += length;
+               });
+    RG_GL_HOOK(glTexImage2D, GL_COMMAND_TEXTURE_UPLOAD);
+    RG_GL_HOOK(glTexSubImage2D, GL_COMMAND_TEXTURE_UPLOAD);
+    RG_GL_HOOK(glTexImage3D, GL_COMMAND_TEXTURE_UPLOAD);
+    RG_GL_HOOK(glTexBuffer, GL_COMMAND_TEXTURE_UPLOAD);
+
+    RG_GL_HOOK(glEnable, GL_COMMAND_STATE);
+    RG_GL_HOOK(glDisable, GL_COMMAND_STATE);
+    RG_GL_HOOK(glDepthFunc, GL_COMMAND_STATE);
+    RG_GL_HOOK(glDepthMask, GL_COMMAND_STATE);
+    RG_GL_HOOK(glCullFace, GL_COMMAND_STATE);
+    RG_GL_HOOK(glFrontFace, GL_COMMAND_STATE);
+    RG_GL_HOOK(glBlendFunc, GL_COMMAND_STATE);
+    RG_GL_HOOK(glBlendFuncSeparate, GL_COMMAND_STATE);
+    RG_GL_HOOK(glBlendEquation, GL_COMMAND_STATE);
+    RG_GL_HOOK(glColorMask, GL_COMMAND_STATE);
+    RG_GL_HOOK(glStencilFunc, GL_COMMAND_STATE);
+    RG_GL_HOOK(glStencilOp, GL_COMMAND_STATE);
+    RG_GL_HOOK(glStencilOpSeparate, GL_COMMAND_STATE);
+    RG_GL_HOOK(glStencilMask, GL_COMMAND_STATE);
+    RG_GL_HOOK(glPolygonMode, GL_COMMAND_STATE);
+    RG_GL_HOOK(glScissor, GL_COMMAND_STATE);
+    RG_GL_HOOK(glViewport, GL_COMMAND_STATE);
+
+    current = GlFrameCounters();
+    current.calls.assign(commands.size(), 0);
+    sites.clear();
+    installed = true;
+}
+
+#undef RG_GL_HOOK
+
+};
+#endif //PROJECT_BASE_GLCOMMANDSTATS_H
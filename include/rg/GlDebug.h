@@ -0,0 +1,194 @@
+#ifndef PROJECT_BASE_GLDEBUG_H
+#define PROJECT_BASE_GLDEBUG_H
+
+#include <glad/glad.h>
+
+#include <execinfo.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// debug builds create a debug context and enable rg::GlDebugLayer, release builds ask for a
+// no-error context instead (GLFW_CONTEXT_NO_ERROR, EGL_KHR_create_context_no_error)
+#if !defined(NDEBUG)
+#define RG_GL_DEBUG_LAYER 1
+#else
+#define RG_GL_DEBUG_LAYER 0
+#endif
+
+namespace rg {
+
+// Reports what the driver has to say through the KHR_debug callback instead of polling glGetError:
+// errors, performance warnings and undefined behaviour, without notifications. Each distinct message
+// is printed once together with the call stack that delivered it and only counted afterwards,
+// PrintSummary() lists the repeats.
+//
+// The output is asynchronous by default, the driver may then deliver a message later or from its
+// own thread and the stack does not point at the failing call. SetSynchronous(true) makes the driver
+// report inside the offending GL call, which costs performance but gives the exact call site.
+class GlDebugLayer {
+public:
+    // __builtin_trap() on GL_DEBUG_TYPE_ERROR, for running under a debugger with synchronous output
+    bool breakOnError = false;
+    unsigned int stackFrames = 12;
+
+    GlDebugLayer() = default;
+    GlDebugLayer(const GlDebugLayer &) = delete;
+    GlDebugLayer &operator=(const GlDebugLayer &) = delete;
+
+    // call with the context current and the GL functions loaded
+    bool Enable(bool synchronous = false) {
+        if (!GLAD_GL_KHR_debug) {
+            std::cout << "ERROR::GL_DEBUG:: KHR_debug is not supported, GL errors are not reported" << std::endl;
+            return false;
+        }
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+        if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+            std::cout << "GL_DEBUG:: not a debug context, the driver may report less" << std::endl;
+
+        glEnable(GL_DEBUG_OUTPUT);
+        SetSynchronous(synchronous);
+        glDebugMessageCallback(callback, this);
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+        active = true;
+        return true;
+    }
+
+    bool Active() const {
+        return active;
+    }
+
+    bool Synchronous() const {
+        return synchronous;
+    }
+
+    void SetSynchronous(bool enabled) {
+        synchronous = enabled;
+        if (enabled)
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        else
+            glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+
+    // all reported messages and the distinct ones among them
+    unsigned int Messages() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total;
+    }
+
+    unsigned int DistinctMessages() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (unsigned int) seen.size();
+    }
+
+    void PrintSummary() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (seen.empty())
+            return;
+        std::vector<const Seen *> sorted;
+        for (const auto &entry : seen)
+            sorted.push_back(&entry.second);
+        std::sort(sorted.begin(), sorted.end(), [](const Seen *a, const Seen *b) {
+            return a->count > b->count;
+        });
+        std::cout << "GL_DEBUG:: " << total << " messages, " << seen.size() << " distinct:" << std::endl;
+        for (const Seen *message : sorted)
+            std::cout << "  " << message->count << "x " << message->summary << std::endl;
+    }
+
+private:
+    struct Seen {
+        unsigned int count = 0;
+        std::string summary;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::string, Seen> seen;
+    unsigned int total = 0;
+    bool active = false;
+    bool synchronous = false;
+
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                  const GLchar *message, const void *userParam) {
+        GlDebugLayer *layer = (GlDebugLayer *) userParam;
+        layer->report(source, type, id, severity,
+                      length >= 0 ? std::string(message, (size_t) length) : std::string(message));
+    }
+
+    void report(GLenum source, GLenum type, GLuint id, GLenum severity, const std::string &message) {
+        std::ostringstream summary;
+        summary << "[" << typeName(type) << ", " << severityName(severity) << ", " << sourceName(source) << " "
+                << id << "] " << message;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            total++;
+            Seen &entry = seen[summary.str()];
+            if (entry.count++ > 0)
+                return;
+            entry.summary = summary.str();
+        }
+
+        bool error = type == GL_DEBUG_TYPE_ERROR;
+        std::cout << (error ? "ERROR::GL_DEBUG:: " : "GL_DEBUG:: ") << summary.str() << "\n"
+                  << (synchronous ? "  reported by:\n" : "  reported (asynchronously) by:\n");
+        void *frames[64];
+        int count = backtrace(frames, (int) std::min(stackFrames + 2, 64u));
+        char **symbols = backtrace_symbols(frames, count);
+        // the first two frames are report() and callback()
+        for (int i = 2; symbols && i < count; i++)
+            std::cout << "    " << symbols[i] << "\n";
+        std::free(symbols);
+        std::cout << std::flush;
+
+        if (error && breakOnError)
+            __builtin_trap();
+    }
+
+    static const char *sourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "api";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            default: return "other";
+        }
+    }
+
+    static const char *typeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behaviour";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+            default: return "other";
+        }
+    }
+
+    static const char *severityName(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+            default: return "notification";
+        }
+    }
+};
+
+inline GlDebugLayer &glDebugLayer() {
+    static GlDebugLayer layer;
+    return layer;
+}
+
+};
+#endif //PROJECT_BASE_GLDEBUG_H
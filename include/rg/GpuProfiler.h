@@ -0,0 +1,240 @@
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// GPU time and pipeline statistics of one render pass in one frame
+struct GpuPassTiming {
+    std::string name;
+    double gpuMs = 0.0;
+    // exponential moving average of gpuMs, for a readable ImGui view
+    double averageMs = 0.0;
+    // pipeline statistics, zero when ARB_pipeline_statistics_query is missing
+    GLuint64 primitivesSubmitted = 0;
+    GLuint64 fragmentInvocations = 0;
+    GLuint64 samplesPassed = 0;
+};
+
+struct GpuFrameTiming {
+    unsigned long long frame = 0;
+    double gpuMs = 0.0;
+    std::vector<GpuPassTiming> passes;
+};
+
+// Per-pass GPU profiler: every pass is bracketed by two GL_TIMESTAMP queries (timestamps, unlike
+// GL_TIME_ELAPSED, never conflict with a query that is already running) plus the statistics queries.
+// The query objects of FRAME_LATENCY frames live in a ring and a frame's results are only read back
+// when its slot comes around again, so reading them does not wait on the GPU. A frame whose results
+// are still not available by then is dropped instead.
+//
+// Passes must not nest, BeginPass closes the previous one if it is still open.
+class GpuProfiler {
+public:
+    static const unsigned int FRAME_LATENCY = 4;
+
+    bool enabled = true;
+    // resolved frames kept for the CSV export and the benchmark report
+    unsigned int historyFrames = 600;
+    // stall on results that are still not available instead of dropping the frame, for the benchmark
+    bool waitForResults = false;
+    unsigned int droppedFrames = 0;
+
+    GpuProfiler() = default;
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+    bool PipelineStatisticsAvailable() const {
+        return GLAD_GL_ARB_pipeline_statistics_query != 0;
+    }
+
+    void BeginFrame() {
+        frameOpen = enabled;
+        if (!frameOpen)
+            return;
+        FrameQueries &slot = slots[frameNumber % FRAME_LATENCY];
+        if (slot.submitted)
+            readBack(slot);
+        slot.frame = frameNumber;
+        slot.passCount = 0;
+        slot.submitted = false;
+        if (slot.frameQueries[0] == 0)
+            glGenQueries(2, slot.frameQueries);
+        glQueryCounter(slot.frameQueries[0], GL_TIMESTAMP);
+    }
+
+    void BeginPass(const char *name) {
+        if (!frameOpen)
+            return;
+        if (passOpen)
+            EndPass();
+        FrameQueries &slot = slots[frameNumber % FRAME_LATENCY];
+        if (slot.passCount == slot.passes.size()) {
+            slot.passes.emplace_back();
+            glGenQueries(QUERIES_PER_PASS, slot.passes.back().queries);
+        }
+        PassQueries &pass = slot.passes[slot.passCount++];
+        pass.name = name;
+        glQueryCounter(pass.queries[0], GL_TIMESTAMP);
+        if (PipelineStatisticsAvailable()) {
+            glBeginQuery(GL_PRIMITIVES_SUBMITTED_ARB, pass.queries[2]);
+            glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, pass.queries[3]);
+        }
+        glBeginQuery(GL_SAMPLES_PASSED, pass.queries[4]);
+        passOpen = true;
+    }
+
+    void EndPass() {
+        if (!passOpen)
+            return;
+        FrameQueries &slot = slots[frameNumber % FRAME_LATENCY];
+        PassQueries &pass = slot.passes[slot.passCount - 1];
+        if (PipelineStatisticsAvailable()) {
+            glEndQuery(GL_PRIMITIVES_SUBMITTED_ARB);
+            glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+        }
+        glEndQuery(GL_SAMPLES_PASSED);
+        glQueryCounter(pass.queries[1], GL_TIMESTAMP);
+        passOpen = false;
+    }
+
+    void EndFrame() {
+        if (!frameOpen)
+            return;
+        EndPass();
+        FrameQueries &slot = slots[frameNumber % FRAME_LATENCY];
+        glQueryCounter(slot.frameQueries[1], GL_TIMESTAMP);
+        slot.submitted = true;
+        frameOpen = false;
+        frameNumber++;
+    }
+
+    // number the next BeginFrame gives its frame, GpuFrameTiming::frame refers to these
+    unsigned long long FrameNumber() const {
+        return frameNumber;
+    }
+
+    // the newest frame that has been read back, empty until FRAME_LATENCY frames were rendered
+    const GpuFrameTiming &Latest() const {
+        return latest;
+    }
+
+    const std::deque<GpuFrameTiming> &History() const {
+        return history;
+    }
+
+    // reads back every frame still in flight, waiting for the GPU to finish them
+    void Drain() {
+        glFinish();
+        for (unsigned int i = 0; i < FRAME_LATENCY; i++) {
+            FrameQueries &slot = slots[(frameNumber + i) % FRAME_LATENCY];
+            if (slot.submitted)
+                readBack(slot);
+            slot.submitted = false;
+        }
+    }
+
+    // one row per pass and frame of the history
+    bool WriteCsv(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::GPU_PROFILER:: could not write " << path << std::endl;
+            return false;
+        }
+        out << "frame,pass,gpu_ms,primitives_submitted,fragment_invocations,samples_passed\n";
+        for (const GpuFrameTiming &frame : history) {
+            out << frame.frame << ",frame," << frame.gpuMs << ",,,\n";
+            for (const GpuPassTiming &pass : frame.passes)
+                out << frame.frame << "," << pass.name << "," << pass.gpuMs << "," << pass.primitivesSubmitted << ","
+                    << pass.fragmentInvocations << "," << pass.samplesPassed << "\n";
+        }
+        std::cout << "GPU_PROFILER:: wrote " << history.size() << " frames to " << path << std::endl;
+        return true;
+    }
+
+private:
+    // begin and end timestamp, primitives submitted, fragment shader invocations, samples passed
+    static const unsigned int QUERIES_PER_PASS = 5;
+
+    struct PassQueries {
+        std::string name;
+        unsigned int queries[QUERIES_PER_PASS] = {};
+    };
+
+    struct FrameQueries {
+        unsigned long long frame = 0;
+        bool submitted = false;
+        unsigned int frameQueries[2] = {};
+        std::vector<PassQueries> passes;
+        unsigned int passCount = 0;
+    };
+
+    FrameQueries slots[FRAME_LATENCY];
+    unsigned long long frameNumber = 0;
+    bool frameOpen = false;
+    bool passOpen = false;
+
+    GpuFrameTiming latest;
+    std::deque<GpuFrameTiming> history;
+    std::map<std::string, double> averages;
+
+    void readBack(const FrameQueries &slot) {
+        // the frame's last query finishing means all of its queries did
+        GLuint available = 0;
+        glGetQueryObjectuiv(slot.frameQueries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !waitForResults) {
+            droppedFrames++;
+            return;
+        }
+
+        GpuFrameTiming frame;
+        frame.frame = slot.frame;
+        frame.gpuMs = elapsedMs(slot.frameQueries[0], slot.frameQueries[1]);
+        for (unsigned int i = 0; i < slot.passCount; i++) {
+            const PassQueries &queries = slot.passes[i];
+            GpuPassTiming pass;
+            pass.name = queries.name;
+            pass.gpuMs = elapsedMs(queries.queries[0], queries.queries[1]);
+            if (PipelineStatisticsAvailable()) {
+                glGetQueryObjectui64v(queries.queries[2], GL_QUERY_RESULT, &pass.primitivesSubmitted);
+                glGetQueryObjectui64v(queries.queries[3], GL_QUERY_RESULT, &pass.fragmentInvocations);
+            }
+            glGetQueryObjectui64v(queries.queries[4], GL_QUERY_RESULT, &pass.samplesPassed);
+
+            auto average = averages.find(pass.name);
+            if (average == averages.end())
+                average = averages.emplace(pass.name, pass.gpuMs).first;
+            average->second += (pass.gpuMs - average->second) * 0.1;
+            pass.averageMs = average->second;
+            frame.passes.push_back(pass);
+        }
+
+        latest = frame;
+        history.push_back(frame);
+        if (history.size() > historyFrames)
+            history.pop_front();
+    }
+
+    static double elapsedMs(unsigned int begin, unsigned int end) {
+        GLuint64 beginNs = 0, endNs = 0;
+        glGetQueryObjectui64v(begin, GL_QUERY_RESULT, &beginNs);
+        glGetQueryObjectui64v(end, GL_QUERY_RESULT, &endNs);
+        return (double) (endNs - beginNs) / 1.0e6;
+    }
+};
+
+inline GpuProfiler &gpuProfiler() {
+    static GpuProfiler profiler;
+    return profiler;
+}
+
+};
+#endif //PROJECT_BASE_GPUPROFILER_H
@@ -0,0 +1,129 @@
+#ifndef PROJECT_BASE_HEADLESSCONTEXT_H
+#define PROJECT_BASE_HEADLESSCONTEXT_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <rg/GlDebug.h>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+// An OpenGL 3.3 core context without a window or display, for running on machines that have
+// neither. Uses the surfaceless EGL platform (EGL_MESA_platform_surfaceless, which Mesa provides
+// even without a GPU through llvmpipe) and falls back to the default EGL display. The context is
+// made current without a surface, so everything has to render into framebuffer objects.
+class HeadlessContext {
+public:
+    // a debug context, a no-error context otherwise; the same the window gets by default
+    bool debug = RG_GL_DEBUG_LAYER;
+
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext &) = delete;
+    HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+    ~HeadlessContext() {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+
+    bool Create() {
+        display = openDisplay();
+        EGLint major = 0, minor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            std::cout << "ERROR::HEADLESS:: could not initialize an EGL display" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return false;
+        }
+        const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (!hasExtension(extensions, "EGL_KHR_surfaceless_context")) {
+            std::cout << "ERROR::HEADLESS:: EGL_KHR_surfaceless_context is not supported" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cout << "ERROR::HEADLESS:: EGL cannot create desktop OpenGL contexts" << std::endl;
+            return false;
+        }
+
+        // EGL_SURFACE_TYPE defaults to EGL_WINDOW_BIT, which no surfaceless config has
+        const EGLint configAttributes[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+            std::cout << "ERROR::HEADLESS:: no EGL config supports OpenGL" << std::endl;
+            return false;
+        }
+
+        std::vector<EGLint> contextAttributes = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        };
+        if (debug) {
+            if (major > 1 || minor >= 5)
+                contextAttributes.insert(contextAttributes.end(), {EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE});
+        } else if (hasExtension(extensions, "EGL_KHR_create_context_no_error")) {
+            contextAttributes.insert(contextAttributes.end(), {EGL_CONTEXT_OPENGL_NO_ERROR_KHR, EGL_TRUE});
+        }
+        contextAttributes.push_back(EGL_NONE);
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes.data());
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "ERROR::HEADLESS:: could not create an OpenGL 3.3 core context (0x" << std::hex
+                      << eglGetError() << std::dec << ")" << std::endl;
+            return false;
+        }
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cout << "ERROR::HEADLESS:: could not make the context current" << std::endl;
+            return false;
+        }
+        std::cout << "HEADLESS:: EGL " << major << "." << minor << " context created" << std::endl;
+        return true;
+    }
+
+    // loader for gladLoadGLLoader
+    static void *GetProcAddress(const char *name) {
+        return (void *) eglGetProcAddress(name);
+    }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+
+    static bool hasExtension(const char *extensions, const char *name) {
+        if (extensions == nullptr)
+            return false;
+        size_t length = std::strlen(name);
+        for (const char *found = std::strstr(extensions, name); found; found = std::strstr(found + length, name)) {
+            if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+                return true;
+        }
+        return false;
+    }
+
+    static EGLDisplay openDisplay() {
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay) {
+                EGLDisplay surfaceless = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+                if (surfaceless != EGL_NO_DISPLAY)
+                    return surfaceless;
+            }
+        }
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+};
+
+};
+#endif //PROJECT_BASE_HEADLESSCONTEXT_H
@@ -0,0 +1,209 @@
+#ifndef PROJECT_BASE_IMPOSTOR_H
+#define PROJECT_BASE_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/DebugViews.h>
+#include <rg/RenderStats.h>
+#include <rg/Trace.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+// Octahedral impostor: the model is rendered from framesPerSide x framesPerSide directions spread
+// over the upper hemisphere (hemi-octahedral mapping) into an atlas holding albedo in one texture
+// and the object-space normal plus depth in another. At runtime each instance is a single
+// camera-facing quad that reprojects and blends the three atlas frames closest to the view direction.
+//
+// The frame layout has to match impostor.vs / impostor.fs.
+class Impostor {
+public:
+    unsigned int framesPerSide = 0;
+    unsigned int frameResolution = 0;
+    unsigned int albedoAtlas = 0;
+    unsigned int normalDepthAtlas = 0;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+
+    // hemi-octahedral grid coordinates in [-1, 1]^2 to a direction with y >= 0
+    static glm::vec3 FrameDirection(unsigned int x, unsigned int y, unsigned int framesPerSide) {
+        glm::vec2 e = glm::vec2((float) x, (float) y) / (float) (framesPerSide - 1) * 2.0f - 1.0f;
+        glm::vec2 t = glm::vec2(e.x + e.y, e.x - e.y) * 0.5f;
+        return glm::normalize(glm::vec3(t.x, 1.0f - std::abs(t.x) - std::abs(t.y), t.y));
+    }
+
+    // the up vector the bake camera uses for a frame, impostor.fs rebuilds the same basis
+    static glm::vec3 FrameUp(const glm::vec3 &direction) {
+        return std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    // renders the model into the atlas, bakeShader is impostor_bake.vs/fs
+    void Bake(Model &model, Shader &bakeShader, unsigned int framesPerSide = 8, unsigned int frameResolution = 128) {
+        TraceScope trace("bake impostor", model.directory);
+        this->framesPerSide = framesPerSide;
+        this->frameResolution = frameResolution;
+        boundsCenter = model.boundsCenter;
+        boundsRadius = model.boundsRadius;
+        unsigned int size = framesPerSide * frameResolution;
+
+        albedoAtlas = createAtlasTexture(size);
+        normalDepthAtlas = createAtlasTexture(size);
+        unsigned int depthBuffer;
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoAtlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepthAtlas, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::IMPOSTOR:: bake framebuffer is not complete" << std::endl;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        GLboolean cull = glIsEnabled(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        float r = boundsRadius;
+        glm::mat4 projection = glm::ortho(-r, r, -r, r, r, 3.0f * r);
+        bakeShader.use();
+        bakeShader.setMat4("projection", projection);
+        bakeShader.setMat4("model", glm::mat4(1.0f));
+        bakeShader.setVec3("boundsCenter", boundsCenter);
+        bakeShader.setFloat("boundsRadius", boundsRadius);
+        for (unsigned int y = 0; y < framesPerSide; y++) {
+            for (unsigned int x = 0; x < framesPerSide; x++) {
+                glm::vec3 direction = FrameDirection(x, y, framesPerSide);
+                glm::mat4 view = glm::lookAt(boundsCenter + direction * 2.0f * r, boundsCenter, FrameUp(direction));
+                glViewport(x * frameResolution, y * frameResolution, frameResolution, frameResolution);
+                bakeShader.setMat4("view", view);
+                bakeShader.setVec3("frameDirection", direction);
+                // always bake the full detail meshes
+                model.Draw(bakeShader);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (blend)
+            glEnable(GL_BLEND);
+        if (cull)
+            glEnable(GL_CULL_FACE);
+
+        for (unsigned int texture : {albedoAtlas, normalDepthAtlas}) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        setupQuad();
+    }
+
+    // draws one camera-facing quad per instance, shader is impostor.vs/fs with view, projection,
+    // viewPos and the light uniforms already set
+    void Draw(Shader &shader, const std::vector<InstanceData> &instances) {
+        if (instances.empty() || albedoAtlas == 0)
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        GLsizeiptr size = instances.size() * sizeof(InstanceData);
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, &instances[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        shader.setInt("albedoAtlas", 0);
+        shader.setInt("normalDepthAtlas", 1);
+        shader.setFloat("framesPerSide", (float) framesPerSide);
+        shader.setVec3("boundsCenter", boundsCenter);
+        shader.setFloat("boundsRadius", boundsRadius);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, albedoAtlas);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normalDepthAtlas);
+
+        glBindVertexArray(quadVAO);
+        debugViews().BeginDraw(shader, this, DebugViews::IMPOSTOR_LOD);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances.size());
+        debugViews().EndDraw();
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        countDraw(2, instances.size());
+    }
+
+private:
+    unsigned int quadVAO = 0;
+    unsigned int quadVBO = 0;
+    unsigned int instanceVBO = 0;
+
+    static unsigned int createAtlasTexture(unsigned int size) {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    void setupQuad() {
+        if (quadVAO != 0)
+            return;
+        float corners[] = {
+                -1.0f, -1.0f,
+                 1.0f, -1.0f,
+                -1.0f,  1.0f,
+                 1.0f,  1.0f,
+        };
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glGenBuffers(1, &instanceVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+        // same per-instance layout as Mesh::DrawInstanced
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (unsigned int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, ModelMatrix) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        for (unsigned int i = 0; i < 3; i++) {
+            glEnableVertexAttribArray(9 + i);
+            glVertexAttribPointer(9 + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, NormalMatrix) + i * sizeof(glm::vec3)));
+            glVertexAttribDivisor(9 + i, 1);
+        }
+        glEnableVertexAttribArray(12);
+        glVertexAttribPointer(12, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, Tint));
+        glVertexAttribDivisor(12, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+};
+#endif //PROJECT_BASE_IMPOSTOR_H
@@ -0,0 +1,116 @@
+#ifndef PROJECT_BASE_INPUTRECORDING_H
+#define PROJECT_BASE_INPUTRECORDING_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// simulated time per frame while replaying a recording, flying a camera path or benchmarking
+const float FIXED_TIMESTEP = 1.0f / 60.0f;
+
+// movement keys held during a frame, combined as a bit mask
+enum InputKey : unsigned int {
+    INPUT_KEY_FORWARD = 1u << 0,
+    INPUT_KEY_BACKWARD = 1u << 1,
+    INPUT_KEY_LEFT = 1u << 2,
+    INPUT_KEY_RIGHT = 1u << 3,
+};
+
+// one frame of a recording: the input that was processed and the camera it resulted in
+struct InputFrame {
+    float deltaTime = 0.0f;
+    unsigned int keys = 0;
+    // mouse movement and scrolling summed over the frame, as passed to the camera
+    float mouseX = 0.0f;
+    float mouseY = 0.0f;
+    float scroll = 0.0f;
+
+    glm::vec3 position = glm::vec3(0.0f);
+    float yaw = 0.0f;
+    float pitch = 0.0f;
+    float zoom = 0.0f;
+};
+
+// Per-frame input and camera state of an interactive session, saved as one line of text per
+// frame. Replaying restores the recorded camera state frame by frame instead of feeding the input
+// through the camera again, so the result does not depend on the frame times of the recording
+// machine. The floats are written with max_digits10 so they come back bit for bit.
+class InputRecording {
+public:
+    std::vector<InputFrame> frames;
+
+    void Record(const InputFrame &input, const Camera &camera) {
+        InputFrame frame = input;
+        frame.position = camera.Position;
+        frame.yaw = camera.Yaw;
+        frame.pitch = camera.Pitch;
+        frame.zoom = camera.Zoom;
+        frames.push_back(frame);
+    }
+
+    // sets the camera to the state after frame
+    void Apply(unsigned int frame, Camera &camera) const {
+        const InputFrame &recorded = frames[std::min<size_t>(frame, frames.size() - 1)];
+        camera.SetState(recorded.position, recorded.yaw, recorded.pitch, recorded.zoom);
+    }
+
+    bool Save(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::INPUT_RECORDING:: could not write " << path << std::endl;
+            return false;
+        }
+        out.precision(std::numeric_limits<float>::max_digits10);
+        out << "# delta_time keys mouse_x mouse_y scroll position.x position.y position.z yaw pitch zoom\n";
+        for (const InputFrame &frame : frames) {
+            out << frame.deltaTime << ' ' << frame.keys << ' ' << frame.mouseX << ' ' << frame.mouseY << ' '
+                << frame.scroll << ' ' << frame.position.x << ' ' << frame.position.y << ' ' << frame.position.z
+                << ' ' << frame.yaw << ' ' << frame.pitch << ' ' << frame.zoom << '\n';
+        }
+        std::cout << "INPUT_RECORDING:: wrote " << frames.size() << " frames to " << path << std::endl;
+        return true;
+    }
+
+    bool Load(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::INPUT_RECORDING:: could not read " << path << std::endl;
+            return false;
+        }
+        frames.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream fields(line);
+            InputFrame frame;
+            fields >> frame.deltaTime >> frame.keys >> frame.mouseX >> frame.mouseY >> frame.scroll
+                   >> frame.position.x >> frame.position.y >> frame.position.z >> frame.yaw >> frame.pitch
+                   >> frame.zoom;
+            if (!fields) {
+                std::cout << "ERROR::INPUT_RECORDING:: malformed frame " << frames.size() << " in " << path
+                          << std::endl;
+                return false;
+            }
+            frames.push_back(frame);
+        }
+        if (frames.empty()) {
+            std::cout << "ERROR::INPUT_RECORDING:: " << path << " has no frames" << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+};
+#endif //PROJECT_BASE_INPUTRECORDING_H
@@ -0,0 +1,72 @@
+#ifndef PROJECT_BASE_LOD_H
+#define PROJECT_BASE_LOD_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+// per-frame inputs for picking a level of detail
+struct LodSettings {
+    bool enabled = true;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    // pixels covered by one world unit at distance one, see projectionScale()
+    float projectionScale = 1.0f;
+    // a level is good enough while its error stays below this many pixels
+    float pixelThreshold = 1.0f;
+    // each step of bias doubles (positive) or halves (negative) the threshold
+    float bias = 0.0f;
+    // relative margin a level has to clear before we switch to it
+    float hysteresis = 0.25f;
+};
+
+// The level every mesh of one placed model is drawn at, indexed like Model::meshes. It is the state
+// selectLod's hysteresis works from, so it belongs to the placement: instances sharing a Model each
+// keep their own. Empty draws every mesh at full detail.
+typedef std::vector<unsigned int> LodLevels;
+
+inline unsigned int lodLevel(const LodLevels &levels, size_t mesh) {
+    return mesh < levels.size() ? levels[mesh] : 0;
+}
+
+inline float projectionScale(float fovYRadians, float viewportHeight) {
+    return viewportHeight / (2.0f * std::tan(fovYRadians * 0.5f));
+}
+
+// Picks the coarsest level whose projected error stays under the threshold.
+// errors[i] is the object-space error of level i (errors[0] == 0), worldScale converts it to world
+// units and distance is the distance from the camera to the closest point of the bounds.
+// Switching only happens once the threshold is cleared by the hysteresis margin, so objects
+// sitting at a transition distance do not pop back and forth every frame.
+inline unsigned int selectLod(const std::vector<float> &errors, unsigned int current, float worldScale,
+                              float distance, const LodSettings &settings) {
+    if (!settings.enabled || errors.empty())
+        return 0;
+    float threshold = settings.pixelThreshold * std::exp2(settings.bias);
+    float pixelsPerUnit = worldScale * settings.projectionScale / std::max(distance, 1e-4f);
+
+    unsigned int desired = 0;
+    for (unsigned int i = 1; i < errors.size(); ++i) {
+        if (errors[i] * pixelsPerUnit <= threshold)
+            desired = i;
+    }
+    if (current >= errors.size())
+        return desired;
+
+    // going coarser: the new level has to be comfortably below the threshold
+    unsigned int coarser = current;
+    for (unsigned int i = current + 1; i < errors.size(); ++i) {
+        if (errors[i] * pixelsPerUnit <= threshold * (1.0f - settings.hysteresis))
+            coarser = i;
+    }
+    if (coarser != current)
+        return coarser;
+    // going finer: only once the current level is clearly too coarse
+    if (errors[current] * pixelsPerUnit > threshold * (1.0f + settings.hysteresis))
+        return desired;
+    return current;
+}
+
+};
+#endif //PROJECT_BASE_LOD_H
@@ -0,0 +1,184 @@
+#ifndef PROJECT_BASE_MEMORYSTATS_H
+#define PROJECT_BASE_MEMORYSTATS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// what one model or texture costs, all in bytes
+struct AssetMemory {
+    std::string name;
+    // "model", "texture" or "cubemap"
+    std::string kind;
+    // vertex and element buffers
+    size_t gpuBufferBytes = 0;
+    // every mip level of every face, see textureBytes()
+    size_t gpuTextureBytes = 0;
+    // geometry kept on the CPU after the upload (Mesh::vertices, indices, elements and the LOD tables)
+    size_t cpuGeometryBytes = 0;
+    // peak of the temporary memory loading needed: the decoded image, or assimp's imported scene
+    size_t decoderScratchBytes = 0;
+};
+
+// The driver's own numbers, where an extension reports them. NVX reports the dedicated and
+// currently available video memory, ATI only the free texture and buffer pools.
+struct DriverMemory {
+    // "GL_NVX_gpu_memory_info", "GL_ATI_meminfo" or empty when neither is supported
+    std::string source;
+    GLint dedicatedKb = 0;
+    GLint totalAvailableKb = 0;
+    GLint currentAvailableKb = 0;
+    GLint evictedKb = 0;
+    GLint textureFreeKb = 0;
+    GLint bufferFreeKb = 0;
+};
+
+// bytes of a width x height image with bytesPerTexel, plus its full mip chain when mipmapped
+inline size_t textureBytes(int width, int height, size_t bytesPerTexel, bool mipmapped) {
+    size_t bytes = 0;
+    while (true) {
+        bytes += (size_t) width * (size_t) height * bytesPerTexel;
+        if (!mipmapped || (width == 1 && height == 1))
+            break;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return bytes;
+}
+
+// Estimated memory of every loaded model and texture, filled in by the loaders. The GPU side is
+// computed from the uploads, drivers add alignment and padding on top: three channel textures are
+// counted as four bytes per texel since that is how drivers store RGB8.
+class MemoryStats {
+public:
+    MemoryStats() = default;
+    MemoryStats(const MemoryStats &) = delete;
+    MemoryStats &operator=(const MemoryStats &) = delete;
+
+    const std::vector<AssetMemory> &Assets() const {
+        return assets;
+    }
+
+    // the model entry of path, created on first use
+    AssetMemory &ModelEntry(const std::string &path) {
+        return assets[entryIndex(path, "model")];
+    }
+
+    // adds one uploaded image (a cubemap calls it per face) to the texture with the GL name id
+    void AddTexture(unsigned int id, const std::string &name, const std::string &kind, int width, int height,
+                    int components, bool mipmapped) {
+        // a file loaded twice (by two models) ends up in the same entry with both copies counted
+        auto found = textureIndex.find(id);
+        if (found == textureIndex.end())
+            found = textureIndex.emplace(id, entryIndex(name, kind)).first;
+        AssetMemory &texture = assets[found->second];
+        size_t decoded = (size_t) width * (size_t) height * (size_t) components;
+        texture.gpuTextureBytes += textureBytes(width, height, components == 3 ? 4 : (size_t) components, mipmapped);
+        texture.decoderScratchBytes = std::max(texture.decoderScratchBytes, decoded);
+    }
+
+    // scratch memory is freed after each load, its total is the largest single peak
+    AssetMemory Totals() const {
+        AssetMemory totals;
+        totals.name = "total";
+        for (const AssetMemory &asset : assets) {
+            totals.gpuBufferBytes += asset.gpuBufferBytes;
+            totals.gpuTextureBytes += asset.gpuTextureBytes;
+            totals.cpuGeometryBytes += asset.cpuGeometryBytes;
+            totals.decoderScratchBytes = std::max(totals.decoderScratchBytes, asset.decoderScratchBytes);
+        }
+        return totals;
+    }
+
+    // needs a current context
+    static DriverMemory QueryDriver() {
+        DriverMemory driver;
+        if (GLAD_GL_NVX_gpu_memory_info) {
+            driver.source = "GL_NVX_gpu_memory_info";
+            glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &driver.dedicatedKb);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &driver.totalAvailableKb);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &driver.currentAvailableKb);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX, &driver.evictedKb);
+        } else if (GLAD_GL_ATI_meminfo) {
+            // total free, largest free block, total auxiliary free, largest auxiliary block
+            GLint texture[4] = {}, buffer[4] = {};
+            driver.source = "GL_ATI_meminfo";
+            glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, texture);
+            glGetIntegerv(GL_VBO_FREE_MEMORY_ATI, buffer);
+            driver.textureFreeKb = texture[0];
+            driver.bufferFreeKb = buffer[0];
+        }
+        return driver;
+    }
+
+    bool WriteJson(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::MEMORY_STATS:: could not write " << path << std::endl;
+            return false;
+        }
+        out << "{\n  \"assets\": [";
+        for (size_t i = 0; i < assets.size(); i++)
+            out << (i ? "," : "") << "\n    " << jsonAsset(assets[i]);
+        out << "\n  ],\n  \"totals\": " << jsonAsset(Totals()) << ",\n  \"driver\": ";
+        DriverMemory driver = QueryDriver();
+        if (driver.source.empty()) {
+            out << "null";
+        } else {
+            out << "{\"source\": \"" << driver.source << "\", \"dedicated_kb\": " << driver.dedicatedKb
+                << ", \"total_available_kb\": " << driver.totalAvailableKb << ", \"current_available_kb\": "
+                << driver.currentAvailableKb << ", \"evicted_kb\": " << driver.evictedKb << ", \"texture_free_kb\": "
+                << driver.textureFreeKb << ", \"buffer_free_kb\": " << driver.bufferFreeKb << "}";
+        }
+        out << "\n}\n";
+        std::cout << "MEMORY_STATS:: wrote " << assets.size() << " assets to " << path << std::endl;
+        return true;
+    }
+
+private:
+    std::vector<AssetMemory> assets;
+    std::map<std::string, size_t> nameIndex;
+    std::map<unsigned int, size_t> textureIndex;
+
+    size_t entryIndex(const std::string &name, const std::string &kind) {
+        auto found = nameIndex.find(kind + ":" + name);
+        if (found != nameIndex.end())
+            return found->second;
+        nameIndex.emplace(kind + ":" + name, assets.size());
+        assets.emplace_back();
+        assets.back().name = name;
+        assets.back().kind = kind;
+        return assets.size() - 1;
+    }
+
+    static std::string jsonAsset(const AssetMemory &asset) {
+        std::string name;
+        for (char c : asset.name) {
+            if (c == '"' || c == '\\')
+                name += '\\';
+            if ((unsigned char) c >= 0x20)
+                name += c;
+        }
+        return "{\"name\": \"" + name + "\", \"kind\": \"" + asset.kind + "\", \"gpu_buffer_bytes\": " +
+               std::to_string(asset.gpuBufferBytes) + ", \"gpu_texture_bytes\": " +
+               std::to_string(asset.gpuTextureBytes) + ", \"cpu_geometry_bytes\": " +
+               std::to_string(asset.cpuGeometryBytes) + ", \"decoder_scratch_bytes\": " +
+               std::to_string(asset.decoderScratchBytes) + "}";
+    }
+};
+
+inline MemoryStats &memoryStats() {
+    static MemoryStats stats;
+    return stats;
+}
+
+};
+#endif //PROJECT_BASE_MEMORYSTATS_H
@@ -0,0 +1,350 @@
+#ifndef PROJECT_BASE_MESHSIMPLIFIER_H
+#define PROJECT_BASE_MESHSIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// Quadric error metric simplifier (Garland & Heckbert) working with half-edge collapses.
+// Collapsing a vertex onto one of its neighbours never creates new vertices, so every
+// level of detail produced here indexes into the vertex buffer of the original mesh.
+//
+// VertexT needs Position, Normal and TexCoords members.
+template<typename VertexT>
+class MeshSimplifier {
+public:
+    explicit MeshSimplifier(const std::vector<VertexT> &vertices)
+        : m_Vertices(vertices) {
+        weldPositions();
+    }
+
+    // Simplifies the triangle list until it has at most targetIndexCount indices or no
+    // collapse is left that keeps the surface intact. Returns the new index list and stores
+    // the object-space error of this pass against the input indices: the square root of the
+    // worst collapse cost, which is the area-weighted mean squared distance of the kept vertex
+    // to the planes of the triangles merged into it.
+    std::vector<unsigned int> simplify(const std::vector<unsigned int> &indices, size_t targetIndexCount,
+                                       float &error) {
+        error = 0.0f;
+        buildTopology(indices);
+        buildQuadrics();
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        for (unsigned int p = 0; p < m_PositionCount; ++p)
+            pushCollapses(p, queue);
+
+        size_t targetTriangles = targetIndexCount / 3;
+        double worstError = 0.0;
+        while (m_AliveTriangles > targetTriangles && !queue.empty()) {
+            Collapse c = queue.top();
+            queue.pop();
+            if (m_Removed[c.from] || m_Removed[c.to] ||
+                c.fromVersion != m_Version[c.from] || c.toVersion != m_Version[c.to])
+                continue;
+            if (flipsTriangles(c.from, c.to))
+                continue;
+            collapse(c.from, c.to);
+            worstError = std::max(worstError, c.cost);
+            pushCollapses(c.to, queue);
+            for (unsigned int n : m_Neighbours)
+                pushCollapses(n, queue);
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(m_AliveTriangles * 3);
+        for (size_t t = 0; t < m_Triangles.size(); ++t) {
+            if (!m_TriangleAlive[t])
+                continue;
+            result.insert(result.end(), m_Triangles[t].v, m_Triangles[t].v + 3);
+        }
+        error = (float) std::sqrt(worstError);
+        return result;
+    }
+
+private:
+    // symmetric 4x4 matrix stored as its upper triangle, plus the accumulated area
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3 &n, double d, double w) {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+            a22 += w * n.z * n.z; a23 += w * n.z * d;
+            a33 += w * d * d;
+        }
+        void add(const Quadric &q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            weight += q.weight;
+        }
+        double evaluate(const glm::dvec3 &v) const {
+            double r = a00 * v.x * v.x + 2 * a01 * v.x * v.y + 2 * a02 * v.x * v.z + 2 * a03 * v.x
+                     + a11 * v.y * v.y + 2 * a12 * v.y * v.z + 2 * a13 * v.y
+                     + a22 * v.z * v.z + 2 * a23 * v.z
+                     + a33;
+            return std::max(r, 0.0);
+        }
+    };
+
+    struct Triangle {
+        unsigned int v[3];
+    };
+
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    // border edges get constraint planes this many times heavier than the surface
+    static constexpr double BORDER_WEIGHT = 10.0;
+
+    const std::vector<VertexT> &m_Vertices;
+    std::vector<unsigned int> m_PositionOf;   // vertex -> welded position
+    std::vector<glm::dvec3> m_Positions;
+    unsigned int m_PositionCount = 0;
+
+    std::vector<Triangle> m_Triangles;
+    std::vector<bool> m_TriangleAlive;
+    size_t m_AliveTriangles = 0;
+    std::vector<std::vector<unsigned int>> m_TrianglesAt;   // position -> triangles
+    std::vector<std::vector<unsigned int>> m_WedgesAt;      // position -> vertices sharing it
+    std::vector<Quadric> m_Quadrics;
+    std::vector<unsigned int> m_Version;
+    std::vector<bool> m_Removed;
+    std::vector<unsigned int> m_Neighbours;
+
+    void weldPositions() {
+        struct Key {
+            float x, y, z;
+            bool operator==(const Key &o) const { return x == o.x && y == o.y && z == o.z; }
+        };
+        struct KeyHash {
+            size_t operator()(const Key &k) const {
+                unsigned int h[3];
+                std::memcpy(h, &k, sizeof(h));
+                return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+            }
+        };
+        std::unordered_map<Key, unsigned int, KeyHash> welded;
+        m_PositionOf.resize(m_Vertices.size());
+        for (size_t i = 0; i < m_Vertices.size(); ++i) {
+            const glm::vec3 &p = m_Vertices[i].Position;
+            Key key = {p.x, p.y, p.z};
+            auto it = welded.find(key);
+            if (it == welded.end()) {
+                it = welded.emplace(key, (unsigned int) m_Positions.size()).first;
+                m_Positions.push_back(glm::dvec3(p.x, p.y, p.z));
+            }
+            m_PositionOf[i] = it->second;
+        }
+        m_PositionCount = (unsigned int) m_Positions.size();
+    }
+
+    void buildTopology(const std::vector<unsigned int> &indices) {
+        m_Triangles.clear();
+        m_TrianglesAt.assign(m_PositionCount, std::vector<unsigned int>());
+        m_WedgesAt.assign(m_PositionCount, std::vector<unsigned int>());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            Triangle t = {{indices[i], indices[i + 1], indices[i + 2]}};
+            unsigned int p0 = m_PositionOf[t.v[0]], p1 = m_PositionOf[t.v[1]], p2 = m_PositionOf[t.v[2]];
+            // triangles that are already degenerate are dropped right away
+            if (p0 == p1 || p1 == p2 || p0 == p2)
+                continue;
+            unsigned int index = (unsigned int) m_Triangles.size();
+            m_Triangles.push_back(t);
+            for (unsigned int k = 0; k < 3; ++k) {
+                unsigned int p = m_PositionOf[t.v[k]];
+                m_TrianglesAt[p].push_back(index);
+                std::vector<unsigned int> &wedges = m_WedgesAt[p];
+                if (std::find(wedges.begin(), wedges.end(), t.v[k]) == wedges.end())
+                    wedges.push_back(t.v[k]);
+            }
+        }
+        m_TriangleAlive.assign(m_Triangles.size(), true);
+        m_AliveTriangles = m_Triangles.size();
+        m_Version.assign(m_PositionCount, 0);
+        m_Removed.assign(m_PositionCount, false);
+    }
+
+    void buildQuadrics() {
+        m_Quadrics.assign(m_PositionCount, Quadric());
+        std::unordered_map<unsigned long long, int> edgeUses;
+        for (const Triangle &t : m_Triangles) {
+            for (unsigned int k = 0; k < 3; ++k)
+                edgeUses[edgeKey(m_PositionOf[t.v[k]], m_PositionOf[t.v[(k + 1) % 3]])]++;
+        }
+
+        for (const Triangle &t : m_Triangles) {
+            unsigned int p[3] = {m_PositionOf[t.v[0]], m_PositionOf[t.v[1]], m_PositionOf[t.v[2]]};
+            glm::dvec3 normal = glm::cross(m_Positions[p[1]] - m_Positions[p[0]], m_Positions[p[2]] - m_Positions[p[0]]);
+            double doubleArea = glm::length(normal);
+            if (doubleArea == 0.0)
+                continue;
+            normal /= doubleArea;
+            double area = doubleArea * 0.5;
+            Quadric q;
+            q.addPlane(normal, -glm::dot(normal, m_Positions[p[0]]), area);
+            q.weight = area;
+            for (unsigned int k = 0; k < 3; ++k)
+                m_Quadrics[p[k]].add(q);
+
+            // keep open borders in place with planes perpendicular to the surface
+            for (unsigned int k = 0; k < 3; ++k) {
+                unsigned int a = p[k], b = p[(k + 1) % 3];
+                if (edgeUses[edgeKey(a, b)] != 1)
+                    continue;
+                glm::dvec3 edge = m_Positions[b] - m_Positions[a];
+                double length = glm::length(edge);
+                if (length == 0.0)
+                    continue;
+                glm::dvec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+                Quadric border;
+                border.addPlane(borderNormal, -glm::dot(borderNormal, m_Positions[a]), length * length * BORDER_WEIGHT);
+                m_Quadrics[a].add(border);
+                m_Quadrics[b].add(border);
+            }
+        }
+    }
+
+    static unsigned long long edgeKey(unsigned int a, unsigned int b) {
+        if (a > b)
+            std::swap(a, b);
+        return ((unsigned long long) a << 32) | b;
+    }
+
+    double collapseCost(unsigned int from, unsigned int to) const {
+        Quadric q = m_Quadrics[from];
+        q.add(m_Quadrics[to]);
+        return q.evaluate(m_Positions[to]) / std::max(q.weight, 1e-12);
+    }
+
+    void gatherNeighbours(unsigned int p) {
+        m_Neighbours.clear();
+        for (unsigned int t : m_TrianglesAt[p]) {
+            if (!m_TriangleAlive[t])
+                continue;
+            for (unsigned int k = 0; k < 3; ++k) {
+                unsigned int n = m_PositionOf[m_Triangles[t].v[k]];
+                if (n != p && std::find(m_Neighbours.begin(), m_Neighbours.end(), n) == m_Neighbours.end())
+                    m_Neighbours.push_back(n);
+            }
+        }
+    }
+
+    template<typename Queue>
+    void pushCollapses(unsigned int p, Queue &queue) {
+        if (m_Removed[p])
+            return;
+        std::vector<unsigned int> neighbours;
+        for (unsigned int t : m_TrianglesAt[p]) {
+            if (!m_TriangleAlive[t])
+                continue;
+            for (unsigned int k = 0; k < 3; ++k) {
+                unsigned int n = m_PositionOf[m_Triangles[t].v[k]];
+                if (n != p && std::find(neighbours.begin(), neighbours.end(), n) == neighbours.end())
+                    neighbours.push_back(n);
+            }
+        }
+        for (unsigned int n : neighbours)
+            queue.push({collapseCost(p, n), p, n, m_Version[p], m_Version[n]});
+    }
+
+    // rejects collapses that would turn a surviving triangle around
+    bool flipsTriangles(unsigned int from, unsigned int to) const {
+        for (unsigned int t : m_TrianglesAt[from]) {
+            if (!m_TriangleAlive[t])
+                continue;
+            unsigned int p[3];
+            bool hasTo = false;
+            for (unsigned int k = 0; k < 3; ++k) {
+                p[k] = m_PositionOf[m_Triangles[t].v[k]];
+                hasTo = hasTo || p[k] == to;
+            }
+            if (hasTo)
+                continue;
+            glm::dvec3 before = glm::cross(m_Positions[p[1]] - m_Positions[p[0]], m_Positions[p[2]] - m_Positions[p[0]]);
+            for (unsigned int k = 0; k < 3; ++k) {
+                if (p[k] == from)
+                    p[k] = to;
+            }
+            glm::dvec3 after = glm::cross(m_Positions[p[1]] - m_Positions[p[0]], m_Positions[p[2]] - m_Positions[p[0]]);
+            double lengths = glm::length(before) * glm::length(after);
+            if (lengths == 0.0 || glm::dot(before, after) < 0.2 * lengths)
+                return true;
+        }
+        return false;
+    }
+
+    // picks the vertex at position `to` whose attributes are closest to `wedge`,
+    // so texture seams running through `to` stay intact
+    unsigned int matchingWedge(unsigned int wedge, unsigned int to) const {
+        const VertexT &source = m_Vertices[wedge];
+        unsigned int best = m_WedgesAt[to][0];
+        float bestDistance = -1.0f;
+        for (unsigned int candidate : m_WedgesAt[to]) {
+            const VertexT &v = m_Vertices[candidate];
+            glm::vec2 dUv = v.TexCoords - source.TexCoords;
+            glm::vec3 dN = v.Normal - source.Normal;
+            float distance = glm::dot(dUv, dUv) + glm::dot(dN, dN);
+            if (bestDistance < 0.0f || distance < bestDistance) {
+                best = candidate;
+                bestDistance = distance;
+            }
+        }
+        return best;
+    }
+
+    void collapse(unsigned int from, unsigned int to) {
+        for (unsigned int t : m_TrianglesAt[from]) {
+            if (!m_TriangleAlive[t])
+                continue;
+            Triangle &tri = m_Triangles[t];
+            bool hasTo = false;
+            for (unsigned int k = 0; k < 3; ++k)
+                hasTo = hasTo || m_PositionOf[tri.v[k]] == to;
+            if (hasTo) {
+                m_TriangleAlive[t] = false;
+                --m_AliveTriangles;
+                continue;
+            }
+            for (unsigned int k = 0; k < 3; ++k) {
+                if (m_PositionOf[tri.v[k]] == from)
+                    tri.v[k] = matchingWedge(tri.v[k], to);
+            }
+            m_TrianglesAt[to].push_back(t);
+        }
+        m_TrianglesAt[from].clear();
+        m_Removed[from] = true;
+        m_Quadrics[to].add(m_Quadrics[from]);
+
+        // drop dead triangles so the adjacency lists do not keep growing
+        std::vector<unsigned int> &around = m_TrianglesAt[to];
+        around.erase(std::remove_if(around.begin(), around.end(),
+                                    [this](unsigned int t) { return !m_TriangleAlive[t]; }),
+                     around.end());
+
+        gatherNeighbours(to);
+        ++m_Version[to];
+        for (unsigned int n : m_Neighbours)
+            ++m_Version[n];
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_MESHSIMPLIFIER_H
@@ -0,0 +1,273 @@
+#ifndef PROJECT_BASE_MICROBENCH_H
+#define PROJECT_BASE_MICROBENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// keeps the compiler from dropping a computation whose result is never used
+template<typename T>
+inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+// the 97.5% quantile of Student's t distribution, the half width of a two-sided 95% interval in
+// standard errors, interpolated in 1/df between the tabulated values
+inline double studentT975(double degreesOfFreedom) {
+    static const double table[][2] = {{1, 12.706}, {2, 4.303}, {3, 3.182}, {4, 2.776}, {5, 2.571}, {6, 2.447},
+                                      {7, 2.365}, {8, 2.306}, {9, 2.262}, {10, 2.228}, {12, 2.179}, {15, 2.131},
+                                      {20, 2.086}, {25, 2.060}, {30, 2.042}, {40, 2.021}, {60, 2.000},
+                                      {120, 1.980}};
+    if (degreesOfFreedom <= 1.0)
+        return table[0][1];
+    double previousDf = 0.0, previousT = 0.0;
+    for (const auto &row : table) {
+        if (degreesOfFreedom <= row[0]) {
+            double weight = (1.0 / previousDf - 1.0 / degreesOfFreedom) / (1.0 / previousDf - 1.0 / row[0]);
+            return previousT + (row[1] - previousT) * weight;
+        }
+        previousDf = row[0];
+        previousT = row[1];
+    }
+    double weight = (1.0 / 120.0 - 1.0 / degreesOfFreedom) / (1.0 / 120.0);
+    return 1.980 + (1.960 - 1.980) * weight;
+}
+
+// one benchmark, every time in nanoseconds per iteration
+struct BenchResult {
+    std::string name;
+    unsigned int samples = 0;
+    // iterations timed together in every sample
+    unsigned long long iterations = 0;
+    // what one iteration processes (vertices, pixels, objects), for the throughput
+    double items = 1.0;
+    double mean = 0.0;
+    double median = 0.0;
+    double minimum = 0.0;
+    // of the sample means, not of single iterations
+    double stddev = 0.0;
+    // 95% confidence interval of the mean
+    double ciLow = 0.0;
+    double ciHigh = 0.0;
+
+    double ItemsPerSecond() const {
+        return mean > 0.0 ? items * 1e9 / mean : 0.0;
+    }
+};
+
+inline BenchResult benchStatistics(const std::string &name, std::vector<double> samples,
+                                   unsigned long long iterations, double items) {
+    BenchResult result;
+    result.name = name;
+    result.samples = (unsigned int) samples.size();
+    result.iterations = iterations;
+    result.items = items;
+    if (samples.empty())
+        return result;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+    result.mean = sum / samples.size();
+    size_t middle = samples.size() / 2;
+    result.median = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) * 0.5;
+    result.minimum = samples.front();
+    double squares = 0.0;
+    for (double sample : samples)
+        squares += (sample - result.mean) * (sample - result.mean);
+    result.stddev = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0.0;
+    double halfWidth = samples.size() > 1 ? studentT975(samples.size() - 1.0) * result.stddev /
+                                            std::sqrt((double) samples.size()) : 0.0;
+    result.ciLow = result.mean - halfWidth;
+    result.ciHigh = result.mean + halfWidth;
+    return result;
+}
+
+// Times small pieces of code. Every benchmark is warmed up, then the number of iterations timed
+// together is raised until one sample takes minSampleMs, so the clock resolution and the timing
+// overhead vanish. Then samples are taken until there are samples of them or maxSeconds passed,
+// with at least minSamples. The mean per iteration gets a 95% confidence interval from Student's t
+// over the sample means, which are close to normal even when single iterations are not.
+class MicroBench {
+public:
+    // runs only the benchmarks whose name contains it
+    std::string filter;
+    double minSampleMs = 10.0;
+    unsigned int samples = 30;
+    unsigned int minSamples = 5;
+    double maxSeconds = 3.0;
+
+    std::vector<BenchResult> results;
+
+    MicroBench() = default;
+    MicroBench(const MicroBench &) = delete;
+    MicroBench &operator=(const MicroBench &) = delete;
+
+    bool Selected(const std::string &name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // times body(), which runs one iteration processing items things
+    template<typename Body>
+    void Run(const std::string &name, double items, Body &&body) {
+        if (!Selected(name))
+            return;
+        using Clock = std::chrono::steady_clock;
+        auto timeIterations = [&](unsigned long long iterations) {
+            Clock::time_point start = Clock::now();
+            for (unsigned long long i = 0; i < iterations; i++)
+                body();
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        };
+
+        // warm up the caches and the branch predictors while calibrating
+        double minSampleNs = minSampleMs * 1e6;
+        unsigned long long iterations = 1;
+        double elapsed = timeIterations(iterations);
+        while (elapsed < minSampleNs) {
+            double scale = elapsed > 0.0 ? std::min(minSampleNs * 1.2 / elapsed, 10.0) : 10.0;
+            iterations = std::max(iterations + 1, (unsigned long long) std::ceil(iterations * scale));
+            elapsed = timeIterations(iterations);
+        }
+
+        std::vector<double> perIteration;
+        Clock::time_point start = Clock::now();
+        while (perIteration.size() < samples) {
+            perIteration.push_back(timeIterations(iterations) / iterations);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (seconds > maxSeconds && perIteration.size() >= minSamples)
+                break;
+        }
+        results.push_back(benchStatistics(name, perIteration, iterations, items));
+        print(results.back());
+    }
+
+    // one benchmark per line, which is what Read expects
+    bool Write(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::BENCH:: could not write " << path << std::endl;
+            return false;
+        }
+        out << std::setprecision(10) << "{\n  \"min_sample_ms\": " << minSampleMs << ",\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult &result = results[i];
+            out << (i ? "," : "") << "\n    {\"name\": \"" << result.name << "\", \"samples\": " << result.samples
+                << ", \"iterations\": " << result.iterations << ", \"items\": " << result.items
+                << ", \"mean_ns\": " << result.mean << ", \"median_ns\": " << result.median
+                << ", \"min_ns\": " << result.minimum << ", \"stddev_ns\": " << result.stddev
+                << ", \"ci95_low_ns\": " << result.ciLow << ", \"ci95_high_ns\": " << result.ciHigh
+                << ", \"items_per_second\": " << result.ItemsPerSecond() << "}";
+        }
+        out << "\n  ]\n}\n";
+        std::cout << "BENCH:: wrote " << results.size() << " benchmarks to " << path << std::endl;
+        return true;
+    }
+
+    static bool Read(const std::string &path, std::vector<BenchResult> &results) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::BENCH:: could not read " << path << std::endl;
+            return false;
+        }
+        static const std::regex name("\"name\": \"([^\"]*)\""),
+                number("\"(\\w+)\": (-?[0-9.eE+-]+)");
+        std::string line;
+        while (std::getline(in, line)) {
+            std::smatch match;
+            if (!std::regex_search(line, match, name))
+                continue;
+            BenchResult result;
+            result.name = match[1];
+            for (std::sregex_iterator field(line.begin(), line.end(), number), end; field != end; ++field) {
+                std::string key = (*field)[1];
+                double value = std::stod((*field)[2]);
+                if (key == "samples")
+                    result.samples = (unsigned int) value;
+                else if (key == "iterations")
+                    result.iterations = (unsigned long long) value;
+                else if (key == "items")
+                    result.items = value;
+                else if (key == "mean_ns")
+                    result.mean = value;
+                else if (key == "median_ns")
+                    result.median = value;
+                else if (key == "min_ns")
+                    result.minimum = value;
+                else if (key == "stddev_ns")
+                    result.stddev = value;
+                else if (key == "ci95_low_ns")
+                    result.ciLow = value;
+                else if (key == "ci95_high_ns")
+                    result.ciHigh = value;
+            }
+            results.push_back(result);
+        }
+        return true;
+    }
+
+    // Welch's t-test of every benchmark against the same one in baseline, a change only counts when
+    // the means differ at 95% confidence. Returns the number of benchmarks that got slower.
+    unsigned int Compare(const std::vector<BenchResult> &baseline) const {
+        std::map<std::string, const BenchResult *> previous;
+        for (const BenchResult &result : baseline)
+            previous[result.name] = &result;
+        unsigned int slower = 0;
+        for (const BenchResult &result : results) {
+            auto found = previous.find(result.name);
+            if (found == previous.end() || found->second->samples < 2 || result.samples < 2)
+                continue;
+            const BenchResult &before = *found->second;
+            double errorBefore = before.stddev * before.stddev / before.samples;
+            double errorNow = result.stddev * result.stddev / result.samples;
+            double error = std::sqrt(errorBefore + errorNow);
+            double change = before.mean > 0.0 ? (result.mean - before.mean) / before.mean * 100.0 : 0.0;
+            bool significant;
+            if (error > 0.0) {
+                double degreesOfFreedom = (errorBefore + errorNow) * (errorBefore + errorNow) /
+                                          (errorBefore * errorBefore / (before.samples - 1) +
+                                           errorNow * errorNow / (result.samples - 1));
+                significant = std::abs(result.mean - before.mean) / error > studentT975(degreesOfFreedom);
+            } else {
+                significant = result.mean != before.mean;
+            }
+            const char *verdict = !significant ? "same" : change > 0.0 ? "slower" : "faster";
+            if (significant && change > 0.0)
+                slower++;
+            std::cout << "BENCH:: " << std::left << std::setw(48) << result.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(8) << change << "% " << verdict << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            std::cout << std::setprecision(6);
+        }
+        return slower;
+    }
+
+private:
+    static void print(const BenchResult &result) {
+        double halfWidth = (result.ciHigh - result.ciLow) * 0.5;
+        std::cout << std::left << std::setw(48) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << result.mean << " ns +- " << std::setw(5)
+                  << (result.mean > 0.0 ? halfWidth / result.mean * 100.0 : 0.0) << "%" << std::setprecision(0)
+                  << std::setw(16) << result.ItemsPerSecond() << " items/s  (" << result.samples << " x "
+                  << result.iterations << ")" << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+    }
+};
+
+};
+#endif //PROJECT_BASE_MICROBENCH_H
@@ -0,0 +1,136 @@
+#ifndef PROJECT_BASE_PERFHUD_H
+#define PROJECT_BASE_PERFHUD_H
+
+#include <rg/GpuProfiler.h>
+#include <rg/RenderStats.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+struct FrameTimePercentiles {
+    float p50 = 0.0f;
+    float p95 = 0.0f;
+    float p99 = 0.0f;
+    float max = 0.0f;
+    float mean = 0.0f;
+};
+
+// nearest-rank percentiles
+inline FrameTimePercentiles framePercentiles(std::vector<float> values) {
+    FrameTimePercentiles result;
+    if (values.empty())
+        return result;
+    std::sort(values.begin(), values.end());
+    auto rank = [&values](float percentile) {
+        unsigned int index = (unsigned int) std::ceil(percentile * (float) values.size());
+        return values[std::max(index, 1u) - 1];
+    };
+    result.p50 = rank(0.50f);
+    result.p95 = rank(0.95f);
+    result.p99 = rank(0.99f);
+    result.max = values.back();
+    double sum = 0.0;
+    for (float value : values)
+        sum += value;
+    result.mean = (float) (sum / (double) values.size());
+    return result;
+}
+
+// The last CAPACITY frame times in a ring, laid out so ImGui::PlotLines can draw it directly
+// with Offset() as the values offset.
+class FrameTimeHistory {
+public:
+    static const unsigned int CAPACITY = 240;
+
+    void Push(float ms) {
+        if (values.size() < CAPACITY) {
+            values.push_back(ms);
+        } else {
+            values[next] = ms;
+            next = (next + 1) % CAPACITY;
+        }
+    }
+
+    const float *Data() const {
+        return values.data();
+    }
+
+    int Size() const {
+        return (int) values.size();
+    }
+
+    // index of the oldest value
+    int Offset() const {
+        return (int) next;
+    }
+
+    // percentiles over the whole history
+    FrameTimePercentiles Percentiles() const {
+        return framePercentiles(values);
+    }
+
+    // frame counts of `buckets` equal intervals from 0 to maxMs, slower frames land in the last one
+    std::vector<float> Histogram(unsigned int buckets, float maxMs) const {
+        std::vector<float> counts(buckets, 0.0f);
+        for (float ms : values) {
+            unsigned int bucket = (unsigned int) std::max(0.0f, ms / maxMs * (float) buckets);
+            counts[std::min(bucket, buckets - 1)] += 1.0f;
+        }
+        return counts;
+    }
+
+private:
+    std::vector<float> values;
+    unsigned int next = 0;
+};
+
+// Collects what the performance window shows: the CPU time spent building each frame (from
+// BeginFrame until right before the buffer swap, so waiting on vsync is not included), the GPU
+// frame time of rg::GpuProfiler and the FrameStats counters of the last finished frame.
+class PerfHud {
+public:
+    FrameTimeHistory cpu;
+    FrameTimeHistory gpu;
+    // counters of the previous frame, frameStats() only holds the frame in progress
+    FrameStats lastFrame;
+
+    PerfHud() = default;
+    PerfHud(const PerfHud &) = delete;
+    PerfHud &operator=(const PerfHud &) = delete;
+
+    // call before frameStats() is reset for the new frame
+    void BeginFrame() {
+        if (started)
+            lastFrame = frameStats();
+        frameStart = std::chrono::steady_clock::now();
+        started = true;
+    }
+
+    void EndFrame(const GpuProfiler &profiler) {
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+        cpu.Push(elapsed.count());
+        // the profiler resolves frames a few frames late and keeps returning the same one until the next is in
+        const GpuFrameTiming &frame = profiler.Latest();
+        if (!frame.passes.empty() && frame.frame != lastGpuFrame) {
+            gpu.Push((float) frame.gpuMs);
+            lastGpuFrame = frame.frame;
+        }
+    }
+
+private:
+    std::chrono::steady_clock::time_point frameStart;
+    bool started = false;
+    unsigned long long lastGpuFrame = ~0ull;
+};
+
+inline PerfHud &perfHud() {
+    static PerfHud hud;
+    return hud;
+}
+
+};
+#endif //PROJECT_BASE_PERFHUD_H
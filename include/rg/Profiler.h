@@ -0,0 +1,170 @@
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+#include <rg/Trace.h>
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The CPU profiler zones are compiled in unless NDEBUG is defined (release builds), defining
+// RG_ENABLE_PROFILER (cmake -DPROFILER=ON) keeps them in release builds as well.
+#if defined(RG_ENABLE_PROFILER) || !defined(NDEBUG)
+#define RG_PROFILER_ENABLED 1
+#else
+#define RG_PROFILER_ENABLED 0
+#endif
+
+namespace rg {
+
+// one finished zone, name has to be a string literal (or otherwise outlive the profiler)
+struct ProfileZone {
+    const char *name;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+// Zones of one thread. Only the owning thread writes, it stores the zone and then publishes it by
+// bumping head, the oldest zones are overwritten once CAPACITY is reached. A reader copies what
+// head covers and then checks head again: zones the writer may have overwritten during the copy
+// are dropped, so reading never blocks the writer.
+class ProfileRing {
+public:
+    static const uint64_t CAPACITY = 1u << 16;
+
+    const uint32_t threadId;
+
+    explicit ProfileRing(uint32_t threadId) : threadId(threadId), zones(new ProfileZone[CAPACITY]) {}
+
+    void Push(const char *name, uint64_t startNs, uint64_t endNs) {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        zones[index & (CAPACITY - 1)] = {name, startNs, endNs};
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    std::vector<ProfileZone> Snapshot() const {
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+        std::vector<ProfileZone> copy;
+        copy.reserve(end - begin);
+        for (uint64_t i = begin; i < end; i++)
+            copy.push_back(zones[i & (CAPACITY - 1)]);
+        // entries before after - CAPACITY were overwritten, and the writer may be filling slot
+        // after right now, which holds entry after - CAPACITY, so that one is dropped as well
+        uint64_t after = head.load(std::memory_order_acquire);
+        uint64_t overwritten = after >= CAPACITY ? after - CAPACITY + 1 : 0;
+        if (overwritten > begin)
+            copy.erase(copy.begin(), copy.begin() + (std::ptrdiff_t) std::min(overwritten - begin, (uint64_t) copy.size()));
+        return copy;
+    }
+
+private:
+    std::unique_ptr<ProfileZone[]> zones;
+    std::atomic<uint64_t> head{0};
+};
+
+struct ThreadZones {
+    uint32_t threadId = 0;
+    std::vector<ProfileZone> zones;
+};
+
+// Owns the rings of every thread that ever recorded a zone, rings outlive their thread so a dump
+// still contains the zones of finished workers. The mutex is only taken when a thread records its
+// first zone and when dumping.
+class Profiler {
+public:
+    Profiler() = default;
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    ProfileRing &ThreadRing() {
+        thread_local ProfileRing *ring = nullptr;
+        if (ring == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            rings.emplace_back(new ProfileRing(traceThreadId()));
+            ring = rings.back().get();
+        }
+        return *ring;
+    }
+
+    // the last ProfileRing::CAPACITY zones of every thread, oldest first
+    std::vector<ThreadZones> Snapshot() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<ThreadZones> threads;
+        for (const std::unique_ptr<ProfileRing> &ring : rings) {
+            threads.emplace_back();
+            threads.back().threadId = ring->threadId;
+            threads.back().zones = ring->Snapshot();
+        }
+        return threads;
+    }
+
+    // Snapshot() in the Chrome trace format
+    bool WriteChromeTrace(const std::string &path) {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::PROFILER:: could not write " << path << std::endl;
+            return false;
+        }
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        size_t written = 0;
+        for (const ThreadZones &thread : Snapshot()) {
+            for (const ProfileZone &zone : thread.zones) {
+                if (written++ > 0)
+                    out << ",\n";
+                writeChromeTraceEvent(out, zone.name, std::string(), zone.startNs, zone.endNs - zone.startNs,
+                                      thread.threadId);
+            }
+        }
+        out << "\n]}\n";
+        std::cout << "PROFILER:: wrote " << written << " zones to " << path << std::endl;
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileRing>> rings;
+};
+
+inline Profiler &profiler() {
+    static Profiler instance;
+    return instance;
+}
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name) : name(name), startNs(traceNowNs()) {}
+
+    ~ProfileScope() {
+        profiler().ThreadRing().Push(name, startNs, traceNowNs());
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const char *name;
+    uint64_t startNs;
+};
+
+};
+
+#define RG_PROFILE_CONCAT_INNER(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_INNER(a, b)
+
+#if RG_PROFILER_ENABLED
+// times the rest of the enclosing scope
+#define RG_PROFILE_ZONE(name) rg::ProfileScope RG_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define RG_PROFILE_FUNCTION() RG_PROFILE_ZONE(__func__)
+#else
+#define RG_PROFILE_ZONE(name) ((void) 0)
+#define RG_PROFILE_FUNCTION() ((void) 0)
+#endif
+
+#endif //PROJECT_BASE_PROFILER_H
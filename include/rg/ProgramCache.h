@@ -0,0 +1,199 @@
+#ifndef PROJECT_BASE_PROGRAMCACHE_H
+#define PROJECT_BASE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace rg {
+
+// On-disk cache of linked program binaries (ARB_get_program_binary / GL 4.1).
+//
+// A program is keyed by a hash of its final source, i.e. after the permutation defines are injected,
+// together with GL_RENDERER and GL_VERSION, so a driver update or a different GPU never sees a
+// stale binary. The driver may still reject a binary it wrote itself, Shader then falls back to
+// compiling from source and the entry is overwritten.
+class ProgramCache {
+public:
+    std::string directory = "shader_cache";
+    bool enabled = true;
+
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    double loadMs = 0.0;
+    double compileMs = 0.0;
+    // compile + link time recorded when the binaries that were hit got stored
+    double savedMs = 0.0;
+
+    bool available() {
+        probe();
+        return enabled && supported;
+    }
+
+    std::string key(const std::vector<std::string> &sources) {
+        // FNV-1a, the sources are separated so moving code between stages changes the key
+        probe();
+        std::uint64_t hash = 14695981039346656037ull;
+        auto feed = [&hash](const std::string &data) {
+            for (unsigned char c : data) {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+            hash ^= 0xff;
+            hash *= 1099511628211ull;
+        };
+        feed(driver);
+        for (const std::string &source : sources)
+            feed(source);
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
+        return name;
+    }
+
+    // returns a linked program or 0 when there is no usable binary for the key
+    unsigned int load(const std::string &key) {
+        if (!available())
+            return 0;
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream file(path(key), std::ios::binary);
+        Header header;
+        if (!file || !file.read((char *) &header, sizeof(header)) || header.magic != MAGIC)
+            return 0;
+        // a truncated or padded file is a miss, never an allocation of whatever the header claims
+        std::streampos body = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff remaining = file.tellg() - body;
+        if (remaining != (std::streamoff) header.length)
+            return 0;
+        file.seekg(body);
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), binary.size()))
+            return 0;
+
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        hits++;
+        loadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        savedMs += header.compileMs;
+        return program;
+    }
+
+    // call before glLinkProgram so the driver keeps the binary around
+    void prepare(unsigned int program) {
+        if (available())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // writes the binary of a freshly linked program, elapsedMs is what compiling it from source took
+    void store(unsigned int program, const std::string &key, double elapsedMs) {
+        misses++;
+        compileMs += elapsedMs;
+        if (!available())
+            return;
+        GLint success = 0, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        Header header;
+        header.magic = MAGIC;
+        header.compileMs = (float) elapsedMs;
+        header.length = (std::uint32_t) length;
+        glGetProgramBinary(program, length, NULL, &header.format, binary.data());
+
+        // written next to the entry and renamed over it, so a crash or a second instance never leaves
+        // a half written binary behind
+        createDirectory();
+        std::string temporary = path(key) + ".tmp";
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write((const char *) &header, sizeof(header));
+        file.write(binary.data(), binary.size());
+        file.close();
+        if (!file) {
+            std::cout << "ERROR::PROGRAM_CACHE:: could not write " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return;
+        }
+#ifdef _WIN32
+        // rename does not replace an existing file on Windows
+        std::remove(path(key).c_str());
+#endif
+        if (std::rename(temporary.c_str(), path(key).c_str()) != 0) {
+            std::cout << "ERROR::PROGRAM_CACHE:: could not replace " << path(key) << std::endl;
+            std::remove(temporary.c_str());
+        }
+    }
+
+    void report() const {
+        std::cout << "PROGRAM_CACHE:: " << hits << "/" << hits + misses << " programs loaded from binaries in "
+                  << loadMs << " ms (saved ~" << savedMs - loadMs << " ms), "
+                  << misses << " compiled from source in " << compileMs << " ms" << std::endl;
+    }
+
+private:
+    static const std::uint32_t MAGIC = 0x42504752; // "RGPB"
+
+    struct Header {
+        std::uint32_t magic = 0;
+        GLenum format = 0;
+        float compileMs = 0.0f;
+        std::uint32_t length = 0;
+    };
+
+    bool probed = false;
+    bool supported = false;
+    std::string driver;
+
+    void probe() {
+        if (probed)
+            return;
+        probed = true;
+        GLint formats = 0;
+        if (GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0;
+        const char *renderer = (const char *) glGetString(GL_RENDERER);
+        const char *version = (const char *) glGetString(GL_VERSION);
+        driver = std::string(renderer ? renderer : "") + "\n" + (version ? version : "");
+    }
+
+    std::string path(const std::string &key) const {
+        return directory + "/" + key + ".bin";
+    }
+
+    void createDirectory() const {
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+};
+
+inline ProgramCache &programCache() {
+    static ProgramCache cache;
+    return cache;
+}
+
+};
+#endif //PROJECT_BASE_PROGRAMCACHE_H
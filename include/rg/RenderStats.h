@@ -0,0 +1,43 @@
+#ifndef PROJECT_BASE_RENDERSTATS_H
+#define PROJECT_BASE_RENDERSTATS_H
+
+namespace rg {
+
+// counters filled in by the draw functions, reset at the start of every frame
+struct FrameStats {
+    unsigned int drawCalls = 0;
+    unsigned long long triangles = 0;
+    // glUseProgram, glBindVertexArray and glBindTexture calls the draw functions make, whether or not
+    // the object was already bound; GlCommandStats measures every bind that reaches the driver
+    unsigned int bindCalls = 0;
+    // glUniform* calls made through Shader::set*
+    unsigned int uniformUploads = 0;
+    // objects skipped by the frustum test
+    unsigned int culledObjects = 0;
+
+    void reset() {
+        *this = FrameStats();
+    }
+};
+
+inline FrameStats &frameStats() {
+    static FrameStats stats;
+    return stats;
+}
+
+inline void countDraw(unsigned long long triangles, unsigned int instances = 1) {
+    FrameStats &stats = frameStats();
+    stats.drawCalls++;
+    stats.triangles += triangles * instances;
+}
+
+inline void countBindCalls(unsigned int calls = 1) {
+    frameStats().bindCalls += calls;
+}
+
+inline void countUniformUpload() {
+    frameStats().uniformUploads++;
+}
+
+};
+#endif //PROJECT_BASE_RENDERSTATS_H
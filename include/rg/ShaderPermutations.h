@@ -0,0 +1,107 @@
+#ifndef PROJECT_BASE_SHADERPERMUTATIONS_H
+#define PROJECT_BASE_SHADERPERMUTATIONS_H
+
+#include <learnopengl/shader.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+// the light the scene is lit by, selected in the ImGui window
+enum class LightMode {
+    Directional = 1,
+    Point = 2,
+    Spot = 3,
+    // the directional light plus every point and spot light through rg::ClusteredLights
+    Clustered = 4,
+};
+
+// optional features a shader source can be compiled with, combined as a bit mask
+enum ShaderFeature : unsigned int {
+    SHADER_FEATURE_NONE = 0,
+    SHADER_FEATURE_INSTANCED = 1u << 0,
+    // writes the G-buffer of rg::DeferredRenderer instead of lighting, the light mode is ignored
+    SHADER_FEATURE_GBUFFER = 1u << 1,
+    // writes the draw and triangle id of rg::VisibilityBuffer instead of lighting, the light mode is ignored
+    SHADER_FEATURE_VISIBILITY = 1u << 2,
+    // lights as usual and then replaces the colour with the debugColor uniform of rg::DebugViews,
+    // only for the lit variants
+    SHADER_FEATURE_DEBUG_VIEW = 1u << 3,
+};
+
+// features that replace the lighting, their variants are the same for every light mode
+const unsigned int UNLIT_SHADER_FEATURES = SHADER_FEATURE_GBUFFER | SHADER_FEATURE_VISIBILITY;
+
+const LightMode ALL_LIGHT_MODES[] = {LightMode::Directional, LightMode::Point, LightMode::Spot, LightMode::Clustered};
+
+inline std::vector<std::string> permutationDefines(LightMode light, unsigned int features) {
+    std::vector<std::string> defines;
+    if (features & SHADER_FEATURE_GBUFFER)
+        defines.push_back("GBUFFER");
+    else if (features & SHADER_FEATURE_VISIBILITY)
+        defines.push_back("VISIBILITY");
+    else switch (light) {
+        case LightMode::Directional: defines.push_back("LIGHT_DIRECTIONAL"); break;
+        case LightMode::Point: defines.push_back("LIGHT_POINT"); break;
+        case LightMode::Spot: defines.push_back("LIGHT_SPOT"); break;
+        case LightMode::Clustered: defines.push_back("LIGHT_CLUSTERED"); break;
+    }
+    if (features & SHADER_FEATURE_INSTANCED)
+        defines.push_back("INSTANCED");
+    if (features & SHADER_FEATURE_DEBUG_VIEW)
+        defines.push_back("DEBUG_VIEW");
+    return defines;
+}
+
+// Compiles one vertex/fragment source pair once per (light, features) combination so the shaders
+// branch on the preprocessor instead of a uniform. Variants are compiled the first time they are
+// asked for, prepare() compiles them up front (into a ShaderBatch so they build concurrently)
+// to keep the hitch out of the render loop.
+class ShaderPermutations {
+public:
+    ShaderPermutations(std::string vertexPath, std::string fragmentPath)
+            : vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)) {}
+
+    // with a batch a new variant is only submitted, it can be used once the batch is finished
+    Shader &get(LightMode light, unsigned int features = SHADER_FEATURE_NONE, ShaderBatch *batch = nullptr) {
+        unsigned int key = permutationKey(light, features);
+        auto it = variants.find(key);
+        if (it == variants.end()) {
+            it = variants.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                                  std::forward_as_tuple(vertexPath.c_str(), fragmentPath.c_str(),
+                                                        permutationDefines(light, features), nullptr, batch)).first;
+        }
+        return it->second;
+    }
+
+    // compiles every light variant with the given features
+    void prepare(unsigned int features = SHADER_FEATURE_NONE, ShaderBatch *batch = nullptr) {
+        for (LightMode light : ALL_LIGHT_MODES)
+            get(light, features, batch);
+    }
+
+    // calls f on every variant compiled so far, for uniforms that never change (sampler units etc.)
+    template<typename F>
+    void forEachVariant(F f) {
+        for (auto &variant : variants)
+            f(variant.second);
+    }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::map<unsigned int, Shader> variants;
+
+    static unsigned int permutationKey(LightMode light, unsigned int features) {
+        if (features & UNLIT_SHADER_FEATURES)
+            return features << 3;
+        return features << 3 | (unsigned int) light;
+    }
+};
+
+};
+#endif //PROJECT_BASE_SHADERPERMUTATIONS_H
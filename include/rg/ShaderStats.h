@@ -0,0 +1,526 @@
+#ifndef PROJECT_BASE_SHADERSTATS_H
+#define PROJECT_BASE_SHADERSTATS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// What one compiled shader stage costs, -1 where the backend cannot tell
+struct ShaderCost {
+    // the source files and the defines of the variant, "trash LIGHT_POINT INSTANCED"
+    std::string name;
+    // "vertex" or "fragment"
+    std::string stage;
+    // arithmetic, logic, conversion and derivative instructions, built-in function calls count as one
+    int alu = -1;
+    // sample, fetch and gather instructions
+    int texture = -1;
+    // estimated peak of live scalar values (SPIR-V) or the vector registers the driver allocated
+    int registers = -1;
+    // scalar components of the user inputs and outputs, the varyings are the vertex outputs and
+    // the fragment inputs; built-ins are not counted
+    int inputs = -1;
+    int outputs = -1;
+    bool compiled = false;
+};
+
+const char *const SHADER_COST_METRICS[] = {"alu", "texture", "registers", "inputs", "outputs"};
+
+inline int &shaderCostMetric(ShaderCost &cost, size_t metric) {
+    int *metrics[] = {&cost.alu, &cost.texture, &cost.registers, &cost.inputs, &cost.outputs};
+    return *metrics[metric];
+}
+
+// Counts the cost of a SPIR-V module as glslang emits it, without optimizations. The register
+// estimate walks each function in instruction order and keeps a value alive from its definition to
+// its last use (a function local variable from its first to its last access), loops are not
+// followed back, the result is the largest number of scalar components alive at once.
+inline bool analyzeSpirv(const std::vector<uint32_t> &words, ShaderCost &cost) {
+    enum : uint32_t {
+        OP_EXT_INST = 12, OP_TYPE_BOOL = 20, OP_TYPE_INT = 21, OP_TYPE_FLOAT = 22, OP_TYPE_VECTOR = 23,
+        OP_TYPE_MATRIX = 24, OP_TYPE_ARRAY = 28, OP_TYPE_STRUCT = 30, OP_TYPE_POINTER = 32, OP_CONSTANT = 43,
+        OP_FUNCTION = 54, OP_FUNCTION_END = 56, OP_VARIABLE = 59, OP_LOAD = 61, OP_STORE = 62,
+        OP_COPY_MEMORY = 63, OP_DECORATE = 71, OP_MEMBER_DECORATE = 72, OP_VECTOR_SHUFFLE = 79,
+        OP_COMPOSITE_EXTRACT = 81, OP_COMPOSITE_INSERT = 82, OP_IMAGE_SAMPLE_IMPLICIT_LOD = 87, OP_IMAGE_READ = 98,
+        OP_IMAGE_WRITE = 99, OP_LABEL = 248, OP_BRANCH_CONDITIONAL = 250, OP_SWITCH = 251, OP_RETURN_VALUE = 254,
+        DECORATION_BUILT_IN = 11, STORAGE_INPUT = 1, STORAGE_OUTPUT = 3,
+    };
+    // instructions inside a function that define no value
+    static const std::set<uint32_t> noResult = {0, 8, 56, 62, 63, 64, 99, 218, 219, 224, 225, 246, 247, 248,
+                                                249, 250, 251, 252, 253, 254, 255, 256, 257, 317, 4416, 5380};
+    if (words.size() < 5 || words[0] != 0x07230203)
+        return false;
+
+    std::map<uint32_t, int> components;
+    std::set<uint32_t> pointerTypes;
+    std::map<uint32_t, uint32_t> pointees;
+    std::map<uint32_t, uint32_t> constants;
+    std::set<uint32_t> builtIns;
+    cost.alu = cost.texture = cost.registers = cost.inputs = cost.outputs = 0;
+
+    // the liveness of the current function, indexed by id
+    struct Value {
+        size_t definition;
+        size_t lastUse;
+        int size;
+        // a local variable is defined by its first access
+        bool variable;
+        bool accessed;
+    };
+    std::map<uint32_t, Value> values;
+    size_t position = 0;
+    bool inFunction = false;
+    auto componentsOf = [&](uint32_t type) {
+        auto found = components.find(type);
+        return found == components.end() ? 0 : found->second;
+    };
+    auto use = [&](uint32_t id) {
+        auto found = values.find(id);
+        if (found == values.end())
+            return;
+        Value &value = found->second;
+        if (value.variable && !value.accessed) {
+            value.definition = position;
+            value.accessed = true;
+        }
+        // a phi can name a value of a later block, that back edge is not followed
+        if (position >= value.definition)
+            value.lastUse = std::max(value.lastUse, position);
+    };
+    auto peakLiveness = [&]() {
+        std::map<size_t, int> changes;
+        for (const auto &value : values) {
+            if (value.second.variable && !value.second.accessed)
+                continue;
+            changes[value.second.definition] += value.second.size;
+            changes[value.second.lastUse + 1] -= value.second.size;
+        }
+        int live = 0, peak = 0;
+        for (const auto &change : changes) {
+            live += change.second;
+            peak = std::max(peak, live);
+        }
+        return peak;
+    };
+
+    for (size_t i = 5; i < words.size();) {
+        uint32_t count = words[i] >> 16, op = words[i] & 0xffff;
+        if (count == 0 || i + count > words.size())
+            return false;
+        const uint32_t *w = &words[i];
+        i += count;
+
+        if (!inFunction) {
+            switch (op) {
+                case OP_TYPE_BOOL:
+                case OP_TYPE_INT:
+                case OP_TYPE_FLOAT:
+                    components[w[1]] = 1;
+                    break;
+                case OP_TYPE_VECTOR:
+                case OP_TYPE_MATRIX:
+                    components[w[1]] = componentsOf(w[2]) * (int) w[3];
+                    break;
+                case OP_TYPE_ARRAY:
+                    components[w[1]] = componentsOf(w[2]) * (int) constants[w[3]];
+                    break;
+                case OP_TYPE_STRUCT: {
+                    int size = 0;
+                    for (uint32_t member = 2; member < count; member++)
+                        size += componentsOf(w[member]);
+                    components[w[1]] = size;
+                    break;
+                }
+                case OP_TYPE_POINTER:
+                    components[w[1]] = componentsOf(w[3]);
+                    pointerTypes.insert(w[1]);
+                    pointees[w[1]] = w[3];
+                    break;
+                case OP_CONSTANT:
+                    constants[w[2]] = w[3];
+                    break;
+                case OP_DECORATE:
+                    if (w[2] == DECORATION_BUILT_IN)
+                        builtIns.insert(w[1]);
+                    break;
+                case OP_MEMBER_DECORATE:
+                    // gl_PerVertex, a block of built-ins
+                    if (w[3] == DECORATION_BUILT_IN)
+                        builtIns.insert(w[1]);
+                    break;
+                case OP_VARIABLE:
+                    if ((w[3] == STORAGE_INPUT || w[3] == STORAGE_OUTPUT) && !builtIns.count(w[2]) &&
+                        !builtIns.count(pointees[w[1]]))
+                        (w[3] == STORAGE_INPUT ? cost.inputs : cost.outputs) += componentsOf(w[1]);
+                    break;
+                case OP_FUNCTION:
+                    inFunction = true;
+                    values.clear();
+                    position = 0;
+                    break;
+                default:
+                    break;
+            }
+            continue;
+        }
+        if (op == OP_FUNCTION_END) {
+            cost.registers = std::max(cost.registers, peakLiveness());
+            inFunction = false;
+            continue;
+        }
+
+        position++;
+        if (op == OP_EXT_INST || (op >= 109 && op <= 124 && (op < 121 || op > 123)) || (op >= 126 && op <= 152) ||
+            (op >= 154 && op <= 205) || (op >= 207 && op <= 215))
+            cost.alu++;
+        if (op >= OP_IMAGE_SAMPLE_IMPLICIT_LOD && op <= OP_IMAGE_READ)
+            cost.texture++;
+
+        if (noResult.count(op)) {
+            switch (op) {
+                case OP_STORE:
+                case OP_COPY_MEMORY:
+                    use(w[1]);
+                    use(w[2]);
+                    break;
+                case OP_IMAGE_WRITE:
+                    for (uint32_t operand = 1; operand < std::min(count, 4u); operand++)
+                        use(w[operand]);
+                    break;
+                case OP_BRANCH_CONDITIONAL:
+                case OP_SWITCH:
+                case OP_RETURN_VALUE:
+                    use(w[1]);
+                    break;
+                default:
+                    break;
+            }
+            continue;
+        }
+        if (count < 3)
+            continue;
+
+        // the operands that are ids, the others are literals
+        uint32_t first = 3, last = count, literal = count;
+        switch (op) {
+            case OP_LOAD:
+            case OP_COMPOSITE_EXTRACT:
+                last = std::min(count, 4u);
+                break;
+            case OP_VECTOR_SHUFFLE:
+            case OP_COMPOSITE_INSERT:
+                last = std::min(count, 5u);
+                break;
+            case OP_EXT_INST:
+                first = 5;
+                break;
+            default:
+                if (op >= OP_IMAGE_SAMPLE_IMPLICIT_LOD && op <= OP_IMAGE_READ) {
+                    // the image operand mask follows the coordinate, the depth reference or the component
+                    static const std::set<uint32_t> extraOperand = {89, 90, 93, 94, 96, 97};
+                    literal = extraOperand.count(op) ? 6 : 5;
+                }
+                break;
+        }
+        for (uint32_t operand = first; operand < last; operand++) {
+            if (operand != literal)
+                use(w[operand]);
+        }
+
+        if (op == OP_VARIABLE)
+            values[w[2]] = {position, position, componentsOf(w[1]), true, false};
+        else if (!pointerTypes.count(w[1]))
+            values[w[2]] = {position, position, componentsOf(w[1]), false, false};
+    }
+    cost.compiled = true;
+    return true;
+}
+
+// Compiles a stage to SPIR-V for OpenGL with glslangValidator and analyzes the result. Locations and
+// bindings the sources leave to the linker are assigned automatically. The compiler output is
+// printed when the compile fails.
+inline bool spirvShaderCost(const std::string &glslang, const std::string &extraArguments,
+                            const std::string &source, const std::string &stage, ShaderCost &cost) {
+    // glslang takes the stage from the extension
+    std::string sourcePath = stage == "vertex" ? "shader_stats_tmp.vert" : "shader_stats_tmp.frag";
+    std::string binaryPath = "shader_stats_tmp.spv";
+    std::ofstream(sourcePath) << source;
+    std::remove(binaryPath.c_str());
+
+    std::string command = "\"" + glslang + "\" -G --aml --amb " + extraArguments + " -o " + binaryPath + " " +
+                          sourcePath + " 2>&1";
+    std::string log;
+    FILE *pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        std::cout << "ERROR::SHADER_STATS:: could not run " << glslang << std::endl;
+        return false;
+    }
+    char buffer[512];
+    while (fgets(buffer, sizeof(buffer), pipe))
+        log += buffer;
+    int status = pclose(pipe);
+
+    std::ifstream in(binaryPath, std::ios::binary);
+    std::vector<uint32_t> words;
+    uint32_t word;
+    while (in.read((char *) &word, sizeof(word)))
+        words.push_back(word);
+    in.close();
+    std::remove(sourcePath.c_str());
+    std::remove(binaryPath.c_str());
+    if (status != 0 || !analyzeSpirv(words, cost)) {
+        std::cout << "ERROR::SHADER_STATS:: " << cost.name << " " << stage << " did not compile:\n" << log << std::endl;
+        cost.compiled = false;
+        return false;
+    }
+    return true;
+}
+
+// Asks the OpenGL driver for its statistics the way Mesa's shader-db does: drivers that support it
+// (radeonsi, iris, ...) send the statistics of every shader they compile as debug messages of a
+// debug context. Those messages are parsed for what the driver knows, other drivers report nothing.
+// Needs a current context with the GL functions loaded, and MESA_SHADER_CACHE_DISABLE set before it
+// was created so cached shaders are compiled again.
+class DriverShaderStats {
+public:
+    // every debug message is printed
+    bool verbose = false;
+
+    DriverShaderStats() = default;
+    DriverShaderStats(const DriverShaderStats &) = delete;
+    DriverShaderStats &operator=(const DriverShaderStats &) = delete;
+
+    bool Begin() {
+        if (!GLAD_GL_KHR_debug) {
+            std::cout << "ERROR::SHADER_STATS:: KHR_debug is not supported, the driver cannot report statistics"
+                      << std::endl;
+            return false;
+        }
+        glEnable(GL_DEBUG_OUTPUT);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        glDebugMessageCallback(callback, this);
+        // the statistics are notifications
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+        return true;
+    }
+
+    // compiles and links the program, fills the vertex and fragment cost
+    bool Compile(const std::string &vertexSource, const std::string &fragmentSource, ShaderCost &vertex,
+                 ShaderCost &fragment) {
+        messages.clear();
+        unsigned int stages[2] = {compileStage(GL_VERTEX_SHADER, vertexSource, vertex),
+                                  compileStage(GL_FRAGMENT_SHADER, fragmentSource, fragment)};
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, stages[0]);
+        glAttachShader(program, stages[1]);
+        glLinkProgram(program);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            GLchar log[1024];
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            std::cout << "ERROR::SHADER_STATS:: " << vertex.name << " did not link:\n" << log << std::endl;
+            vertex.compiled = fragment.compiled = false;
+        } else {
+            vertex.inputs = activeAttributeComponents(program);
+        }
+        glDeleteProgram(program);
+        glDeleteShader(stages[0]);
+        glDeleteShader(stages[1]);
+
+        // messages that name no stage are taken in compile order
+        unsigned int unnamed = 0;
+        for (const std::string &message : messages) {
+            if (verbose)
+                std::cout << "SHADER_STATS:: " << vertex.name << ": " << message << std::endl;
+            int stage = stageOf(message);
+            if (stage < 0)
+                stage = (int) std::min(unnamed++, 1u);
+            parseMessage(message, stage == 0 ? vertex : fragment);
+        }
+        return vertex.compiled && fragment.compiled;
+    }
+
+private:
+    std::vector<std::string> messages;
+
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                  const GLchar *message, const void *user) {
+        auto stats = (DriverShaderStats *) user;
+        stats->messages.emplace_back(message, length >= 0 ? (size_t) length : std::string(message).size());
+    }
+
+    static unsigned int compileStage(GLenum type, const std::string &source, ShaderCost &cost) {
+        const char *code = source.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &code, nullptr);
+        glCompileShader(shader);
+        GLint compiled = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        cost.compiled = compiled == GL_TRUE;
+        if (!cost.compiled) {
+            GLchar log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            std::cout << "ERROR::SHADER_STATS:: " << cost.name << " " << cost.stage << " did not compile:\n" << log
+                      << std::endl;
+        }
+        return shader;
+    }
+
+    static int activeAttributeComponents(unsigned int program) {
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+        int total = 0;
+        for (GLint i = 0; i < count; i++) {
+            GLchar name[256];
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(program, (GLuint) i, sizeof(name), nullptr, &size, &type, name);
+            if (std::string(name).compare(0, 3, "gl_") == 0)
+                continue;
+            int components = 1;
+            switch (type) {
+                case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: components = 2; break;
+                case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: components = 3; break;
+                case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_FLOAT_MAT2: components = 4; break;
+                case GL_FLOAT_MAT3: components = 9; break;
+                case GL_FLOAT_MAT4: components = 16; break;
+                default: break;
+            }
+            total += components * size;
+        }
+        return total;
+    }
+
+    // 0 vertex, 1 fragment, -1 when the message does not say
+    static int stageOf(const std::string &message) {
+        static const std::regex vertex("\\b(VS|vertex)\\b"), fragment("\\b(FS|PS|fragment)\\b");
+        if (std::regex_search(message, vertex))
+            return 0;
+        if (std::regex_search(message, fragment))
+            return 1;
+        return -1;
+    }
+
+    // "SIMD8 shader: 120 inst, ... 3 sends" (Intel), "Shader Stats: SGPRS: 16 VGPRS: 24 ..." (AMD)
+    static void parseMessage(const std::string &message, ShaderCost &cost) {
+        static const std::regex instructions("(\\d+) inst"), sends("(\\d+) sends"), vgprs("VGPRS: (\\d+)");
+        std::smatch match;
+        if (std::regex_search(message, match, instructions))
+            cost.alu = std::max(cost.alu, std::stoi(match[1]));
+        if (std::regex_search(message, match, sends))
+            cost.texture = std::max(cost.texture, std::stoi(match[1]));
+        if (std::regex_search(message, match, vgprs))
+            cost.registers = std::max(cost.registers, std::stoi(match[1]));
+    }
+};
+
+inline void printShaderCosts(const std::vector<ShaderCost> &costs) {
+    std::cout << std::left << std::setw(48) << "shader" << std::setw(10) << "stage" << std::right;
+    for (const char *metric : SHADER_COST_METRICS)
+        std::cout << std::setw(10) << metric;
+    std::cout << "\n";
+    for (ShaderCost cost : costs) {
+        std::cout << std::left << std::setw(48) << cost.name << std::setw(10) << cost.stage << std::right;
+        for (size_t metric = 0; metric < 5; metric++) {
+            int value = shaderCostMetric(cost, metric);
+            std::cout << std::setw(10) << (!cost.compiled ? "failed" : value < 0 ? "-" : std::to_string(value));
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::flush;
+}
+
+// one shader per line, which is what readShaderCosts expects
+inline bool writeShaderCosts(const std::string &path, const std::string &backend, const std::vector<ShaderCost> &costs) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cout << "ERROR::SHADER_STATS:: could not write " << path << std::endl;
+        return false;
+    }
+    out << "{\n  \"backend\": \"" << backend << "\",\n  \"shaders\": [";
+    for (size_t i = 0; i < costs.size(); i++) {
+        ShaderCost cost = costs[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << cost.name << "\", \"stage\": \"" << cost.stage
+            << "\", \"compiled\": " << (cost.compiled ? "true" : "false");
+        for (size_t metric = 0; metric < 5; metric++)
+            out << ", \"" << SHADER_COST_METRICS[metric] << "\": " << shaderCostMetric(cost, metric);
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    std::cout << "SHADER_STATS:: wrote " << costs.size() << " shaders to " << path << std::endl;
+    return true;
+}
+
+inline bool readShaderCosts(const std::string &path, std::vector<ShaderCost> &costs) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cout << "ERROR::SHADER_STATS:: could not read " << path << std::endl;
+        return false;
+    }
+    static const std::regex text("\"(name|stage)\": \"([^\"]*)\""), number("\"(\\w+)\": (-?\\d+)");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find("\"name\"") == std::string::npos)
+            continue;
+        ShaderCost cost;
+        cost.compiled = line.find("\"compiled\": true") != std::string::npos;
+        for (std::sregex_iterator field(line.begin(), line.end(), text), end; field != end; ++field)
+            ((*field)[1] == "name" ? cost.name : cost.stage) = (*field)[2];
+        for (std::sregex_iterator field(line.begin(), line.end(), number), end; field != end; ++field) {
+            for (size_t metric = 0; metric < 5; metric++) {
+                if ((*field)[1] == SHADER_COST_METRICS[metric])
+                    shaderCostMetric(cost, metric) = std::stoi((*field)[2]);
+            }
+        }
+        costs.push_back(cost);
+    }
+    return true;
+}
+
+// prints every metric that grew by more than tolerance percent over the baseline, returns their number
+inline unsigned int compareShaderCosts(const std::vector<ShaderCost> &baseline, const std::vector<ShaderCost> &costs,
+                                       double tolerance) {
+    std::map<std::string, ShaderCost> previous;
+    for (const ShaderCost &cost : baseline)
+        previous[cost.name + "/" + cost.stage] = cost;
+    unsigned int regressions = 0;
+    for (ShaderCost cost : costs) {
+        auto found = previous.find(cost.name + "/" + cost.stage);
+        if (found == previous.end()) {
+            std::cout << "SHADER_STATS:: new " << cost.name << " " << cost.stage << std::endl;
+            continue;
+        }
+        ShaderCost &before = found->second;
+        if (before.compiled && !cost.compiled) {
+            std::cout << "SHADER_STATS:: regression " << cost.name << " " << cost.stage << " no longer compiles"
+                      << std::endl;
+            regressions++;
+        }
+        for (size_t metric = 0; metric < 5; metric++) {
+            int was = shaderCostMetric(before, metric), now = shaderCostMetric(cost, metric);
+            if (was < 0 || now < 0 || now <= was * (1.0 + tolerance / 100.0))
+                continue;
+            std::cout << "SHADER_STATS:: regression " << cost.name << " " << cost.stage << " "
+                      << SHADER_COST_METRICS[metric] << " " << was << " -> " << now << std::endl;
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+};
+#endif //PROJECT_BASE_SHADERSTATS_H
@@ -0,0 +1,338 @@
+#ifndef PROJECT_BASE_SYNTHETICSCENE_H
+#define PROJECT_BASE_SYNTHETICSCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <rg/Lod.h>
+#include <rg/PerfHud.h>
+#include <rg/RenderStats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// the models the generator places, indexes SyntheticSceneSettings::counts and SyntheticScene::objects
+enum SceneAsset : unsigned int {
+    SCENE_ASSET_CAN,
+    SCENE_ASSET_BOTTLE,
+    SCENE_ASSET_BARREL,
+    SCENE_ASSET_BAG,
+    SCENE_ASSET_TREE,
+    SCENE_ASSET_STREET_LIGHT,
+    SCENE_ASSET_COUNT
+};
+
+// the keys of parseSyntheticScene
+const char *const SCENE_ASSET_NAMES[SCENE_ASSET_COUNT] = {"cans", "bottles", "barrels", "bags", "trees", "lights"};
+
+struct SyntheticSceneSettings {
+    bool enabled = false;
+    unsigned int seed = 1;
+    unsigned int counts[SCENE_ASSET_COUNT] = {2000, 500, 200, 300, 40, 16};
+    // road tiles added alternately in front of and behind the original one
+    unsigned int roadTiles = 4;
+    // copies of every placed model, each loading its own textures, the objects alternate between them
+    unsigned int textureSets = 1;
+};
+
+// "cans=2000,trees=40,lights=16,tiles=4,textures=2,seed=7", left out keys keep their value
+inline bool parseSyntheticScene(const std::string &spec, SyntheticSceneSettings &settings) {
+    std::istringstream fields(spec);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+        std::string::size_type equals = field.find('=');
+        std::string key = field.substr(0, equals);
+        char *end = nullptr;
+        long value = equals == std::string::npos ? -1 : std::strtol(field.c_str() + equals + 1, &end, 10);
+        bool known = false;
+        if (value >= 0 && end != nullptr && *end == '\0') {
+            for (unsigned int asset = 0; asset < SCENE_ASSET_COUNT; asset++) {
+                if (key == SCENE_ASSET_NAMES[asset]) {
+                    settings.counts[asset] = (unsigned int) value;
+                    known = true;
+                }
+            }
+            if (key == "tiles" || key == "textures" || key == "seed") {
+                (key == "tiles" ? settings.roadTiles : key == "textures" ? settings.textureSets : settings.seed) =
+                        (unsigned int) value;
+                known = true;
+            }
+        }
+        if (!known) {
+            std::cout << "ERROR::SYNTHETIC_SCENE:: bad field \"" << field << "\", expected KEY=N with KEY one of"
+                      << " cans, bottles, barrels, bags, trees, lights, tiles, textures, seed" << std::endl;
+            return false;
+        }
+    }
+    settings.textureSets = std::max(settings.textureSets, 1u);
+    return true;
+}
+
+struct SceneObject {
+    glm::mat4 transform;
+    // which copy of the model draws it, below SyntheticSceneSettings::textureSets
+    unsigned int textureSet;
+    // its own levels of detail, the copies of a model are shared by many objects
+    LodLevels lods;
+};
+
+// Scatters thousands of the existing models over a tiled dusty road around the shipped scene: cans,
+// bottles, barrels and bags lie on the road, trees stand beside it and the street lights line both
+// edges, each with a point light in its lamp. Every asset draws from its own random sequence of the
+// seed, so the same settings always give the same scene and raising the count of a scattered asset
+// only adds objects to the ones already there. The street lights are the exception: they are spaced
+// evenly along the road, so changing their count moves every lamp. The numbers come straight from
+// std::mt19937 rather than a standard distribution, whose output differs between standard libraries.
+class SyntheticScene {
+public:
+    std::vector<glm::mat4> roadTiles;
+    std::vector<SceneObject> objects[SCENE_ASSET_COUNT];
+    // one point light per street light
+    std::vector<glm::vec3> lamps;
+
+    SyntheticScene() = default;
+    SyntheticScene(const SyntheticScene &) = delete;
+    SyntheticScene &operator=(const SyntheticScene &) = delete;
+
+    // roadTransform places the original road tile, its model-space bounds give the tile size
+    void Generate(const SyntheticSceneSettings &settings, const glm::mat4 &roadTransform,
+                  const glm::vec3 &roadMinimum, const glm::vec3 &roadMaximum) {
+        glm::vec3 minimum(1e30f), maximum(-1e30f);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point(corner & 1 ? roadMaximum.x : roadMinimum.x, corner & 2 ? roadMaximum.y : roadMinimum.y,
+                            corner & 4 ? roadMaximum.z : roadMinimum.z);
+            point = glm::vec3(roadTransform * glm::vec4(point, 1.0f));
+            minimum = glm::min(minimum, point);
+            maximum = glm::max(maximum, point);
+        }
+        float tileLength = maximum.z - minimum.z;
+        float halfWidth = 0.5f * (maximum.x - minimum.x);
+        float centerX = 0.5f * (maximum.x + minimum.x);
+
+        roadTiles.clear();
+        float front = maximum.z, back = minimum.z;
+        for (unsigned int i = 1; i <= settings.roadTiles; i++) {
+            float side = i % 2 == 0 ? 1.0f : -1.0f;
+            float offset = side * tileLength * (float) ((i + 1) / 2);
+            roadTiles.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, offset)) * roadTransform);
+            front = std::max(front, maximum.z + offset);
+            back = std::min(back, minimum.z + offset);
+        }
+
+        lamps.clear();
+        for (unsigned int asset = 0; asset < SCENE_ASSET_COUNT; asset++) {
+            objects[asset].clear();
+            std::mt19937 random(settings.seed * 131u + asset);
+            auto unit = [&random]() {
+                return (float) (random() >> 8) * (1.0f / 16777216.0f);
+            };
+            for (unsigned int i = 0; i < settings.counts[asset]; i++) {
+                float yaw = glm::radians(360.0f * unit());
+                float x = centerX + halfWidth * (2.0f * unit() - 1.0f);
+                float z = back + (front - back) * unit();
+                glm::mat4 transform(1.0f);
+                switch (asset) {
+                    case SCENE_ASSET_CAN:
+                        transform = glm::translate(transform, glm::vec3(x, 0.08f, z));
+                        transform = glm::rotate(transform, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+                        transform = glm::rotate(transform, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+                        transform = glm::scale(transform, glm::vec3(0.1f));
+                        break;
+                    case SCENE_ASSET_BOTTLE:
+                        transform = glm::translate(transform, glm::vec3(x, 0.01f, z));
+                        transform = glm::rotate(transform, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+                        transform = glm::scale(transform, glm::vec3(0.01f));
+                        break;
+                    case SCENE_ASSET_BARREL:
+                        transform = glm::translate(transform, glm::vec3(x, 0.01f, z));
+                        transform = glm::rotate(transform, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+                        break;
+                    case SCENE_ASSET_BAG:
+                        transform = glm::translate(transform, glm::vec3(x, 0.21f, z));
+                        transform = glm::rotate(transform, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+                        transform = glm::scale(transform, glm::vec3(0.3f));
+                        break;
+                    case SCENE_ASSET_TREE: {
+                        // one to four metres off either edge
+                        float side = unit() < 0.5f ? -1.0f : 1.0f;
+                        x = centerX + side * (halfWidth + 1.0f + 3.0f * unit());
+                        transform = glm::translate(transform, glm::vec3(x, 0.0f, z));
+                        transform = glm::rotate(transform, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+                        transform = glm::scale(transform, glm::vec3(0.15f));
+                        break;
+                    }
+                    default: {
+                        // evenly spaced, alternating edges, the arm pointing over the road like the original
+                        float side = i % 2 == 0 ? -1.0f : 1.0f;
+                        x = centerX + side * 0.8f * halfWidth;
+                        z = back + (front - back) * ((float) i + 0.5f) / (float) settings.counts[asset];
+                        transform = glm::translate(transform, glm::vec3(x, 1.2f, z));
+                        transform = glm::rotate(transform, glm::radians(side * 90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                        transform = glm::scale(transform, glm::vec3(0.1f));
+                        lamps.push_back(glm::vec3(x - side * 0.61f, 2.0f, z));
+                        break;
+                    }
+                }
+                objects[asset].push_back({transform, i % settings.textureSets, LodLevels()});
+            }
+        }
+    }
+
+    size_t ObjectCount() const {
+        size_t count = roadTiles.size();
+        for (const std::vector<SceneObject> &assetObjects : objects)
+            count += assetObjects.size();
+        return count;
+    }
+};
+
+// one headless run of a SceneSweep
+struct SceneSweepStep {
+    // "objects", "lights" or "textures", the setting this step varies
+    std::string axis;
+    // index into the render path names given to Plan()
+    int renderPath = 0;
+    // multiplies every count but the street lights
+    float objectScale = 1.0f;
+    unsigned int streetLights = 0;
+    unsigned int textureSets = 1;
+};
+
+struct SceneSweepResult {
+    SceneSweepStep step;
+    size_t objects = 0;
+    size_t lights = 0;
+    size_t textures = 0;
+    float drawCalls = 0.0f;
+    // the most draws one frame skipped because the visibility buffer could not give them an id, a
+    // step with any timed a smaller scene than the other render paths and failed
+    unsigned int droppedDraws = 0;
+    FrameTimePercentiles cpuFrameMs;
+    FrameTimePercentiles gpuFrameMs;
+};
+
+// The timing run of the synthetic scene: for every render path the camera path is rendered once per
+// step while one setting changes and the others stay at the --scene values, the object counts from a
+// quarter to four times, the street lights from none to four times and the texture sets from one
+// to four. Along the lights axis the lamps are re-spaced at every step rather than added, so the
+// light coverage of the road stays even. WriteCsv() gives one row per step, ready to plot frame
+// time against the swept setting; rows with dropped_draws above zero did not fit the visibility
+// buffer's ids and are not comparable with the other render paths.
+class SceneSweep {
+public:
+    std::vector<SceneSweepStep> steps;
+    std::vector<SceneSweepResult> results;
+
+    SceneSweep() = default;
+    SceneSweep(const SceneSweep &) = delete;
+    SceneSweep &operator=(const SceneSweep &) = delete;
+
+    void Plan(const SyntheticSceneSettings &base, const std::vector<std::string> &renderPathNames) {
+        names = renderPathNames;
+        steps.clear();
+        results.clear();
+        current = 0;
+        unsigned int lights = base.counts[SCENE_ASSET_STREET_LIGHT];
+        for (int path = 0; path < (int) names.size(); path++) {
+            for (float scale : {0.25f, 0.5f, 1.0f, 2.0f, 4.0f})
+                steps.push_back({"objects", path, scale, lights, base.textureSets});
+            for (unsigned int scaled : {0u, lights / 2, lights, lights * 2, lights * 4})
+                steps.push_back({"lights", path, 1.0f, scaled, base.textureSets});
+            for (unsigned int sets : {1u, 2u, 4u})
+                steps.push_back({"textures", path, 1.0f, lights, sets});
+        }
+    }
+
+    bool Active() const {
+        return current < steps.size();
+    }
+
+    const SceneSweepStep &Step() const {
+        return steps[current];
+    }
+
+    // the scene of the current step
+    SyntheticSceneSettings Settings(const SyntheticSceneSettings &base) const {
+        SyntheticSceneSettings settings = base;
+        const SceneSweepStep &step = Step();
+        for (unsigned int asset = 0; asset < SCENE_ASSET_COUNT; asset++) {
+            if (asset != SCENE_ASSET_STREET_LIGHT)
+                settings.counts[asset] = (unsigned int) std::lround(base.counts[asset] * step.objectScale);
+        }
+        settings.counts[SCENE_ASSET_STREET_LIGHT] = step.streetLights;
+        settings.textureSets = step.textureSets;
+        settings.enabled = true;
+        return settings;
+    }
+
+    // call on every measured frame, before the stats are reset, with the draws the renderer skipped
+    void AddFrame(const FrameStats &stats, unsigned int droppedDraws) {
+        drawCallSum += stats.drawCalls;
+        maxDroppedDraws = std::max(maxDroppedDraws, droppedDraws);
+        frames++;
+    }
+
+    // finishes the current step, false once it was the last one
+    bool Next(const FrameTimePercentiles &cpuFrameMs, const FrameTimePercentiles &gpuFrameMs, size_t objects,
+              size_t lights, size_t textures) {
+        SceneSweepResult result;
+        result.step = Step();
+        result.objects = objects;
+        result.lights = lights;
+        result.textures = textures;
+        result.drawCalls = frames ? (float) ((double) drawCallSum / (double) frames) : 0.0f;
+        result.droppedDraws = maxDroppedDraws;
+        result.cpuFrameMs = cpuFrameMs;
+        result.gpuFrameMs = gpuFrameMs;
+        results.push_back(result);
+        std::cout << "SCENE_SWEEP:: step " << current + 1 << "/" << steps.size() << " " << names[result.step.renderPath]
+                  << " " << objects << " objects " << lights << " lights " << textures << " textures: cpu "
+                  << cpuFrameMs.mean << " ms gpu " << gpuFrameMs.mean << " ms" << std::endl;
+        if (result.droppedDraws > 0)
+            std::cout << "ERROR::SCENE_SWEEP:: step " << current + 1 << " dropped up to " << result.droppedDraws
+                      << " draws per frame, its row does not time the whole scene" << std::endl;
+        drawCallSum = 0;
+        maxDroppedDraws = 0;
+        frames = 0;
+        current++;
+        return Active();
+    }
+
+    bool WriteCsv(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::SCENE_SWEEP:: could not write " << path << std::endl;
+            return false;
+        }
+        out << "render_path,axis,objects,lights,textures,draw_calls,dropped_draws,cpu_mean_ms,cpu_p95_ms,gpu_mean_ms,"
+               "gpu_p95_ms\n";
+        for (const SceneSweepResult &result : results) {
+            out << names[result.step.renderPath] << "," << result.step.axis << "," << result.objects << ","
+                << result.lights << "," << result.textures << "," << result.drawCalls << "," << result.droppedDraws
+                << "," << result.cpuFrameMs.mean
+                << "," << result.cpuFrameMs.p95 << "," << result.gpuFrameMs.mean << "," << result.gpuFrameMs.p95
+                << "\n";
+        }
+        std::cout << "SCENE_SWEEP:: wrote " << results.size() << " steps to " << path << std::endl;
+        return true;
+    }
+
+private:
+    std::vector<std::string> names;
+    size_t current = 0;
+    unsigned long long drawCallSum = 0;
+    unsigned int maxDroppedDraws = 0;
+    unsigned int frames = 0;
+};
+
+};
+#endif //PROJECT_BASE_SYNTHETICSCENE_H
@@ -0,0 +1,101 @@
+#ifndef PROJECT_BASE_TEXTUREBUDGET_H
+#define PROJECT_BASE_TEXTUREBUDGET_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace rg {
+
+// halves a decoded 8 bit image in place with a 2x2 box filter, odd edges repeat their last texel
+inline void halveImage(unsigned char *data, int &width, int &height, int components) {
+    int halfWidth = std::max(width / 2, 1);
+    int halfHeight = std::max(height / 2, 1);
+    // every output texel only reads texels at or after its own position, so writing in order is safe
+    for (int y = 0; y < halfHeight; y++) {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < halfWidth; x++) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            unsigned int sums[4] = {};
+            for (int c = 0; c < components; c++) {
+                sums[c] = (unsigned int) data[(y0 * width + x0) * components + c] +
+                          data[(y0 * width + x1) * components + c] + data[(y1 * width + x0) * components + c] +
+                          data[(y1 * width + x1) * components + c];
+            }
+            for (int c = 0; c < components; c++)
+                data[(y * halfWidth + x) * components + c] = (unsigned char) ((sums[c] + 2) / 4);
+        }
+    }
+    width = halfWidth;
+    height = halfHeight;
+}
+
+// The largest size every texture needs, read from the report rg::TextureFeedback writes. The loaders
+// pass each decoded image through Apply(), which drops the mip levels above the budget before the
+// upload: nothing of them is uploaded, mipmapped or kept in memory. Textures the report does not
+// list are loaded as they are.
+class TextureBudget {
+public:
+    TextureBudget() = default;
+    TextureBudget(const TextureBudget &) = delete;
+    TextureBudget &operator=(const TextureBudget &) = delete;
+
+    // lines of "max_size width height finest_mip path", # starts a comment
+    bool Load(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::TEXTURE_BUDGET:: could not read " << path << std::endl;
+            return false;
+        }
+        maxSizes.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream fields(line);
+            int maxSize = 0, width = 0, height = 0, finestMip = 0;
+            std::string texture;
+            fields >> maxSize >> width >> height >> finestMip >> std::ws;
+            std::getline(fields, texture);
+            if (!fields || texture.empty() || maxSize <= 0) {
+                std::cout << "ERROR::TEXTURE_BUDGET:: malformed line in " << path << ": " << line << std::endl;
+                return false;
+            }
+            maxSizes[texture] = maxSize;
+        }
+        std::cout << "TEXTURE_BUDGET:: " << maxSizes.size() << " textures budgeted by " << path << std::endl;
+        return true;
+    }
+
+    // 0 when the texture has no budget
+    int MaxSize(const std::string &texture) const {
+        auto found = maxSizes.find(texture);
+        return found == maxSizes.end() ? 0 : found->second;
+    }
+
+    // halves the image until its larger side fits the budget, returns the number of levels dropped
+    unsigned int Apply(const std::string &texture, unsigned char *data, int &width, int &height,
+                       int components) const {
+        int maxSize = MaxSize(texture);
+        unsigned int dropped = 0;
+        while (maxSize > 0 && std::max(width, height) > maxSize) {
+            halveImage(data, width, height, components);
+            dropped++;
+        }
+        return dropped;
+    }
+
+private:
+    std::map<std::string, int> maxSizes;
+};
+
+inline TextureBudget &textureBudget() {
+    static TextureBudget budget;
+    return budget;
+}
+
+};
+#endif //PROJECT_BASE_TEXTUREBUDGET_H
@@ -0,0 +1,286 @@
+#ifndef PROJECT_BASE_TEXTUREFEEDBACK_H
+#define PROJECT_BASE_TEXTUREFEEDBACK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// what the feedback saw of one texture file
+struct TextureMipUsage {
+    // as the loader opened it, model directory + '/' + file
+    std::string path;
+    // of the loaded level 0
+    int width = 0;
+    int height = 0;
+    // finest mip level sampled on screen, -1 when no pixel showed the texture
+    int finestMip = -1;
+    // feedback pixels that showed it, summed over every pass
+    unsigned long long pixels = 0;
+
+    // the largest side worth loading, the loaded one when nothing was seen
+    int MaxSize(int minimumSize) const {
+        int size = std::max(width, height);
+        if (finestMip <= 0)
+            return size;
+        return std::min(size, std::max(size >> finestMip, minimumSize));
+    }
+};
+
+// Finds the finest mip level of every model texture that actually reaches the screen. Every interval
+// frames the draws recorded with Add() are rendered once more into a target downscale times smaller
+// than the frame, writing per pixel the mesh and the texture coordinate footprint of the pixel: the
+// log2 of the UV distance between neighbouring pixels, corrected by log2(downscale) back to the full
+// resolution. A texture of size S is then sampled at level log2(S) + footprint, the finest level of
+// a texture is the one of the pixel with the smallest footprint among all meshes using it.
+//
+// The target is read back through a pixel buffer during the next pass, so the feedback never waits
+// for the GPU. WriteReport() writes what rg::TextureBudget loads. Only models are covered, the plank
+// and the skybox are drawn without a mesh.
+class TextureFeedback {
+public:
+    bool enabled = false;
+    unsigned int downscale = 8;
+    unsigned int interval = 4;
+    // recommendations never go below this size
+    int minimumSize = 64;
+    // framebuffer bound again after a pass, 0 is the window
+    unsigned int outputFramebuffer = 0;
+
+    unsigned int passes = 0;
+
+    TextureFeedback() = default;
+    TextureFeedback(const TextureFeedback &) = delete;
+    TextureFeedback &operator=(const TextureFeedback &) = delete;
+
+    // a model drawn this frame with transform at the levels of detail lods
+    void Add(Model &model, const glm::mat4 &transform, const LodLevels &lods = LodLevels()) {
+        if (enabled)
+            draws.push_back({&model, transform, lods});
+    }
+
+    // call once per frame after the scene with its view and projection
+    void Render(Shader &feedbackShader, const glm::mat4 &view, const glm::mat4 &projection, int width, int height) {
+        if (!enabled || frameNumber++ % std::max(interval, 1u) != 0) {
+            draws.clear();
+            return;
+        }
+        if (pending)
+            collect();
+        setupTarget(std::max(width / (int) downscale, 1), std::max(height / (int) downscale, 1));
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, targetWidth, targetHeight);
+        glDisable(GL_BLEND);
+        const float empty[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, empty);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        feedbackShader.use();
+        feedbackShader.setMat4("view", view);
+        feedbackShader.setMat4("projection", projection);
+        feedbackShader.setFloat("downscaleLog2", std::log2((float) downscale));
+        feedbackShader.setInt("material.diffuse", 0);
+        glActiveTexture(GL_TEXTURE0);
+        for (const Draw &draw : draws) {
+            feedbackShader.setMat4("model", draw.transform);
+            for (unsigned int i = 0; i < draw.model->meshes.size(); i++) {
+                Mesh &mesh = draw.model->meshes[i];
+                feedbackShader.setFloat("meshId", (float) (meshId(*draw.model, mesh) + 1));
+                // for the alpha test, unit 0 is what the trash shader samples as material.diffuse
+                glBindTexture(GL_TEXTURE_2D, mesh.textures.empty() ? 0 : mesh.textures[0].id);
+                const MeshLod &lod = mesh.lods[lodLevel(draw.lods, i)];
+                glBindVertexArray(mesh.VAO);
+                glDrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                               (void *) (lod.firstIndex * sizeof(unsigned int)));
+            }
+        }
+        glBindVertexArray(0);
+        draws.clear();
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glReadPixels(0, 0, targetWidth, targetHeight, GL_RG, GL_FLOAT, (void *) 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        pending = true;
+        passes++;
+
+        glEnable(GL_BLEND);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // every texture of every mesh drawn so far, sorted by path, without the pass still being read back
+    std::vector<TextureMipUsage> Usage() const {
+        std::vector<TextureMipUsage> usage = textures;
+        for (size_t mesh = 0; mesh < meshTextures.size(); mesh++) {
+            if (meshFootprints[mesh] == std::numeric_limits<float>::max())
+                continue;
+            for (size_t index : meshTextures[mesh]) {
+                TextureMipUsage &texture = usage[index];
+                int level = std::max((int) std::floor(std::log2((float) std::max(texture.width, texture.height)) +
+                                                      meshFootprints[mesh]), 0);
+                texture.finestMip = texture.finestMip < 0 ? level : std::min(texture.finestMip, level);
+                texture.pixels += meshPixels[mesh];
+            }
+        }
+        std::sort(usage.begin(), usage.end(), [](const TextureMipUsage &a, const TextureMipUsage &b) {
+            return a.path < b.path;
+        });
+        return usage;
+    }
+
+    void Reset() {
+        std::fill(meshFootprints.begin(), meshFootprints.end(), std::numeric_limits<float>::max());
+        std::fill(meshPixels.begin(), meshPixels.end(), 0ull);
+        pending = false;
+        passes = 0;
+    }
+
+    // the file rg::TextureBudget::Load reads, textures that were never seen are listed as comments
+    bool WriteReport(const std::string &path) {
+        if (pending)
+            collect();
+        std::vector<TextureMipUsage> usage = Usage();
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::TEXTURE_FEEDBACK:: could not write " << path << std::endl;
+            return false;
+        }
+        out << "# texture mip feedback of " << passes << " passes at 1/" << downscale << " resolution\n"
+            << "# max_size width height finest_mip path\n";
+        unsigned int reduced = 0;
+        for (const TextureMipUsage &texture : usage) {
+            if (texture.finestMip < 0) {
+                out << "# not seen: " << texture.path << "\n";
+                continue;
+            }
+            int maxSize = texture.MaxSize(minimumSize);
+            if (maxSize < std::max(texture.width, texture.height))
+                reduced++;
+            out << maxSize << " " << texture.width << " " << texture.height << " " << texture.finestMip << " "
+                << texture.path << "\n";
+        }
+        std::cout << "TEXTURE_FEEDBACK:: wrote " << usage.size() << " textures to " << path << ", " << reduced
+                  << " can be loaded smaller" << std::endl;
+        return true;
+    }
+
+private:
+    struct Draw {
+        Model *model;
+        glm::mat4 transform;
+        LodLevels lods;
+    };
+
+    std::vector<Draw> draws;
+    unsigned long long frameNumber = 0;
+
+    // per mesh id: the indices into textures, the smallest footprint seen and the pixels seen
+    std::map<const Mesh *, size_t> meshIds;
+    std::vector<std::vector<size_t>> meshTextures;
+    std::vector<float> meshFootprints;
+    std::vector<unsigned long long> meshPixels;
+    std::vector<TextureMipUsage> textures;
+    std::map<std::string, size_t> textureIndex;
+
+    unsigned int fbo = 0, colorTexture = 0, depthBuffer = 0, pbo = 0;
+    int targetWidth = 0, targetHeight = 0;
+    bool pending = false;
+
+    size_t meshId(const Model &model, const Mesh &mesh) {
+        auto found = meshIds.find(&mesh);
+        if (found != meshIds.end())
+            return found->second;
+        size_t id = meshTextures.size();
+        meshIds.emplace(&mesh, id);
+        meshTextures.emplace_back();
+        meshFootprints.push_back(std::numeric_limits<float>::max());
+        meshPixels.push_back(0);
+        for (const Texture &texture : mesh.textures) {
+            std::string path = model.directory + '/' + texture.path;
+            auto index = textureIndex.find(path);
+            if (index == textureIndex.end()) {
+                index = textureIndex.emplace(path, textures.size()).first;
+                textures.emplace_back();
+                textures.back().path = path;
+                glBindTexture(GL_TEXTURE_2D, texture.id);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textures.back().width);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textures.back().height);
+            }
+            if (std::find(meshTextures[id].begin(), meshTextures[id].end(), index->second) == meshTextures[id].end())
+                meshTextures[id].push_back(index->second);
+        }
+        return id;
+    }
+
+    void setupTarget(int width, int height) {
+        if (fbo != 0 && width == targetWidth && height == targetHeight)
+            return;
+        if (fbo == 0) {
+            glGenFramebuffers(1, &fbo);
+            glGenTextures(1, &colorTexture);
+            glGenRenderbuffers(1, &depthBuffer);
+            glGenBuffers(1, &pbo);
+        }
+        // a pass still in the old size is dropped
+        pending = false;
+        targetWidth = width;
+        targetHeight = height;
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::TEXTURE_FEEDBACK:: feedback framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 2 * sizeof(float), nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // folds the previous pass into the per mesh minimum
+    void collect() {
+        pending = false;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        const float *pixels = (const float *) glMapBufferRange(
+                GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr) targetWidth * targetHeight * 2 * sizeof(float), GL_MAP_READ_BIT);
+        if (pixels) {
+            for (size_t i = 0; i < (size_t) targetWidth * (size_t) targetHeight; i++) {
+                size_t id = (size_t) pixels[2 * i];
+                if (id == 0 || id > meshFootprints.size())
+                    continue;
+                meshFootprints[id - 1] = std::min(meshFootprints[id - 1], pixels[2 * i + 1]);
+                meshPixels[id - 1]++;
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+};
+
+inline TextureFeedback &textureFeedback() {
+    static TextureFeedback feedback;
+    return feedback;
+}
+
+};
+#endif //PROJECT_BASE_TEXTUREFEEDBACK_H
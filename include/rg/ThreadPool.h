@@ -0,0 +1,105 @@
+#ifndef PROJECT_BASE_THREADPOOL_H
+#define PROJECT_BASE_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+// Persistent worker threads for splitting per-frame CPU work. parallelFor hands out job indices
+// from an atomic counter, the calling thread works along and returns once every job has run.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threads = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+        for (unsigned int i = 0; i < threads; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // threads working on a parallelFor, including the caller
+    unsigned int size() const {
+        return (unsigned int) workers.size() + 1;
+    }
+
+    // calls f(i) for every i in [0, count), not reentrant
+    template<typename F>
+    void parallelFor(unsigned int count, F f) {
+        if (workers.empty() || count <= 1) {
+            for (unsigned int i = 0; i < count; i++)
+                f(i);
+            return;
+        }
+        std::function<void(unsigned int)> job = [&f](unsigned int i) { f(i); };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &job;
+            jobCount = count;
+            next = 0;
+            busyWorkers = (unsigned int) workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        runJobs();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busyWorkers == 0; });
+        task = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(unsigned int)> *task = nullptr;
+    unsigned int jobCount = 0;
+    std::atomic<unsigned int> next{0};
+    unsigned int busyWorkers = 0;
+    unsigned long long generation = 0;
+    bool stop = false;
+
+    void runJobs() {
+        for (unsigned int i = next++; i < jobCount; i = next++)
+            (*task)(i);
+    }
+
+    void workerLoop() {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this, seen] { return stop || generation != seen; });
+            if (stop)
+                return;
+            seen = generation;
+            lock.unlock();
+            runJobs();
+            lock.lock();
+            if (--busyWorkers == 0)
+                done.notify_one();
+        }
+    }
+};
+
+inline ThreadPool &threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+};
+#endif //PROJECT_BASE_THREADPOOL_H
@@ -0,0 +1,212 @@
+#ifndef PROJECT_BASE_TRACE_H
+#define PROJECT_BASE_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+// small sequential id of the calling thread, the main thread is usually 1
+inline uint32_t traceThreadId() {
+    static std::atomic<uint32_t> nextId(1);
+    thread_local uint32_t id = nextId++;
+    return id;
+}
+
+// nanoseconds since the first call, the time base of every trace
+inline uint64_t traceNowNs() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+}
+
+inline std::string traceJsonString(const std::string &value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if ((unsigned char) c >= 0x20)
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// one complete ("ph":"X") event of the Chrome trace event format, Perfetto reads the same
+inline void writeChromeTraceEvent(std::ostream &out, const std::string &name, const std::string &detail,
+                                  uint64_t startNs, uint64_t durationNs, uint32_t threadId) {
+    char times[64];
+    std::snprintf(times, sizeof(times), "\"ts\": %.3f, \"dur\": %.3f", startNs / 1000.0, durationNs / 1000.0);
+    out << "{\"name\": " << traceJsonString(name) << ", \"ph\": \"X\", " << times << ", \"pid\": 1, \"tid\": "
+        << threadId;
+    if (!detail.empty())
+        out << ", \"args\": {\"detail\": " << traceJsonString(detail) << "}";
+    out << "}";
+}
+
+struct TraceEvent {
+    std::string name;
+    // what the scope worked on, e.g. the model or texture path
+    std::string detail;
+    uint64_t startNs = 0;
+    uint64_t durationNs = 0;
+    uint32_t threadId = 0;
+};
+
+// Collects timed scopes from any thread, meant for one-off work like startup where a mutex per
+// event costs nothing next to the work being measured. Stop() ends the recording so scopes run
+// later (a model loaded at runtime) do not pile up.
+class TraceRecorder {
+public:
+    TraceRecorder() = default;
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    bool Recording() const {
+        return recording.load(std::memory_order_relaxed);
+    }
+
+    void Stop() {
+        recording = false;
+    }
+
+    void Record(TraceEvent event) {
+        if (!Recording())
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(std::move(event));
+    }
+
+    bool WriteChromeTrace(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::TRACE:: could not write " << path << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        for (size_t i = 0; i < events.size(); i++) {
+            const TraceEvent &event = events[i];
+            writeChromeTraceEvent(out, event.name, event.detail, event.startNs, event.durationNs, event.threadId);
+            out << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+        out << "]}\n";
+        std::cout << "TRACE:: wrote " << events.size() << " events to " << path << std::endl;
+        return true;
+    }
+
+    // One row per scope name and detail, sorted by self time (the time not spent in nested scopes
+    // on the same thread), so the costly leaves come first instead of the scopes enclosing them.
+    void PrintSummary(unsigned int rows = 25) const {
+        struct Row {
+            std::string name;
+            unsigned int count = 0;
+            uint64_t totalNs = 0;
+            uint64_t selfNs = 0;
+        };
+        std::vector<uint64_t> selfNs;
+        std::vector<TraceEvent> sorted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            sorted = events;
+        }
+        // parents before their children: by thread, then start, longer scopes first on ties
+        std::sort(sorted.begin(), sorted.end(), [](const TraceEvent &a, const TraceEvent &b) {
+            if (a.threadId != b.threadId)
+                return a.threadId < b.threadId;
+            if (a.startNs != b.startNs)
+                return a.startNs < b.startNs;
+            return a.durationNs > b.durationNs;
+        });
+        selfNs.resize(sorted.size());
+        std::vector<size_t> open;
+        for (size_t i = 0; i < sorted.size(); i++) {
+            const TraceEvent &event = sorted[i];
+            while (!open.empty() && (sorted[open.back()].threadId != event.threadId ||
+                                     sorted[open.back()].startNs + sorted[open.back()].durationNs <= event.startNs))
+                open.pop_back();
+            selfNs[i] = event.durationNs;
+            if (!open.empty())
+                selfNs[open.back()] -= std::min(selfNs[open.back()], event.durationNs);
+            open.push_back(i);
+        }
+
+        std::map<std::string, Row> byName;
+        for (size_t i = 0; i < sorted.size(); i++) {
+            std::string key = sorted[i].detail.empty() ? sorted[i].name : sorted[i].name + " " + sorted[i].detail;
+            Row &row = byName[key];
+            row.name = key;
+            row.count++;
+            row.totalNs += sorted[i].durationNs;
+            row.selfNs += selfNs[i];
+        }
+        std::vector<Row> table;
+        for (auto &entry : byName)
+            table.push_back(entry.second);
+        std::sort(table.begin(), table.end(), [](const Row &a, const Row &b) {
+            return a.selfNs > b.selfNs;
+        });
+
+        std::printf("%10s %10s %6s  %s\n", "self ms", "total ms", "count", "scope");
+        for (size_t i = 0; i < table.size() && i < rows; i++) {
+            std::printf("%10.2f %10.2f %6u  %s\n", table[i].selfNs / 1.0e6, table[i].totalNs / 1.0e6,
+                        table[i].count, table[i].name.c_str());
+        }
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<TraceEvent> events;
+    std::atomic<bool> recording{true};
+};
+
+inline TraceRecorder &startupTrace() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+// Times the enclosing scope into startupTrace(), End() closes it early for work that is not a block
+// of its own.
+class TraceScope {
+public:
+    explicit TraceScope(const char *name, std::string detail = std::string()) {
+        if (!startupTrace().Recording())
+            return;
+        event.name = name;
+        event.detail = std::move(detail);
+        event.threadId = traceThreadId();
+        event.startNs = traceNowNs();
+        open = true;
+    }
+
+    ~TraceScope() {
+        End();
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    void End() {
+        if (!open)
+            return;
+        open = false;
+        event.durationNs = traceNowNs() - event.startNs;
+        startupTrace().Record(std::move(event));
+    }
+
+private:
+    TraceEvent event;
+    bool open = false;
+};
+
+};
+#endif //PROJECT_BASE_TRACE_H
@@ -0,0 +1,327 @@
+#ifndef PROJECT_BASE_VISIBILITYBUFFER_H
+#define PROJECT_BASE_VISIBILITYBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/RenderStats.h>
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace rg {
+
+// Visibility buffer: the geometry pass (the VISIBILITY permutation of trash.vs/fs) writes nothing but
+// a 32 bit id per pixel, the draw + 1 in the top bits and the triangle within the draw in the low
+// TRIANGLE_BITS. Resolve then runs a single fullscreen pass that looks the triangle up in vertex and
+// index buffers shared by every model drawn so far, intersects the pixel's view ray with it for the
+// barycentrics and shades the pixel exactly once, however many layers of leaves were drawn over it.
+//
+// OpenGL 3.3 has neither storage buffers nor bindless textures, so the shared buffers are texture
+// buffers and the diffuse textures are resampled into the layers of one texture array.
+class VisibilityBuffer {
+public:
+    static const unsigned int TRIANGLE_BITS = 20;
+    static const unsigned int MAX_DRAWS = (1u << (32 - TRIANGLE_BITS)) - 1;
+    // gl_PrimitiveID of a larger mesh would run into the draw bits
+    static const unsigned int MAX_TRIANGLES = 1u << TRIANGLE_BITS;
+    // edge length the diffuse textures are resampled to
+    static const unsigned int LAYER_SIZE = 1024;
+    // texels of drawData per draw, has to match visibility_resolve.fs
+    static const unsigned int DRAW_TEXELS = 8;
+
+    // framebuffer the lit image goes to, 0 is the window
+    unsigned int outputFramebuffer = 0;
+
+    // statistics of the last frame
+    unsigned int drawCount = 0;
+    // meshes skipped past MAX_DRAWS or for having more than MAX_TRIANGLES triangles
+    unsigned int droppedDraws = 0;
+    unsigned int layerCount = 0;
+
+    VisibilityBuffer() = default;
+    VisibilityBuffer(const VisibilityBuffer &) = delete;
+    VisibilityBuffer &operator=(const VisibilityBuffer &) = delete;
+
+    // binds the visibility target for the geometry pass, it follows the framebuffer size
+    void Begin(unsigned int width, unsigned int height) {
+        setupTarget(width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        const GLuint empty[4] = {0, 0, 0, 0};
+        glClearBufferuiv(GL_COLOR, 0, empty);
+        glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        glDisable(GL_BLEND);
+        drawData.clear();
+        drawInfo.clear();
+        drawCount = 0;
+        droppedDraws = 0;
+    }
+
+    // draws every mesh of the model at the placement's levels of detail, shader is the VISIBILITY
+    // variant with projection and view already set. The model joins the shared buffers on its first draw.
+    void Draw(Model &model, const glm::mat4 &transform, Shader &shader, float shininess,
+              const LodLevels &lods = LodLevels()) {
+        if (model.meshes.empty())
+            return;
+        if (ranges.find(&model.meshes[0]) == ranges.end())
+            add(model);
+
+        shader.setMat4("model", transform);
+        glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(transform)));
+        for (unsigned int i = 0; i < model.meshes.size(); i++) {
+            Mesh &mesh = model.meshes[i];
+            unsigned int lod = lodLevel(lods, i);
+            if (drawCount == MAX_DRAWS) {
+                droppedDraws++;
+                continue;
+            }
+            const MeshRange &range = ranges[&mesh];
+            if (!range.fits) {
+                droppedDraws++;
+                continue;
+            }
+            drawData.push_back(transform[0]);
+            drawData.push_back(transform[1]);
+            drawData.push_back(transform[2]);
+            drawData.push_back(transform[3]);
+            drawData.push_back(glm::vec4(normalMatrix[0], shininess));
+            drawData.push_back(glm::vec4(normalMatrix[1], 0.0f));
+            drawData.push_back(glm::vec4(normalMatrix[2], 0.0f));
+            drawData.push_back(glm::vec4(1.0f));
+            drawInfo.push_back(range.firstElement + mesh.lods[lod].firstIndex);
+            drawInfo.push_back(range.layer + 1);
+
+            shader.setInt("drawId", ++drawCount);
+            mesh.Draw(shader, lod);
+        }
+    }
+
+    // shades the visibility buffer into the output framebuffer and copies the depth over, resolveShader
+    // is the visibility_resolve permutation of the frame's light mode with its light uniforms set
+    void Resolve(Shader &resolveShader, const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &viewPos) {
+        if (geometryDirty)
+            uploadGeometry();
+        if (layersDirty)
+            buildLayers();
+        upload(drawBuffer, drawData.size() * sizeof(glm::vec4), drawData.data());
+        upload(drawInfoBuffer, drawInfo.size() * sizeof(unsigned int), drawInfo.data());
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                          GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, visibilityTexture);
+        const unsigned int buffers[4] = {vertexTexture, indexTexture, drawTexture, drawInfoTexture};
+        for (unsigned int i = 0; i < 4; i++) {
+            glActiveTexture(GL_TEXTURE1 + i);
+            glBindTexture(GL_TEXTURE_BUFFER, buffers[i]);
+        }
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layers);
+        glActiveTexture(GL_TEXTURE0);
+
+        resolveShader.use();
+        resolveShader.setInt("visibility", 0);
+        resolveShader.setInt("vertexData", 1);
+        resolveShader.setInt("indexData", 2);
+        resolveShader.setInt("drawData", 3);
+        resolveShader.setInt("drawInfo", 4);
+        resolveShader.setInt("diffuseLayers", 5);
+        glm::mat4 viewProjection = projection * view;
+        resolveShader.setMat4("viewProjection", viewProjection);
+        resolveShader.setMat4("inverseViewProjection", glm::inverse(viewProjection));
+        resolveShader.setVec2("screenSize", glm::vec2((float) width, (float) height));
+        resolveShader.setVec3("viewPos", viewPos);
+
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        countDraw(1);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+    }
+
+private:
+    // where a mesh's elements start in the shared index buffer and its texture array layer, -1 for none
+    struct MeshRange {
+        unsigned int firstElement;
+        int layer;
+        // false for meshes with more than MAX_TRIANGLES triangles, they are never drawn
+        bool fits;
+    };
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int fbo = 0;
+    unsigned int visibilityTexture = 0;
+    unsigned int depthStencil = 0;
+    unsigned int fullscreenVAO = 0;
+
+    unsigned int vertexBuffer = 0, vertexTexture = 0;
+    unsigned int indexBuffer = 0, indexTexture = 0;
+    unsigned int drawBuffer = 0, drawTexture = 0;
+    unsigned int drawInfoBuffer = 0, drawInfoTexture = 0;
+    unsigned int layers = 0;
+
+    std::map<const Mesh *, MeshRange> ranges;
+    // two texels per vertex: (position, u) and (normal, v)
+    std::vector<glm::vec4> vertexData;
+    // vertex indices into vertexData, already offset by the mesh's first vertex
+    std::vector<unsigned int> indexData;
+    std::vector<unsigned int> layerTextures;
+    bool geometryDirty = false;
+    bool layersDirty = false;
+
+    std::vector<glm::vec4> drawData;
+    // (first element, layer + 1) per draw
+    std::vector<unsigned int> drawInfo;
+
+    void add(Model &model) {
+        for (const Mesh &mesh : model.meshes) {
+            MeshRange range;
+            range.firstElement = (unsigned int) indexData.size();
+            range.layer = -1;
+            range.fits = mesh.lods[0].indexCount / 3 <= MAX_TRIANGLES;
+            if (!range.fits) {
+                std::cout << "ERROR::VISIBILITY_BUFFER:: a mesh of " << model.directory << " has "
+                          << mesh.lods[0].indexCount / 3 << " triangles, the triangle ids only hold "
+                          << MAX_TRIANGLES << ", it is skipped" << std::endl;
+                ranges[&mesh] = range;
+                continue;
+            }
+            // the forward shaders never bind material.specular, both samplers read unit 0, i.e. the
+            // first texture of the mesh, so that is the one that gets a layer
+            if (!mesh.textures.empty()) {
+                unsigned int texture = mesh.textures[0].id;
+                for (unsigned int i = 0; i < layerTextures.size() && range.layer < 0; i++)
+                    if (layerTextures[i] == texture)
+                        range.layer = (int) i;
+                if (range.layer < 0) {
+                    range.layer = (int) layerTextures.size();
+                    layerTextures.push_back(texture);
+                    layersDirty = true;
+                }
+            }
+            ranges[&mesh] = range;
+
+            unsigned int firstVertex = (unsigned int) vertexData.size() / 2;
+            for (const Vertex &vertex : mesh.vertices) {
+                vertexData.push_back(glm::vec4(vertex.Position, vertex.TexCoords.x));
+                vertexData.push_back(glm::vec4(vertex.Normal, vertex.TexCoords.y));
+            }
+            for (unsigned int element : mesh.elements)
+                indexData.push_back(firstVertex + element);
+        }
+        geometryDirty = true;
+    }
+
+    void setupTarget(unsigned int width, unsigned int height) {
+        if (fbo == 0) {
+            glGenFramebuffers(1, &fbo);
+            glGenTextures(1, &visibilityTexture);
+            glGenRenderbuffers(1, &depthStencil);
+            // the fullscreen triangle is generated from gl_VertexID, core profile still wants a VAO
+            glGenVertexArrays(1, &fullscreenVAO);
+            createTextureBuffer(vertexBuffer, vertexTexture, GL_RGBA32F);
+            createTextureBuffer(indexBuffer, indexTexture, GL_R32UI);
+            createTextureBuffer(drawBuffer, drawTexture, GL_RGBA32F);
+            createTextureBuffer(drawInfoBuffer, drawInfoTexture, GL_RG32UI);
+            glGenTextures(1, &layers);
+        }
+        if (width == this->width && height == this->height)
+            return;
+        this->width = width;
+        this->height = height;
+
+        glBindTexture(GL_TEXTURE_2D, visibilityTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        // same format as the output framebuffer's so the depth can be copied over
+        glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibilityTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::VISIBILITY:: visibility framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    static void createTextureBuffer(unsigned int &buffer, unsigned int &texture, GLenum format) {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_DYNAMIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    static void upload(unsigned int buffer, size_t size, const void *data) {
+        if (size == 0)
+            return;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // orphan the previous storage so we never wait on the GPU still reading last frame's data
+        glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void uploadGeometry() {
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        if (vertexData.size() > (size_t) maxTexels || indexData.size() > (size_t) maxTexels)
+            std::cout << "ERROR::VISIBILITY:: shared geometry exceeds GL_MAX_TEXTURE_BUFFER_SIZE" << std::endl;
+        upload(vertexBuffer, vertexData.size() * sizeof(glm::vec4), vertexData.data());
+        upload(indexBuffer, indexData.size() * sizeof(unsigned int), indexData.data());
+        geometryDirty = false;
+    }
+
+    // resamples every diffuse texture into its layer, then builds the mip chain of the whole array
+    void buildLayers() {
+        layerCount = (unsigned int) layerTextures.size();
+        layersDirty = false;
+        if (layerCount == 0)
+            return;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layers);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, LAYER_SIZE, LAYER_SIZE, layerCount, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+
+        unsigned int framebuffers[2];
+        glGenFramebuffers(2, framebuffers);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+        for (unsigned int layer = 0; layer < layerCount; layer++) {
+            GLint sourceWidth = 0, sourceHeight = 0;
+            glBindTexture(GL_TEXTURE_2D, layerTextures[layer]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &sourceWidth);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &sourceHeight);
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, layerTextures[layer], 0);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, layers, 0, layer);
+            glBlitFramebuffer(0, 0, sourceWidth, sourceHeight, 0, 0, LAYER_SIZE, LAYER_SIZE,
+                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(2, framebuffers);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layers);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+};
+
+};
+#endif //PROJECT_BASE_VISIBILITYBUFFER_H
@@ -0,0 +1,24 @@
+#version 330 core
+out vec4 FragColor;
+
+// fragments written per pixel, accumulated by rg::DebugViews
+uniform sampler2D layers;
+// layers at the red end of the ramp
+uniform float maxLayers;
+
+// blue, cyan, green, yellow, red, has to match rg::heatColor
+vec3 heatColor(float t)
+{
+    const vec3 stops[5] = vec3[](vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 1.0, 0.0),
+                                 vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0));
+    float x = clamp(t, 0.0, 1.0) * 4.0;
+    int i = min(int(x), 3);
+    return mix(stops[i], stops[i + 1], x - float(i));
+}
+
+void main()
+{
+    float count = texelFetch(layers, ivec2(gl_FragCoord.xy), 0).r;
+    // nothing drawn stays black, a single layer is the cold end
+    FragColor = count > 0.0 ? vec4(heatColor((count - 1.0) / max(maxLayers - 1.0, 1.0)), 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,78 @@
+#version 330 core
+out vec4 FragColor;
+
+// written by the GBUFFER permutations of the lit shaders, everything is in world space
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gPosition;
+uniform vec3 viewPos;
+
+#if defined(DIRECTIONAL)
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform DirLight dirLight;
+#else
+// five texels per light, packed by rg::packLight, see CalcClusteredLights
+uniform samplerBuffer lights;
+
+flat in int LightIndex;
+#endif
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, pixel, 0);
+    vec3 fragPos = texelFetch(gPosition, pixel, 0).xyz;
+    vec3 albedo = albedoSpecular.rgb;
+    vec3 normal = normalShininess.xyz;
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+#if defined(DIRECTIONAL)
+    vec3 lightDir = normalize(-dirLight.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(viewDir, halfwayDir), 0.0), normalShininess.w);
+    // combine results
+    vec3 ambient = dirLight.ambient * albedo;
+    vec3 diffuse = dirLight.diffuse * diff * albedo;
+    vec3 specular = dirLight.specular * spec * albedoSpecular.a;
+    vec3 result = ambient + diffuse + specular;
+#else
+    int base = LightIndex * 5;
+    vec4 positionRadius = texelFetch(lights, base);
+    vec4 ambientConstant = texelFetch(lights, base + 1);
+    vec4 diffuseLinear = texelFetch(lights, base + 2);
+    vec4 specularQuadratic = texelFetch(lights, base + 3);
+    vec4 cone = texelFetch(lights, base + 4);
+
+    float distance = length(positionRadius.xyz - fragPos);
+    vec3 lightDir = (positionRadius.xyz - fragPos) / distance;
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(viewDir, halfwayDir), 0.0), normalShininess.w);
+    // attenuation, faded out to reach zero at the edge of the volume
+    float attenuation = 1.0 / (ambientConstant.w + diffuseLinear.w * distance + specularQuadratic.w * (distance * distance));
+    float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+    // spotlight intensity, point lights have no direction and an offset of 1
+    float intensity = clamp(dot(lightDir, -cone.xyz) + cone.w, 0.0, 1.0);
+    // combine results
+    vec3 ambient = ambientConstant.rgb * albedo;
+    vec3 diffuse = diffuseLinear.rgb * diff * albedo;
+    vec3 specular = specularQuadratic.rgb * spec * albedoSpecular.a;
+    vec3 result = (ambient + diffuse + specular) * attenuation * intensity;
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
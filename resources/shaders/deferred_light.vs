@@ -0,0 +1,28 @@
+#version 330 core
+// DIRECTIONAL is the fullscreen pass of rg::DeferredRenderer, without it every instance is the
+// sphere volume of one point or spot light
+#if defined(DIRECTIONAL)
+void main()
+{
+    // one triangle covering the screen, generated without a vertex buffer
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+#else
+layout (location = 0) in vec3 aPos;
+
+flat out int LightIndex;
+
+// five texels per light, packed by rg::packLight
+uniform samplerBuffer lights;
+uniform int lightOffset;
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    LightIndex = lightOffset + gl_InstanceID;
+    vec4 positionRadius = texelFetch(lights, LightIndex * 5);
+    gl_Position = projection * view * vec4(positionRadius.xyz + aPos * positionRadius.w, 1.0);
+}
+#endif
@@ -0,0 +1,293 @@
+#version 330 core
+#if defined(GBUFFER)
+// the G-buffer of rg::DeferredRenderer, see deferred_light.fs
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormalShininess;
+layout (location = 2) out vec4 gPosition;
+#else
+out vec4 FragColor;
+#endif
+
+// exactly one of LIGHT_DIRECTIONAL, LIGHT_POINT, LIGHT_SPOT, LIGHT_CLUSTERED and GBUFFER is defined
+// by rg::ShaderPermutations, the clustered lights come on top of the directional one
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+#elif defined(LIGHT_POINT)
+struct PointLight {
+    vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+#elif defined(LIGHT_SPOT)
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+#endif
+
+in vec3 ObjectPos;
+flat in vec3 ObjectViewPos;
+flat in mat4 ModelMatrix;
+flat in mat3 NormalMatrix;
+flat in vec4 Tint;
+flat in vec2 Frame0;
+flat in vec2 Frame1;
+flat in vec2 Frame2;
+flat in vec3 FrameWeights;
+
+uniform vec3 viewPos;
+#if defined(DEBUG_VIEW)
+// colour of rg::DebugViews, alpha is how much of the lit colour it replaces
+uniform vec4 debugColor;
+#endif
+uniform mat4 view;
+uniform mat4 projection;
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+uniform DirLight dirLight;
+#elif defined(LIGHT_POINT)
+uniform PointLight pointLight;
+#elif defined(LIGHT_SPOT)
+uniform SpotLight spotLight;
+#endif
+uniform float shininess;
+uniform float specularStrength;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+uniform float framesPerSide;
+
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+vec3 CalcDirLight(DirLight light, vec3 albedo, vec3 normal, vec3 viewDir);
+#elif defined(LIGHT_POINT)
+vec3 CalcPointLight(PointLight light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir);
+#elif defined(LIGHT_SPOT)
+vec3 CalcSpotLight(SpotLight light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+
+#if defined(LIGHT_CLUSTERED)
+// point and spot lights binned into view-space clusters by rg::ClusteredLights: every light is five
+// texels of clusterLights, clusterRanges holds (first index, count) of each cluster's light list
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthSlicing;
+uniform vec2 clusterNearFar;
+
+int clusterIndex(vec2 fragCoord, float depth)
+{
+    float near = clusterNearFar.x;
+    float far = clusterNearFar.y;
+    float viewDepth = 2.0 * near * far / (far + near - (depth * 2.0 - 1.0) * (far - near));
+    int slice = clamp(int(log(viewDepth) * clusterDepthSlicing.x + clusterDepthSlicing.y), 0, clusterDims.z - 1);
+    ivec2 tile = clamp(ivec2(fragCoord / clusterTileSize), ivec2(0), clusterDims.xy - 1);
+    return tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+}
+
+// calculates the color of every point and spot light in the fragment's cluster.
+vec3 CalcClusteredLights(int cluster, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    uvec2 range = texelFetch(clusterRanges, cluster).rg;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int base = int(texelFetch(clusterIndices, int(range.x + i)).r) * 5;
+        vec4 positionRadius = texelFetch(clusterLights, base);
+        vec4 ambientConstant = texelFetch(clusterLights, base + 1);
+        vec4 diffuseLinear = texelFetch(clusterLights, base + 2);
+        vec4 specularQuadratic = texelFetch(clusterLights, base + 3);
+        vec4 cone = texelFetch(clusterLights, base + 4);
+
+        float distance = length(positionRadius.xyz - fragPos);
+        vec3 lightDir = (positionRadius.xyz - fragPos) / distance;
+        // diffuse shading
+        float diff = max(dot(normal, lightDir), 0.0);
+        // specular shading
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(viewDir, halfwayDir), 0.0), shininess);
+        // attenuation, faded out to reach zero at the radius the light was binned with
+        float attenuation = 1.0 / (ambientConstant.w + diffuseLinear.w * distance + specularQuadratic.w * (distance * distance));
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+        // spotlight intensity, cone.xyz is the direction scaled by 1 / (cutOff - outerCutOff),
+        // point lights have no direction and an offset of 1
+        float intensity = clamp(dot(lightDir, -cone.xyz) + cone.w, 0.0, 1.0);
+        // combine results
+        vec3 ambient = ambientConstant.rgb * albedo;
+        vec3 diffuse = diffuseLinear.rgb * diff * albedo;
+        vec3 specular = specularQuadratic.rgb * spec * specularColor;
+        result += (ambient + diffuse + specular) * attenuation * intensity;
+    }
+    return result;
+}
+#endif
+
+vec3 hemiOctDecode(vec2 e)
+{
+    vec2 t = vec2(e.x + e.y, e.x - e.y) * 0.5;
+    return normalize(vec3(t.x, 1.0 - abs(t.x) - abs(t.y), t.y));
+}
+
+// intersects the view ray with the plane of a frame and samples the atlas there,
+// has to build the same camera basis as Impostor::Bake
+void sampleFrame(vec2 frame, vec3 rayDir, out vec4 albedo, out vec4 normalDepth, out vec3 planePos)
+{
+    vec3 direction = hemiOctDecode(frame / (framesPerSide - 1.0) * 2.0 - 1.0);
+    vec3 up = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(-direction, up));
+    up = cross(right, -direction);
+
+    float t = dot(boundsCenter - ObjectViewPos, direction) / dot(rayDir, direction);
+    planePos = ObjectViewPos + rayDir * t;
+    vec2 uv = vec2(dot(planePos - boundsCenter, right), dot(planePos - boundsCenter, up)) / (2.0 * boundsRadius) + 0.5;
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+        albedo = vec4(0.0);
+        normalDepth = vec4(0.5, 0.5, 0.5, 0.5);
+        return;
+    }
+    vec2 atlasUv = (frame + uv) / framesPerSide;
+    albedo = texture(albedoAtlas, atlasUv);
+    normalDepth = texture(normalDepthAtlas, atlasUv);
+    // move from the frame plane to the baked surface
+    planePos += direction * (normalDepth.a * 2.0 - 1.0) * boundsRadius;
+}
+
+void main()
+{
+    vec3 rayDir = normalize(ObjectPos - ObjectViewPos);
+    vec4 albedo0, albedo1, albedo2;
+    vec4 normal0, normal1, normal2;
+    vec3 pos0, pos1, pos2;
+    sampleFrame(Frame0, rayDir, albedo0, normal0, pos0);
+    sampleFrame(Frame1, rayDir, albedo1, normal1, pos1);
+    sampleFrame(Frame2, rayDir, albedo2, normal2, pos2);
+
+    vec4 albedo = albedo0 * FrameWeights.x + albedo1 * FrameWeights.y + albedo2 * FrameWeights.z;
+    if (albedo.a < 0.5)
+        discard;
+    albedo.rgb /= albedo.a;
+    vec3 objectNormal = (normal0.rgb * albedo0.a * FrameWeights.x + normal1.rgb * albedo1.a * FrameWeights.y
+                       + normal2.rgb * albedo2.a * FrameWeights.z) * 2.0 - albedo.a;
+    vec3 objectPos = (pos0 * albedo0.a * FrameWeights.x + pos1 * albedo1.a * FrameWeights.y
+                    + pos2 * albedo2.a * FrameWeights.z) / albedo.a;
+
+    // light the reconstructed surface point and write its depth so impostors intersect the scene properly
+    vec3 norm = normalize(NormalMatrix * objectNormal);
+    vec3 surfacePos = vec3(ModelMatrix * vec4(objectPos, 1.0));
+    vec3 viewDir = normalize(viewPos - surfacePos);
+    vec4 clipPos = projection * view * vec4(surfacePos, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+
+#if defined(GBUFFER)
+    gAlbedoSpecular = vec4(albedo.rgb * Tint.rgb, specularStrength);
+    gNormalShininess = vec4(norm, shininess);
+    gPosition = vec4(surfacePos, 1.0);
+#else
+#if defined(LIGHT_DIRECTIONAL)
+    vec3 result = CalcDirLight(dirLight, albedo.rgb, norm, viewDir);
+#elif defined(LIGHT_POINT)
+    vec3 result = CalcPointLight(pointLight, albedo.rgb, norm, surfacePos, viewDir);
+#elif defined(LIGHT_SPOT)
+    vec3 result = CalcSpotLight(spotLight, albedo.rgb, norm, surfacePos, viewDir);
+#elif defined(LIGHT_CLUSTERED)
+    vec3 result = CalcDirLight(dirLight, albedo.rgb, norm, viewDir)
+                + CalcClusteredLights(clusterIndex(gl_FragCoord.xy, gl_FragDepth), albedo.rgb, vec3(specularStrength),
+                                      shininess, norm, surfacePos, viewDir);
+#endif
+
+    FragColor = vec4(result * Tint.rgb, 1.0);
+#if defined(DEBUG_VIEW)
+    // the lighting above still runs, the draw costs what it normally does
+    FragColor = mix(FragColor, vec4(debugColor.rgb, 1.0), debugColor.a);
+#endif
+#endif
+}
+
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+// calculates the color when using a directional light.
+vec3 CalcDirLight(DirLight light, vec3 albedo, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular);
+}
+#endif
+
+#if defined(LIGHT_POINT)
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular) * attenuation;
+}
+#endif
+
+#if defined(LIGHT_SPOT)
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+#endif
\ No newline at end of file
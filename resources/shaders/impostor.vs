@@ -0,0 +1,70 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+// per-instance attributes, same layout as the INSTANCED variant of trash.vs
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in mat3 aInstanceNormal;
+layout (location = 12) in vec4 aInstanceTint;
+
+out vec3 ObjectPos;
+flat out vec3 ObjectViewPos;
+flat out mat4 ModelMatrix;
+flat out mat3 NormalMatrix;
+flat out vec4 Tint;
+// the three atlas frames to blend and their weights
+flat out vec2 Frame0;
+flat out vec2 Frame1;
+flat out vec2 Frame2;
+flat out vec3 FrameWeights;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+uniform float framesPerSide;
+
+vec2 hemiOctEncode(vec3 d)
+{
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    return vec2(d.x + d.z, d.x - d.z);
+}
+
+void main()
+{
+    mat4 invModel = inverse(aInstanceModel);
+    vec3 center = vec3(aInstanceModel * vec4(boundsCenter, 1.0));
+    float radius = boundsRadius * length(aInstanceModel[0].xyz);
+
+    // camera facing quad covering the bounding sphere
+    vec3 cameraRight = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 cameraUp = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 worldPos = center + (cameraRight * aCorner.x + cameraUp * aCorner.y) * radius;
+    ObjectPos = vec3(invModel * vec4(worldPos, 1.0));
+    ObjectViewPos = vec3(invModel * vec4(viewPos, 1.0));
+    ModelMatrix = aInstanceModel;
+    NormalMatrix = aInstanceNormal;
+    Tint = aInstanceTint;
+
+    // view direction in the hemi-octahedral grid, the lower hemisphere was never baked
+    vec3 viewDir = ObjectViewPos - boundsCenter;
+    viewDir.y = max(viewDir.y, 0.0);
+    vec2 grid = (hemiOctEncode(normalize(viewDir + vec3(0.0, 1e-4, 0.0))) * 0.5 + 0.5) * (framesPerSide - 1.0);
+    vec2 cell = min(floor(grid), vec2(framesPerSide - 2.0));
+    vec2 f = grid - cell;
+
+    // split the grid cell into two triangles and blend the corners of the one we are in
+    if (f.x + f.y < 1.0) {
+        Frame0 = cell;
+        Frame1 = cell + vec2(1.0, 0.0);
+        Frame2 = cell + vec2(0.0, 1.0);
+        FrameWeights = vec3(1.0 - f.x - f.y, f.x, f.y);
+    } else {
+        Frame0 = cell + vec2(1.0, 1.0);
+        Frame1 = cell + vec2(1.0, 0.0);
+        Frame2 = cell + vec2(0.0, 1.0);
+        FrameWeights = vec3(f.x + f.y - 1.0, 1.0 - f.y, 1.0 - f.x);
+    }
+
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
\ No newline at end of file
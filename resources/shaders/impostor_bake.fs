@@ -0,0 +1,37 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform Material material;
+// direction from the object towards the bake camera
+uniform vec3 frameDirection;
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+
+void main()
+{
+    vec4 albedo = texture(material.diffuse, TexCoords);
+    if (albedo.a < 0.5)
+        discard;
+
+    // leaves are single sided planes, always store the side facing the camera
+    vec3 normal = normalize(Normal);
+    if (dot(normal, frameDirection) < 0.0)
+        normal = -normal;
+
+    // signed distance from the frame plane through the bounds center, mapped to [0, 1]
+    float depth = dot(FragPos - boundsCenter, frameDirection) / boundsRadius * 0.5 + 0.5;
+
+    Albedo = vec4(albedo.rgb, 1.0);
+    NormalDepth = vec4(normal * 0.5 + 0.5, clamp(depth, 0.0, 1.0));
+}
\ No newline at end of file
@@ -1,7 +1,17 @@
 #version 330 core
+#if defined(GBUFFER)
+// the G-buffer of rg::DeferredRenderer, see deferred_light.fs
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormalShininess;
+layout (location = 2) out vec4 gPosition;
+#else
 out vec4 FragColor;
+#endif
 
 
+// exactly one of LIGHT_DIRECTIONAL, LIGHT_POINT, LIGHT_SPOT, LIGHT_CLUSTERED and GBUFFER is defined
+// by rg::ShaderPermutations, the clustered lights come on top of the directional one
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 struct DirLight {
     vec3 direction;
 
@@ -9,7 +19,7 @@ struct DirLight {
     vec3 diffuse;
     vec3 specular;
 };
-
+#elif defined(LIGHT_POINT)
 struct PointLight {
     vec3 position;
 
@@ -21,7 +31,7 @@ struct PointLight {
     vec3 diffuse;
     vec3 specular;
 };
-
+#elif defined(LIGHT_SPOT)
 struct SpotLight {
     vec3 position;
     vec3 direction;
@@ -36,15 +46,23 @@ struct SpotLight {
     vec3 diffuse;
     vec3 specular;
 };
+#endif
 
 in VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
     DirLight dirLight;
+#elif defined(LIGHT_POINT)
     PointLight pointLight;
+#elif defined(LIGHT_SPOT)
     SpotLight spotLight;
+#endif
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+#if defined(LIGHT_CLUSTERED) || defined(GBUFFER)
+    mat3 TangentToWorld;
+#endif
 } fs_in;
 
 uniform sampler2D diffuse_map;
@@ -53,8 +71,73 @@ uniform sampler2D height_map;
 uniform sampler2D specular_map;
 uniform float shininess;
 uniform float heightScale;
-uniform int flag;
+#if defined(DEBUG_VIEW)
+// colour of rg::DebugViews, alpha is how much of the lit colour it replaces
+uniform vec4 debugColor;
+#endif
+#if defined(LIGHT_CLUSTERED)
+uniform vec3 viewPos;
+#endif
+
+
+#if defined(LIGHT_CLUSTERED)
+// point and spot lights binned into view-space clusters by rg::ClusteredLights: every light is five
+// texels of clusterLights, clusterRanges holds (first index, count) of each cluster's light list
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthSlicing;
+uniform vec2 clusterNearFar;
 
+int clusterIndex(vec2 fragCoord, float depth)
+{
+    float near = clusterNearFar.x;
+    float far = clusterNearFar.y;
+    float viewDepth = 2.0 * near * far / (far + near - (depth * 2.0 - 1.0) * (far - near));
+    int slice = clamp(int(log(viewDepth) * clusterDepthSlicing.x + clusterDepthSlicing.y), 0, clusterDims.z - 1);
+    ivec2 tile = clamp(ivec2(fragCoord / clusterTileSize), ivec2(0), clusterDims.xy - 1);
+    return tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+}
+
+// calculates the color of every point and spot light in the fragment's cluster.
+vec3 CalcClusteredLights(int cluster, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    uvec2 range = texelFetch(clusterRanges, cluster).rg;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int base = int(texelFetch(clusterIndices, int(range.x + i)).r) * 5;
+        vec4 positionRadius = texelFetch(clusterLights, base);
+        vec4 ambientConstant = texelFetch(clusterLights, base + 1);
+        vec4 diffuseLinear = texelFetch(clusterLights, base + 2);
+        vec4 specularQuadratic = texelFetch(clusterLights, base + 3);
+        vec4 cone = texelFetch(clusterLights, base + 4);
+
+        float distance = length(positionRadius.xyz - fragPos);
+        vec3 lightDir = (positionRadius.xyz - fragPos) / distance;
+        // diffuse shading
+        float diff = max(dot(normal, lightDir), 0.0);
+        // specular shading
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(viewDir, halfwayDir), 0.0), shininess);
+        // attenuation, faded out to reach zero at the radius the light was binned with
+        float attenuation = 1.0 / (ambientConstant.w + diffuseLinear.w * distance + specularQuadratic.w * (distance * distance));
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+        // spotlight intensity, cone.xyz is the direction scaled by 1 / (cutOff - outerCutOff),
+        // point lights have no direction and an offset of 1
+        float intensity = clamp(dot(lightDir, -cone.xyz) + cone.w, 0.0, 1.0);
+        // combine results
+        vec3 ambient = ambientConstant.rgb * albedo;
+        vec3 diffuse = diffuseLinear.rgb * diff * albedo;
+        vec3 specular = specularQuadratic.rgb * spec * specularColor;
+        result += (ambient + diffuse + specular) * attenuation * intensity;
+    }
+    return result;
+}
+#endif
 
 vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 {
@@ -62,9 +145,13 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
     return texCoords - viewDir.xy * (height * heightScale);
 }
 
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec2 texCoords);
+#elif defined(LIGHT_POINT)
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec2 texCoords);
+#elif defined(LIGHT_SPOT)
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec2 texCoords);
+#endif
 
 void main()
 {
@@ -78,18 +165,36 @@ void main()
     vec3 normal = texture(normal_map, texCoords).rgb;
     normal = normalize(normal * 2.0 - 1.0);
 
-    vec3 result = vec3(0.0);
-    if (flag == 1){
-        result += CalcDirLight(fs_in.dirLight, normal, viewDir, texCoords);
-    }else if (flag == 2){
-        result += CalcPointLight(fs_in.pointLight, normal, fs_in.TangentFragPos, viewDir, texCoords);
-    }else if (flag == 3){
-        result += CalcSpotLight(fs_in.spotLight, normal, fs_in.TangentFragPos, viewDir, texCoords);
-    }
+#if defined(GBUFFER)
+    // the G-buffer is in world space
+    gAlbedoSpecular = vec4(texture(diffuse_map, texCoords).rgb, texture(specular_map, texCoords).y);
+    gNormalShininess = vec4(normalize(fs_in.TangentToWorld * normal), shininess);
+    gPosition = vec4(fs_in.FragPos, 1.0);
+#else
+#if defined(LIGHT_DIRECTIONAL)
+    vec3 result = CalcDirLight(fs_in.dirLight, normal, viewDir, texCoords);
+#elif defined(LIGHT_POINT)
+    vec3 result = CalcPointLight(fs_in.pointLight, normal, fs_in.TangentFragPos, viewDir, texCoords);
+#elif defined(LIGHT_SPOT)
+    vec3 result = CalcSpotLight(fs_in.spotLight, normal, fs_in.TangentFragPos, viewDir, texCoords);
+#elif defined(LIGHT_CLUSTERED)
+    // the clustered lights are in world space, so is the normal for them
+    vec3 worldNormal = normalize(fs_in.TangentToWorld * normal);
+    vec3 worldViewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 result = CalcDirLight(fs_in.dirLight, normal, viewDir, texCoords)
+                + CalcClusteredLights(clusterIndex(gl_FragCoord.xy, gl_FragCoord.z), texture(diffuse_map, texCoords).rgb,
+                                      texture(specular_map, texCoords).yyy, shininess, worldNormal, fs_in.FragPos, worldViewDir);
+#endif
 
     FragColor = vec4(result, 1.0);
+#if defined(DEBUG_VIEW)
+    // the lighting above still runs, the draw costs what it normally does
+    FragColor = mix(FragColor, vec4(debugColor.rgb, 1.0), debugColor.a);
+#endif
+#endif
 }
 
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec2 texCoords)
 {
     vec3 lightDir = normalize(-light.direction);
@@ -104,7 +209,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec2 texCoords)
     vec3 specular = light.specular * spec * texture(specular_map, texCoords).yyy;
     return (ambient + diffuse + specular);
 }
+#endif
 
+#if defined(LIGHT_POINT)
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec2 texCoords)
 {
     vec3 lightDir = normalize(light.position - fragPos);
@@ -125,7 +232,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     specular *= attenuation;
     return (ambient + diffuse + specular);
 }
+#endif
 
+#if defined(LIGHT_SPOT)
 // calculates the color when using a spot light.
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec2 texCoords)
 {
@@ -150,4 +259,5 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -5,6 +5,9 @@ layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
 
+// exactly one of LIGHT_DIRECTIONAL, LIGHT_POINT, LIGHT_SPOT, LIGHT_CLUSTERED and GBUFFER is defined
+// by rg::ShaderPermutations, the clustered lights come on top of the directional one
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 struct DirLight {
     vec3 direction;
 
@@ -12,7 +15,7 @@ struct DirLight {
     vec3 diffuse;
     vec3 specular;
 };
-
+#elif defined(LIGHT_POINT)
 struct PointLight {
     vec3 position;
 
@@ -24,7 +27,7 @@ struct PointLight {
     vec3 diffuse;
     vec3 specular;
 };
-
+#elif defined(LIGHT_SPOT)
 struct SpotLight {
     vec3 position;
     vec3 direction;
@@ -39,24 +42,36 @@ struct SpotLight {
     vec3 diffuse;
     vec3 specular;
 };
+#endif
 
 out VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
     DirLight dirLight;
+#elif defined(LIGHT_POINT)
     PointLight pointLight;
+#elif defined(LIGHT_SPOT)
     SpotLight spotLight;
+#endif
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+#if defined(LIGHT_CLUSTERED) || defined(GBUFFER)
+    mat3 TangentToWorld;
+#endif
 } vs_out;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
-uniform PointLight pointLight;
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 uniform DirLight dirLight;
-uniform SpotLight spotLight; 
+#elif defined(LIGHT_POINT)
+uniform PointLight pointLight;
+#elif defined(LIGHT_SPOT)
+uniform SpotLight spotLight;
+#endif
 uniform vec3 viewPos;
 
 void main()
@@ -69,12 +84,12 @@ void main()
     vec3 N = normalize(mat3(model) * aNormal);
     mat3 TBN = transpose(mat3(T, B, N));
 
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
     vs_out.dirLight.ambient = dirLight.ambient;
     vs_out.dirLight.diffuse = dirLight.diffuse;
     vs_out.dirLight.specular = dirLight.specular;
     vs_out.dirLight.direction = TBN * dirLight.direction;
-
-    
+#elif defined(LIGHT_POINT)
     vs_out.pointLight.position = TBN * pointLight.position;
     vs_out.pointLight.ambient = pointLight.ambient;
     vs_out.pointLight.diffuse = pointLight.diffuse;
@@ -82,7 +97,7 @@ void main()
     vs_out.pointLight.constant = pointLight.constant;
     vs_out.pointLight.linear = pointLight.linear;
     vs_out.pointLight.quadratic = pointLight.quadratic;
-    
+#elif defined(LIGHT_SPOT)
     vs_out.spotLight.position = TBN * spotLight.position;
     vs_out.spotLight.direction = TBN * spotLight.direction;
     vs_out.spotLight.ambient = spotLight.ambient;
@@ -93,8 +108,11 @@ void main()
     vs_out.spotLight.quadratic = spotLight.quadratic;
     vs_out.spotLight.outerCutOff = spotLight.outerCutOff;
     vs_out.spotLight.cutOff = spotLight.cutOff;
-    
+#endif
 
+#if defined(LIGHT_CLUSTERED) || defined(GBUFFER)
+    vs_out.TangentToWorld = mat3(T, B, N);
+#endif
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
 
@@ -0,0 +1,29 @@
+#version 330 core
+// mesh id + 1 and the texture coordinate footprint, read back by rg::TextureFeedback
+layout (location = 0) out vec2 Feedback;
+
+struct Material {
+    sampler2D diffuse;
+};
+
+in vec2 TexCoords;
+
+// the mesh's first texture, like trash.fs, only for the alpha test
+uniform Material material;
+uniform float meshId;
+// the target is 2^downscaleLog2 times smaller than the frame, its derivatives that much larger
+uniform float downscaleLog2;
+
+void main()
+{
+    // the hardware picks the level from the longer of the two screen-space derivatives, a texture
+    // of size S is sampled at log2(S) + footprint. The derivatives come before the discard, which
+    // would leave them undefined.
+    vec2 dx = dFdx(TexCoords);
+    vec2 dy = dFdy(TexCoords);
+    // cut out leaves and grass do not cover the pixel, so they must not claim it either
+    if (texture(material.diffuse, TexCoords).a < 0.1)
+        discard;
+    float footprint = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-20)) - downscaleLog2;
+    Feedback = vec2(meshId, footprint);
+}
@@ -1,5 +1,15 @@
 #version 330 core
+#if defined(VISIBILITY)
+// draw and triangle id of rg::VisibilityBuffer, see visibility_resolve.fs
+layout (location = 0) out uint VisibilityId;
+#elif defined(GBUFFER)
+// the G-buffer of rg::DeferredRenderer, see deferred_light.fs
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormalShininess;
+layout (location = 2) out vec4 gPosition;
+#else
 out vec4 FragColor;
+#endif
 
 struct Material {
     sampler2D diffuse;
@@ -7,6 +17,9 @@ struct Material {
     float shininess;
 };
 
+// exactly one of LIGHT_DIRECTIONAL, LIGHT_POINT, LIGHT_SPOT, LIGHT_CLUSTERED, GBUFFER and VISIBILITY
+// is defined by rg::ShaderPermutations, the clustered lights come on top of the directional one
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 struct DirLight {
     vec3 direction;
 
@@ -14,7 +27,7 @@ struct DirLight {
     vec3 diffuse;
     vec3 specular;
 };
-
+#elif defined(LIGHT_POINT)
 struct PointLight {
     vec3 position;
 
@@ -26,7 +39,7 @@ struct PointLight {
     vec3 diffuse;
     vec3 specular;
 };
-
+#elif defined(LIGHT_SPOT)
 struct SpotLight {
     vec3 position;
     vec3 direction;
@@ -41,23 +54,98 @@ struct SpotLight {
     vec3 diffuse;
     vec3 specular;
 };
+#endif
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
-
-uniform int flag;
+in vec4 Tint;
 
 uniform vec3 viewPos;
+#if defined(DEBUG_VIEW)
+// colour of rg::DebugViews, alpha is how much of the lit colour it replaces
+uniform vec4 debugColor;
+#endif
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 uniform DirLight dirLight;
+#elif defined(LIGHT_POINT)
 uniform PointLight pointLight;
+#elif defined(LIGHT_SPOT)
 uniform SpotLight spotLight;
+#endif
 uniform Material material;
+#if defined(VISIBILITY)
+// index of the draw + 1, 0 marks pixels nothing was drawn to
+uniform int drawId;
+#endif
 
 // function prototypes
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+#elif defined(LIGHT_POINT)
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#elif defined(LIGHT_SPOT)
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+
+#if defined(LIGHT_CLUSTERED)
+// point and spot lights binned into view-space clusters by rg::ClusteredLights: every light is five
+// texels of clusterLights, clusterRanges holds (first index, count) of each cluster's light list
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthSlicing;
+uniform vec2 clusterNearFar;
+
+int clusterIndex(vec2 fragCoord, float depth)
+{
+    float near = clusterNearFar.x;
+    float far = clusterNearFar.y;
+    float viewDepth = 2.0 * near * far / (far + near - (depth * 2.0 - 1.0) * (far - near));
+    int slice = clamp(int(log(viewDepth) * clusterDepthSlicing.x + clusterDepthSlicing.y), 0, clusterDims.z - 1);
+    ivec2 tile = clamp(ivec2(fragCoord / clusterTileSize), ivec2(0), clusterDims.xy - 1);
+    return tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+}
+
+// calculates the color of every point and spot light in the fragment's cluster.
+vec3 CalcClusteredLights(int cluster, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    uvec2 range = texelFetch(clusterRanges, cluster).rg;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int base = int(texelFetch(clusterIndices, int(range.x + i)).r) * 5;
+        vec4 positionRadius = texelFetch(clusterLights, base);
+        vec4 ambientConstant = texelFetch(clusterLights, base + 1);
+        vec4 diffuseLinear = texelFetch(clusterLights, base + 2);
+        vec4 specularQuadratic = texelFetch(clusterLights, base + 3);
+        vec4 cone = texelFetch(clusterLights, base + 4);
+
+        float distance = length(positionRadius.xyz - fragPos);
+        vec3 lightDir = (positionRadius.xyz - fragPos) / distance;
+        // diffuse shading
+        float diff = max(dot(normal, lightDir), 0.0);
+        // specular shading
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(viewDir, halfwayDir), 0.0), shininess);
+        // attenuation, faded out to reach zero at the radius the light was binned with
+        float attenuation = 1.0 / (ambientConstant.w + diffuseLinear.w * distance + specularQuadratic.w * (distance * distance));
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+        // spotlight intensity, cone.xyz is the direction scaled by 1 / (cutOff - outerCutOff),
+        // point lights have no direction and an offset of 1
+        float intensity = clamp(dot(lightDir, -cone.xyz) + cone.w, 0.0, 1.0);
+        // combine results
+        vec3 ambient = ambientConstant.rgb * albedo;
+        vec3 diffuse = diffuseLinear.rgb * diff * albedo;
+        vec3 specular = specularQuadratic.rgb * spec * specularColor;
+        result += (ambient + diffuse + specular) * attenuation * intensity;
+    }
+    return result;
+}
+#endif
 
 void main()
 {
@@ -71,18 +159,36 @@ void main()
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
 
-    vec3 result = vec3(0.0);
-    if (flag == 1){
-    result += CalcDirLight(dirLight, norm, viewDir);
-    }else if (flag == 2){
-    result += CalcPointLight(pointLight, norm, FragPos, viewDir);
-    }else{
-    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
-    }
+#if defined(VISIBILITY)
+    // has to match VisibilityBuffer::TRIANGLE_BITS
+    VisibilityId = uint(drawId) << 20 | uint(gl_PrimitiveID);
+#elif defined(GBUFFER)
+    gAlbedoSpecular = vec4(texture(material.diffuse, TexCoords).rgb * Tint.rgb,
+                           dot(texture(material.specular, TexCoords).rgb, vec3(1.0 / 3.0)));
+    gNormalShininess = vec4(norm, material.shininess);
+    gPosition = vec4(FragPos, 1.0);
+#else
+#if defined(LIGHT_DIRECTIONAL)
+    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+#elif defined(LIGHT_POINT)
+    vec3 result = CalcPointLight(pointLight, norm, FragPos, viewDir);
+#elif defined(LIGHT_SPOT)
+    vec3 result = CalcSpotLight(spotLight, norm, FragPos, viewDir);
+#elif defined(LIGHT_CLUSTERED)
+    vec3 result = CalcDirLight(dirLight, norm, viewDir)
+                + CalcClusteredLights(clusterIndex(gl_FragCoord.xy, gl_FragCoord.z), vec3(texture(material.diffuse, TexCoords)),
+                                      vec3(texture(material.specular, TexCoords)), material.shininess, norm, FragPos, viewDir);
+#endif
 
-    FragColor = vec4(result, 1.0);
+    FragColor = vec4(result * Tint.rgb, 1.0);
+#if defined(DEBUG_VIEW)
+    // the lighting above still runs, the draw costs what it normally does
+    FragColor = mix(FragColor, vec4(debugColor.rgb, 1.0), debugColor.a);
+#endif
+#endif
 }
 
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
@@ -98,7 +204,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
     return (ambient + diffuse + specular);
 }
+#endif
 
+#if defined(LIGHT_POINT)
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -120,7 +228,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     specular *= attenuation;
     return (ambient + diffuse + specular);
 }
+#endif
 
+#if defined(LIGHT_SPOT)
 // calculates the color when using a spot light.
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -145,4 +255,5 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
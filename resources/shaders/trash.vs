@@ -2,19 +2,40 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef INSTANCED
+// per-instance attributes
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in mat3 aInstanceNormal;
+layout (location = 12) in vec4 aInstanceTint;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out vec4 Tint;
 
+#if defined(OBJECT_UBO) && !defined(INSTANCED)
+// one object of a uniform buffer of all objects, bound as a range per draw (tools/submit_bench.cpp)
+layout (std140) uniform ObjectConstants {
+    mat4 model;
+};
+#elif !defined(INSTANCED)
 uniform mat4 model;
+#endif
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
+#ifdef INSTANCED
+    FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    Normal = aInstanceNormal * aNormal;
+    Tint = aInstanceTint;
+#else
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
+    Tint = vec4(1.0);
+#endif
     TexCoords = aTexCoords;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
@@ -0,0 +1,286 @@
+#version 330 core
+out vec4 FragColor;
+
+// exactly one of LIGHT_DIRECTIONAL, LIGHT_POINT, LIGHT_SPOT and LIGHT_CLUSTERED is defined by
+// rg::ShaderPermutations, the clustered lights come on top of the directional one
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+#elif defined(LIGHT_POINT)
+struct PointLight {
+    vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+#elif defined(LIGHT_SPOT)
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+#endif
+
+// written by the VISIBILITY permutation of trash.fs: draw + 1 above bit 20, the triangle below
+uniform usampler2D visibility;
+// filled by rg::VisibilityBuffer: two texels per vertex, (position, u) and (normal, v)
+uniform samplerBuffer vertexData;
+uniform usamplerBuffer indexData;
+// eight texels per draw: model matrix, normal matrix with the shininess in the first w, tint
+uniform samplerBuffer drawData;
+// (first element, texture layer + 1) per draw
+uniform usamplerBuffer drawInfo;
+uniform sampler2DArray diffuseLayers;
+
+uniform mat4 viewProjection;
+uniform mat4 inverseViewProjection;
+uniform vec2 screenSize;
+uniform vec3 viewPos;
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+uniform DirLight dirLight;
+#elif defined(LIGHT_POINT)
+uniform PointLight pointLight;
+#elif defined(LIGHT_SPOT)
+uniform SpotLight spotLight;
+#endif
+
+// function prototypes
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+vec3 CalcDirLight(DirLight light, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 viewDir);
+#elif defined(LIGHT_POINT)
+vec3 CalcPointLight(PointLight light, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir);
+#elif defined(LIGHT_SPOT)
+vec3 CalcSpotLight(SpotLight light, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+
+#if defined(LIGHT_CLUSTERED)
+// point and spot lights binned into view-space clusters by rg::ClusteredLights: every light is five
+// texels of clusterLights, clusterRanges holds (first index, count) of each cluster's light list
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthSlicing;
+uniform vec2 clusterNearFar;
+
+int clusterIndex(vec2 fragCoord, float depth)
+{
+    float near = clusterNearFar.x;
+    float far = clusterNearFar.y;
+    float viewDepth = 2.0 * near * far / (far + near - (depth * 2.0 - 1.0) * (far - near));
+    int slice = clamp(int(log(viewDepth) * clusterDepthSlicing.x + clusterDepthSlicing.y), 0, clusterDims.z - 1);
+    ivec2 tile = clamp(ivec2(fragCoord / clusterTileSize), ivec2(0), clusterDims.xy - 1);
+    return tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+}
+
+// calculates the color of every point and spot light in the fragment's cluster.
+vec3 CalcClusteredLights(int cluster, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    uvec2 range = texelFetch(clusterRanges, cluster).rg;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int base = int(texelFetch(clusterIndices, int(range.x + i)).r) * 5;
+        vec4 positionRadius = texelFetch(clusterLights, base);
+        vec4 ambientConstant = texelFetch(clusterLights, base + 1);
+        vec4 diffuseLinear = texelFetch(clusterLights, base + 2);
+        vec4 specularQuadratic = texelFetch(clusterLights, base + 3);
+        vec4 cone = texelFetch(clusterLights, base + 4);
+
+        float distance = length(positionRadius.xyz - fragPos);
+        vec3 lightDir = (positionRadius.xyz - fragPos) / distance;
+        // diffuse shading
+        float diff = max(dot(normal, lightDir), 0.0);
+        // specular shading
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(viewDir, halfwayDir), 0.0), shininess);
+        // attenuation, faded out to reach zero at the radius the light was binned with
+        float attenuation = 1.0 / (ambientConstant.w + diffuseLinear.w * distance + specularQuadratic.w * (distance * distance));
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+        // spotlight intensity, cone.xyz is the direction scaled by 1 / (cutOff - outerCutOff),
+        // point lights have no direction and an offset of 1
+        float intensity = clamp(dot(lightDir, -cone.xyz) + cone.w, 0.0, 1.0);
+        // combine results
+        vec3 ambient = ambientConstant.rgb * albedo;
+        vec3 diffuse = diffuseLinear.rgb * diff * albedo;
+        vec3 specular = specularQuadratic.rgb * spec * specularColor;
+        result += (ambient + diffuse + specular) * attenuation * intensity;
+    }
+    return result;
+}
+#endif
+
+// world-space direction of the view ray through a window position
+vec3 rayDirection(vec2 fragCoord)
+{
+    vec4 farPoint = inverseViewProjection * vec4(fragCoord / screenSize * 2.0 - 1.0, 1.0, 1.0);
+    return normalize(farPoint.xyz / farPoint.w - viewPos);
+}
+
+// barycentrics of where the ray hits the triangle's plane (Moeller-Trumbore)
+vec3 barycentrics(vec3 p0, vec3 p1, vec3 p2, vec3 direction)
+{
+    vec3 edge1 = p1 - p0;
+    vec3 edge2 = p2 - p0;
+    vec3 pvec = cross(direction, edge2);
+    float invDet = 1.0 / dot(edge1, pvec);
+    vec3 tvec = viewPos - p0;
+    float u = dot(tvec, pvec) * invDet;
+    float v = dot(direction, cross(tvec, edge1)) * invDet;
+    return vec3(1.0 - u - v, u, v);
+}
+
+void main()
+{
+    uint id = texelFetch(visibility, ivec2(gl_FragCoord.xy), 0).r;
+    if (id == 0u)
+        discard;
+    int draw = int(id >> 20) - 1;
+    int triangle = int(id & 0xFFFFFu);
+
+    // the triangle's vertices
+    uvec2 info = texelFetch(drawInfo, draw).rg;
+    int element = int(info.x) + triangle * 3;
+    int base = draw * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                      texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    vec4 normal0 = texelFetch(drawData, base + 4);
+    mat3 normalMatrix = mat3(normal0.xyz, texelFetch(drawData, base + 5).xyz, texelFetch(drawData, base + 6).xyz);
+    float shininess = normal0.w;
+    vec4 tint = texelFetch(drawData, base + 7);
+
+    vec3 positions[3];
+    vec3 normals[3];
+    vec2 uvs[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int vertex = int(texelFetch(indexData, element + i).r) * 2;
+        vec4 positionU = texelFetch(vertexData, vertex);
+        vec4 normalV = texelFetch(vertexData, vertex + 1);
+        positions[i] = vec3(model * vec4(positionU.xyz, 1.0));
+        normals[i] = normalV.xyz;
+        uvs[i] = vec2(positionU.w, normalV.w);
+    }
+
+    // interpolate at this pixel, the neighbouring pixels' rays give the texture coordinate gradients
+    vec3 b = barycentrics(positions[0], positions[1], positions[2], rayDirection(gl_FragCoord.xy));
+    vec3 bx = barycentrics(positions[0], positions[1], positions[2], rayDirection(gl_FragCoord.xy + vec2(1.0, 0.0)));
+    vec3 by = barycentrics(positions[0], positions[1], positions[2], rayDirection(gl_FragCoord.xy + vec2(0.0, 1.0)));
+    mat3x2 uv = mat3x2(uvs[0], uvs[1], uvs[2]);
+    vec2 texCoords = uv * b;
+    vec3 fragPos = mat3(positions[0], positions[1], positions[2]) * b;
+    vec3 norm = normalize(normalMatrix * (mat3(normals[0], normals[1], normals[2]) * b));
+
+    // the forward shaders read material.specular from the same texture as material.diffuse
+    vec3 albedo = vec3(1.0);
+    if (info.y > 0u)
+        albedo = textureGrad(diffuseLayers, vec3(texCoords, float(info.y - 1u)), uv * bx - texCoords, uv * by - texCoords).rgb;
+    vec3 specularColor = albedo;
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+#if defined(LIGHT_DIRECTIONAL)
+    vec3 result = CalcDirLight(dirLight, albedo, specularColor, shininess, norm, viewDir);
+#elif defined(LIGHT_POINT)
+    vec3 result = CalcPointLight(pointLight, albedo, specularColor, shininess, norm, fragPos, viewDir);
+#elif defined(LIGHT_SPOT)
+    vec3 result = CalcSpotLight(spotLight, albedo, specularColor, shininess, norm, fragPos, viewDir);
+#elif defined(LIGHT_CLUSTERED)
+    vec4 clipPos = viewProjection * vec4(fragPos, 1.0);
+    vec3 result = CalcDirLight(dirLight, albedo, specularColor, shininess, norm, viewDir)
+                + CalcClusteredLights(clusterIndex(gl_FragCoord.xy, clipPos.z / clipPos.w * 0.5 + 0.5), albedo,
+                                      specularColor, shininess, norm, fragPos, viewDir);
+#endif
+
+    FragColor = vec4(result * tint.rgb, 1.0);
+}
+
+#if defined(LIGHT_DIRECTIONAL) || defined(LIGHT_CLUSTERED)
+// calculates the color when using a directional light.
+vec3 CalcDirLight(DirLight light, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(viewDir, halfwayDir), 0.0), shininess);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular);
+}
+#endif
+
+#if defined(LIGHT_POINT)
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(viewDir, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+#endif
+
+#if defined(LIGHT_SPOT)
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, vec3 albedo, vec3 specularColor, float shininess, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(viewDir, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
+#endif
\ No newline at end of file
@@ -13,8 +13,32 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <rg/Benchmark.h>
+#include <rg/CameraPath.h>
+#include <rg/ClusteredLights.h>
+#include <rg/DebugViews.h>
+#include <rg/DeferredRenderer.h>
+#include <rg/FlightRecorder.h>
+#include <rg/GlCommandStats.h>
+#include <rg/GlDebug.h>
+#include <rg/GpuProfiler.h>
+#include <rg/HeadlessContext.h>
+#include <rg/Impostor.h>
+#include <rg/InputRecording.h>
+#include <rg/MemoryStats.h>
+#include <rg/PerfHud.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderPermutations.h>
+#include <rg/SyntheticScene.h>
+#include <rg/TextureBudget.h>
+#include <rg/TextureFeedback.h>
+#include <rg/Trace.h>
+#include <rg/VisibilityBuffer.h>
+
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -32,6 +56,19 @@ unsigned int loadTexture(const char *path);
 
 void renderPlank(unsigned int plankVAO, unsigned int plankVBO);
 
+void setLightUniforms(Shader &shader, rg::LightMode light);
+
+bool drawAsImpostor(const Model &model, const glm::mat4 &transform);
+
+void buildSceneLights(std::vector<rg::ClusterLight> &lights, rg::LightMode mode);
+
+void drawOpaque(Model &model, Shader &shader, const glm::mat4 &transform, float shininess = 32.0f,
+                bool culled = false, const rg::LodLevels &lods = rg::LodLevels());
+
+void advancePlayback();
+
+bool cullModel(const Model &model, const glm::mat4 &transform);
+
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -47,6 +84,26 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// where the camera gets its state from every frame: F2 starts and stops recording the input,
+// F3 replays the recording and F4 flies along the camera path, both with a fixed timestep
+enum CameraControl {
+    CAMERA_CONTROL_INPUT,
+    CAMERA_CONTROL_REPLAY,
+    CAMERA_CONTROL_FLYTHROUGH,
+};
+int cameraControl = CAMERA_CONTROL_INPUT;
+bool recordingInput = false;
+rg::InputRecording inputRecording;
+rg::CameraPath flythrough;
+unsigned int playbackFrame = 0;
+// input of the frame in progress, the mouse callbacks add to it between frames
+rg::InputFrame frameInput;
+const char *INPUT_RECORDING_PATH = "input_recording.txt";
+// F5 writes the last zones of the CPU profiler here
+const char *CPU_PROFILE_PATH = "cpu_profile.json";
+// the texture mip feedback report of the Memory window, load it with --texture-budget
+const char *TEXTURE_MIPS_PATH = "texture_mips.txt";
+
 struct DirLight {
     glm::vec3 direction;
     glm::vec3 ambient;
@@ -80,6 +137,24 @@ struct SpotLight {
     glm::vec3 specular;
 }spotLight;
 
+// every point and spot light of the clustered light mode, bound to texture units 8 - 10
+rg::ClusteredLights clusteredLights;
+const unsigned int CLUSTER_TEXTURE_UNIT = 8;
+// G-buffer and light volumes of the deferred path
+rg::DeferredRenderer deferredRenderer;
+// draw/triangle ids and shared geometry of the visibility buffer path
+rg::VisibilityBuffer visibilityBuffer;
+
+// camera frustum of the current frame, models outside of it are skipped while culling is enabled
+rg::Frustum viewFrustum;
+
+// how the opaque models are rendered, picked in the ImGui window
+enum RenderPath {
+    RENDER_PATH_FORWARD,
+    RENDER_PATH_DEFERRED,
+    RENDER_PATH_VISIBILITY,
+};
+
 
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
@@ -89,6 +164,18 @@ struct ProgramState {
     glm::vec3 backpackPosition = glm::vec3(0.0f);
     float backpackScale = 1.0f;
     PointLight pointLight;
+    bool LodEnabled = true;
+    float LodBias = 0.0f;
+    bool ImpostorsEnabled = true;
+    float ImpostorDistance = 8.0f;
+    int StreetLightCount = 24;
+    int SmallLightCount = 256;
+    int RenderPath = RENDER_PATH_FORWARD;
+    bool StencilLightVolumes = true;
+    // optimizations that can be switched off in the performance window to compare against
+    bool CullingEnabled = true;
+    bool InstancingEnabled = true;
+    bool BatchingEnabled = true;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -129,63 +216,114 @@ void ProgramState::LoadFromFile(std::string filename) {
 
 ProgramState *programState;
 
-// flag for shaders to use to determine which light to use
-int flag = 1;
+// light the scene is lit by, picks the shader permutations used for the frame
+rg::LightMode lightMode = rg::LightMode::Directional;
+// --scene adds the generated objects and street lights to the shipped scene
+rg::SyntheticSceneSettings sceneSettings;
+rg::SyntheticScene syntheticScene;
 bool flag1 = true;
 bool flag2 = false;
 bool flag3 = false;
+bool flag4 = false;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+int main(int argc, char **argv) {
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    // everything up to the render loop, written to startup_trace.json
+    rg::TraceScope startupScope("startup");
+    // --headless renders a fixed camera path offscreen and writes a JSON report, see rg::Benchmark
+    rg::BenchmarkSettings benchmarkSettings;
+    if (!rg::parseBenchmarkArgs(argc, argv, benchmarkSettings))
+        return -1;
+    // textures are loaded no larger than a previous --texture-feedback run saw them on screen
+    if (!benchmarkSettings.textureBudgetPath.empty())
+        rg::textureBudget().Load(benchmarkSettings.textureBudgetPath);
+    if (!benchmarkSettings.sceneSpec.empty() && !rg::parseSyntheticScene(benchmarkSettings.sceneSpec, sceneSettings))
+        return -1;
+    sceneSettings.enabled = !benchmarkSettings.sceneSpec.empty() || !benchmarkSettings.sceneSweepPath.empty();
+    bool headless = benchmarkSettings.headless;
+    GLFWwindow *window = NULL;
+    rg::HeadlessContext headlessContext;
+
+    if (headless) {
+        // no window and no display, just a context rendering into an offscreen framebuffer
+        rg::TraceScope contextTrace("create EGL context");
+        if (!headlessContext.Create())
+            return -1;
+        if (!gladLoadGLLoader((GLADloadproc) rg::HeadlessContext::GetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+    } else {
+        // glfw: initialize and configure
+        rg::TraceScope initTrace("glfwInit");
+        glfwInit();
+        initTrace.End();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if RG_GL_DEBUG_LAYER
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#elif defined(GLFW_CONTEXT_NO_ERROR)
+        // GL errors are undefined behaviour from here on, the driver skips its error checks
+        glfwWindowHint(GLFW_CONTEXT_NO_ERROR, GL_TRUE);
+#endif
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw window creation
+        rg::TraceScope windowTrace("create window");
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        windowTrace.End();
+
+        // glad: load all OpenGL function pointers
+        rg::TraceScope gladTrace("load GL functions");
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
+#if RG_GL_DEBUG_LAYER
+    rg::glDebugLayer().Enable();
+#endif
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(false);
 
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
-    if (programState->ImGuiEnabled) {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-    }
+    // the benchmark always starts from the defaults so runs stay comparable
+    if (!headless) {
+        programState->LoadFromFile("resources/program_state.txt");
+        if (programState->ImGuiEnabled) {
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        }
 
-    // Init ImGui
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO &io = ImGui::GetIO();
-    (void) io;
+        // Init ImGui
+        rg::TraceScope imguiTrace("init ImGui");
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO &io = ImGui::GetIO();
+        (void) io;
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330 core");
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+    }
 
     // configure global opengl state
     glEnable(GL_DEPTH_TEST);
@@ -195,10 +333,48 @@ int main() {
 
     // build and compile shaders
     // Plastic water bottle has its own shader cause of the blending
-    Shader pbShader("resources/shaders/bottle.vs", "resources/shaders/bottle.fs");
-    Shader trashShader("resources/shaders/trash.vs", "resources/shaders/trash.fs");
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-    Shader plankShader("resources/shaders/plank.vs", "resources/shaders/plank.fs");
+    // lit shaders are compiled once per light type, see rg::ShaderPermutations. Everything is
+    // submitted to one batch so the driver can compile the programs concurrently.
+    rg::TraceScope shaderTrace("compile shaders");
+    ShaderBatch shaderBatch;
+    rg::ShaderPermutations pbVariants("resources/shaders/bottle.vs", "resources/shaders/bottle.fs");
+    rg::ShaderPermutations trashVariants("resources/shaders/trash.vs", "resources/shaders/trash.fs");
+    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs", {}, nullptr, &shaderBatch);
+    rg::ShaderPermutations plankVariants("resources/shaders/plank.vs", "resources/shaders/plank.fs");
+    Shader impostorBakeShader("resources/shaders/impostor_bake.vs", "resources/shaders/impostor_bake.fs", {}, nullptr, &shaderBatch);
+    rg::ShaderPermutations impostorVariants("resources/shaders/impostor.vs", "resources/shaders/impostor.fs");
+    pbVariants.prepare(rg::SHADER_FEATURE_INSTANCED, &shaderBatch);
+    pbVariants.prepare(rg::SHADER_FEATURE_NONE, &shaderBatch);
+    trashVariants.prepare(rg::SHADER_FEATURE_NONE, &shaderBatch);
+    plankVariants.prepare(rg::SHADER_FEATURE_NONE, &shaderBatch);
+    impostorVariants.prepare(rg::SHADER_FEATURE_NONE, &shaderBatch);
+    // the deferred path: G-buffer variants of the opaque shaders and the two lighting passes
+    trashVariants.prepare(rg::SHADER_FEATURE_GBUFFER, &shaderBatch);
+    plankVariants.prepare(rg::SHADER_FEATURE_GBUFFER, &shaderBatch);
+    impostorVariants.prepare(rg::SHADER_FEATURE_GBUFFER, &shaderBatch);
+    Shader deferredDirectionalShader("resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs",
+                                     {"DIRECTIONAL"}, nullptr, &shaderBatch);
+    Shader deferredVolumeShader("resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs",
+                                {}, nullptr, &shaderBatch);
+    // the visibility buffer path: id variant of the trash shader and the per light mode resolve
+    trashVariants.prepare(rg::SHADER_FEATURE_VISIBILITY, &shaderBatch);
+    rg::ShaderPermutations resolveVariants("resources/shaders/visibility_resolve.vs", "resources/shaders/visibility_resolve.fs");
+    resolveVariants.prepare(rg::SHADER_FEATURE_NONE, &shaderBatch);
+    // rg::DebugViews: the debug colour variants of the forward shaders, the heatmap and the bounds
+    pbVariants.prepare(rg::SHADER_FEATURE_INSTANCED | rg::SHADER_FEATURE_DEBUG_VIEW, &shaderBatch);
+    pbVariants.prepare(rg::SHADER_FEATURE_DEBUG_VIEW, &shaderBatch);
+    trashVariants.prepare(rg::SHADER_FEATURE_DEBUG_VIEW, &shaderBatch);
+    plankVariants.prepare(rg::SHADER_FEATURE_DEBUG_VIEW, &shaderBatch);
+    impostorVariants.prepare(rg::SHADER_FEATURE_DEBUG_VIEW, &shaderBatch);
+    Shader debugOverdrawShader("resources/shaders/debug_overdraw.vs", "resources/shaders/debug_overdraw.fs",
+                               {}, nullptr, &shaderBatch);
+    Shader debugBoundsShader("resources/shaders/debug_bounds.vs", "resources/shaders/debug_bounds.fs",
+                             {}, nullptr, &shaderBatch);
+    Shader textureFeedbackShader("resources/shaders/texture_feedback.vs", "resources/shaders/texture_feedback.fs",
+                                 {}, nullptr, &shaderBatch);
+    shaderBatch.finish();
+    rg::programCache().report();
+    shaderTrace.End();
 
 
     // Skybox
@@ -257,11 +433,13 @@ int main() {
     unsigned int plankVBO = 0;
 
 
-    plankShader.use();
-    plankShader.setInt("diffuse_map", 0);
-    plankShader.setInt("normal_map", 1);
-    plankShader.setInt("height_map", 2);
-    plankShader.setInt("specular_map", 3);
+    plankVariants.forEachVariant([](Shader &plankShader) {
+        plankShader.use();
+        plankShader.setInt("diffuse_map", 0);
+        plankShader.setInt("normal_map", 1);
+        plankShader.setInt("height_map", 2);
+        plankShader.setInt("specular_map", 3);
+    });
     
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
@@ -287,9 +465,10 @@ int main() {
     // load models
     Model dustyRoad("resources/objects/dusty_road/scene.gltf");
     dustyRoad.SetShaderTextureNamePrefix("material.");
-    Model dumpster("resources/objects/dumpster/scene.gltf");
+    // the dense models get simplified levels of detail on import
+    Model dumpster("resources/objects/dumpster/scene.gltf", false, 4);
     dumpster.SetShaderTextureNamePrefix("material.");
-    Model tree("resources/objects/oak/Oak.obj");
+    Model tree("resources/objects/oak/Oak.obj", false, 4);
     tree.SetShaderTextureNamePrefix("material.");
     Model trashBag("resources/objects/trash_bag/scene.gltf");
     trashBag.SetShaderTextureNamePrefix("material.");
@@ -306,6 +485,35 @@ int main() {
     Model oldCan("resources/objects/old_coca_cola_can/scene.gltf");
     oldCan.SetShaderTextureNamePrefix("material.");
 
+    // far away trees and dumpsters are replaced by a single textured quad each
+    rg::Impostor treeImpostor;
+    treeImpostor.Bake(tree, impostorBakeShader);
+    rg::Impostor dumpsterImpostor;
+    dumpsterImpostor.Bake(dumpster, impostorBakeShader);
+    vector<InstanceData> treeImpostors;
+    vector<InstanceData> dumpsterImpostors;
+    // the levels of detail of the hand placed dumpster and tree, kept between frames for the hysteresis
+    rg::LodLevels dumpsterLods;
+    rg::LodLevels treeLods;
+
+    // the bottles never move, so their instance data is built once
+    vector<InstanceData> handPlacedBottles;
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.25, 0.01, 0.0));
+        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0, 1.0, 0.0));
+        model = glm::scale(model, glm::vec3(0.01));
+        handPlacedBottles.push_back(makeInstance(model));
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.4, 0.02, -0.5));
+        model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0, 1.0, 0.0));
+        model = glm::scale(model, glm::vec3(0.01));
+        handPlacedBottles.push_back(makeInstance(model));
+    }
+    // per texture set of the synthetic scene, the hand placed bottles are drawn with the first one
+    vector<vector<InstanceData>> bottleInstances(1, handPlacedBottles);
+
     // Initializing light's components
     pointLight.position = glm::vec3(-0.59, 2.0, -1.1);
     pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
@@ -337,17 +545,133 @@ int main() {
 
     programState->camera.Position = glm::vec3(1.0f);
 
+    // the models of rg::SyntheticScene per texture set: the first set are the models loaded above,
+    // every further set loads the files once more, so each copy has textures of its own
+    struct SceneModelFile {
+        const char *path;
+        unsigned int lodLevels;
+    };
+    const SceneModelFile sceneModelFiles[rg::SCENE_ASSET_COUNT] = {
+            {"resources/objects/old_coca_cola_can/scene.gltf", 1},
+            {"resources/objects/plastic_water_bottle/scene.gltf", 1},
+            {"resources/objects/oil_barrel/scene.gltf", 1},
+            {"resources/objects/trash_bag/scene.gltf", 1},
+            {"resources/objects/oak/Oak.obj", 4},
+            {"resources/objects/rusty_streetlight/Light Pole.obj", 1},
+    };
+    vector<Model *> sceneModels[rg::SCENE_ASSET_COUNT] = {{&oldCan}, {&plasticBottle}, {&oilBarrel}, {&trashBag},
+                                                          {&tree}, {&streetLight}};
+    vector<std::unique_ptr<Model>> sceneModelCopies;
+    // where the road tile of the shipped scene lies, the generated tiles line up with it
+    glm::mat4 roadTransform = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
+    roadTransform = glm::scale(roadTransform, glm::vec3(0.0025));
+    auto generateScene = [&](const rg::SyntheticSceneSettings &settings) {
+        rg::TraceScope trace("generate synthetic scene");
+        for (unsigned int asset = 0; asset < rg::SCENE_ASSET_COUNT; asset++) {
+            while (sceneModels[asset].size() < settings.textureSets) {
+                sceneModelCopies.emplace_back(new Model(sceneModelFiles[asset].path, false,
+                                                        sceneModelFiles[asset].lodLevels));
+                // the bottle shader names its samplers without the prefix
+                if (asset != rg::SCENE_ASSET_BOTTLE)
+                    sceneModelCopies.back()->SetShaderTextureNamePrefix("material.");
+                sceneModels[asset].push_back(sceneModelCopies.back().get());
+            }
+        }
+        syntheticScene.Generate(settings, roadTransform, dustyRoad.boundsMinimum, dustyRoad.boundsMaximum);
+        bottleInstances.assign(settings.textureSets, vector<InstanceData>());
+        bottleInstances[0] = handPlacedBottles;
+        for (const rg::SceneObject &object : syntheticScene.objects[rg::SCENE_ASSET_BOTTLE])
+            bottleInstances[object.textureSet].push_back(makeInstance(object.transform));
+    };
+    // the textures of the placed models in use, for the sweep report
+    auto sceneTextureCount = [&]() {
+        size_t textures = 0;
+        for (unsigned int asset = 0; asset < rg::SCENE_ASSET_COUNT; asset++) {
+            for (unsigned int set = 0; set < sceneSettings.textureSets && set < sceneModels[asset].size(); set++)
+                textures += sceneModels[asset][set]->textures_loaded.size();
+        }
+        return textures;
+    };
+    if (sceneSettings.enabled)
+        generateScene(sceneSettings);
+
+
+    rg::Benchmark benchmark(benchmarkSettings);
+    rg::OffscreenTarget offscreenTarget;
+    if (headless) {
+        if (!benchmark.Load() || !offscreenTarget.Create(benchmarkSettings.width, benchmarkSettings.height))
+            return -1;
+        deferredRenderer.outputFramebuffer = offscreenTarget.framebuffer;
+        visibilityBuffer.outputFramebuffer = offscreenTarget.framebuffer;
+        rg::debugViews().outputFramebuffer = offscreenTarget.framebuffer;
+        rg::textureFeedback().outputFramebuffer = offscreenTarget.framebuffer;
+        rg::textureFeedback().enabled = !benchmarkSettings.textureFeedbackPath.empty();
+        // the report needs the GPU timings of every measured frame
+        rg::gpuProfiler().historyFrames = benchmarkSettings.warmupFrames + benchmarkSettings.measuredFrames;
+        rg::gpuProfiler().waitForResults = true;
+        // the runs are reproducible already, no hitch dumps in the middle of a measurement
+        rg::flightRecorder().enabled = false;
+    }
+    // --scene-sweep: every step changes the synthetic scene or the render path and runs the camera
+    // path again, the street lights only light the scene as clustered lights
+    rg::SceneSweep sceneSweep;
+    rg::SyntheticSceneSettings sweepBase = sceneSettings;
+    auto applySweepStep = [&]() {
+        programState->RenderPath = sceneSweep.Step().renderPath;
+        sceneSettings = sceneSweep.Settings(sweepBase);
+        generateScene(sceneSettings);
+    };
+    if (!benchmarkSettings.sceneSweepPath.empty()) {
+        lightMode = rg::LightMode::Clustered;
+        programState->SmallLightCount = 0;
+        sceneSweep.Plan(sweepBase, {"forward", "deferred", "visibility"});
+        applySweepStep();
+    }
+    if (!headless) {
+        flythrough.Load(benchmarkSettings.cameraPath);
+        // --replay starts the window with the recording playing
+        if (!benchmarkSettings.replayPath.empty() && inputRecording.Load(benchmarkSettings.replayPath))
+            cameraControl = CAMERA_CONTROL_REPLAY;
+    }
+    std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - loadStart;
+    std::cout << "Loaded in " << loadTime.count() << " ms" << std::endl;
+    startupScope.End();
+    rg::startupTrace().WriteChromeTrace("startup_trace.json");
+    rg::startupTrace().Stop();
 
     // render loop
-    while (!glfwWindowShouldClose(window)) {
-
-        // per-frame time logic
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        processInput(window);
+    while (headless ? benchmark.Running() : !glfwWindowShouldClose(window)) {
+        RG_PROFILE_ZONE("frame");
+
+        if (headless) {
+            // fixed timestep and camera path instead of the clock and the input
+            deltaTime = rg::FIXED_TIMESTEP;
+            benchmark.BeginFrame(programState->camera);
+            offscreenTarget.Bind();
+        } else {
+            // per-frame time logic
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            if (cameraControl == CAMERA_CONTROL_INPUT) {
+                // input
+                processInput(window);
+                if (recordingInput)
+                    inputRecording.Record(frameInput, programState->camera);
+            } else {
+                // playback ignores the clock, every frame advances by one fixed timestep
+                deltaTime = rg::FIXED_TIMESTEP;
+                advancePlayback();
+            }
+            frameInput = rg::InputFrame();
+        }
+        rg::GpuProfiler &gpuProfiler = rg::gpuProfiler();
+        rg::perfHud().BeginFrame();
+        rg::glCommandStats().BeginFrame();
+        rg::flightRecorder().BeginFrame(gpuProfiler);
+        rg::frameStats().reset();
+        gpuProfiler.BeginFrame();
 
         // render
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
@@ -355,55 +679,82 @@ int main() {
 
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
+        treeImpostors.clear();
+        dumpsterImpostors.clear();
+
+        // the projection, the frustum, the clusters and the LOD all follow the size actually rendered to
+        int width = offscreenTarget.width, height = offscreenTarget.height;
+        if (!headless)
+            glfwGetFramebufferSize(window, &width, &height);
+        // a minimised window has an empty framebuffer, keep the aspect finite
+        width = std::max(width, 1);
+        height = std::max(height, 1);
+
+        rg::LodSettings lodSettings;
+        lodSettings.enabled = programState->LodEnabled;
+        lodSettings.bias = programState->LodBias;
+        lodSettings.cameraPosition = programState->camera.Position;
+        lodSettings.projectionScale = rg::projectionScale(glm::radians(programState->camera.Zoom), (float) height);
+        viewFrustum = rg::Frustum(glm::perspective(glm::radians(programState->camera.Zoom),
+                                                   (float) width / (float) height, 0.1f, 100.0f) *
+                                  programState->camera.GetViewMatrix());
+
+        // the deferred path draws the opaque models into the G-buffer, the visibility buffer path only
+        // the models through the trash shader, everything else stays forward. The debug views only
+        // exist on the forward path.
+        rg::DebugViews &debugViews = rg::debugViews();
+        bool deferred = programState->RenderPath == RENDER_PATH_DEFERRED && !debugViews.Active();
+        bool visibility = programState->RenderPath == RENDER_PATH_VISIBILITY && !debugViews.Active();
+        unsigned int opaqueFeatures = deferred ? rg::SHADER_FEATURE_GBUFFER : debugViews.ShaderFeatures();
+        Shader &trashShader = trashVariants.get(lightMode, visibility ? rg::SHADER_FEATURE_VISIBILITY : opaqueFeatures);
+        Shader &impostorShader = impostorVariants.get(lightMode, opaqueFeatures);
+        Shader &plankShader = plankVariants.get(lightMode, opaqueFeatures);
+        Shader &pbShader = pbVariants.get(lightMode, (programState->InstancingEnabled ? rg::SHADER_FEATURE_INSTANCED
+                                                                                      : rg::SHADER_FEATURE_NONE) |
+                                                     debugViews.ShaderFeatures());
+
+        debugViews.BeginFrame(width, height);
+        if (lightMode == rg::LightMode::Clustered) {
+            buildSceneLights(clusteredLights.lights, lightMode);
+            clusteredLights.Update(programState->camera.GetViewMatrix(), glm::radians(programState->camera.Zoom),
+                                   (float) width / (float) height, 0.1f, 100.0f, width, height);
+        }
+        gpuProfiler.BeginPass("opaque models");
+        if (deferred) {
+            buildSceneLights(deferredRenderer.lights, lightMode);
+            deferredRenderer.stencilVolumes = programState->StencilLightVolumes;
+            deferredRenderer.BeginGeometry(width, height);
+        }
+        if (visibility)
+            visibilityBuffer.Begin(width, height);
+
         //Dusty Road
         trashShader.use();
-        trashShader.setInt("flag", flag);
-        trashShader.setVec3("dirLight.direction", dirLight.direction);
-        trashShader.setVec3("dirLight.ambient", dirLight.ambient);
-        trashShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        trashShader.setVec3("dirLight.specular", dirLight.specular);
-
-        trashShader.setVec3("pointLight.position", pointLight.position);
-        trashShader.setVec3("pointLight.ambient", pointLight.ambient);
-        trashShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        trashShader.setVec3("pointLight.specular", pointLight.specular);
-        trashShader.setFloat("pointLight.constant", pointLight.constant);
-        trashShader.setFloat("pointLight.linear", pointLight.linear);
-        trashShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        trashShader.setVec3("spotLight.position", programState->camera.Position);
-        trashShader.setVec3("spotLight.direction", programState->camera.Front);
-        trashShader.setVec3("spotLight.ambient", spotLight.ambient);
-        trashShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        trashShader.setVec3("spotLight.specular", spotLight.specular);
-        trashShader.setFloat("spotLight.constant", spotLight.constant);
-        trashShader.setFloat("spotLight.linear", spotLight.linear);
-        trashShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        trashShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        trashShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-
-        trashShader.setVec3("viewPos", programState->camera.Position);
-        trashShader.setFloat("material.shininess", 32.0);
+        setLightUniforms(trashShader, lightMode);
 
         // view/projection transformations
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                (float) width / (float) height, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
-        trashShader.setMat4("projection", projection);
-        trashShader.setMat4("view", view);
+        {
+            RG_PROFILE_ZONE("uniform upload");
+            trashShader.setVec3("viewPos", programState->camera.Position);
+            trashShader.setFloat("material.shininess", 32.0);
+            trashShader.setMat4("projection", projection);
+            trashShader.setMat4("view", view);
+        }
 
         // render the loaded model
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0, 0.0, 0.0)); 
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
         model = glm::scale(model, glm::vec3(0.0025)); 
-        trashShader.setMat4("model", model);
-        dustyRoad.Draw(trashShader);
+        drawOpaque(dustyRoad, trashShader, model);
 
         // Dumpster
         // view/projection transformations
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -413,13 +764,18 @@ int main() {
         model = glm::translate(model, glm::vec3(-1.2, 0.0, 0.0));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(0.012));    
-        trashShader.setMat4("model", model);
-        dumpster.Draw(trashShader);
+        if (cullModel(dumpster, model)) {
+        } else if (drawAsImpostor(dumpster, model)) {
+            dumpsterImpostors.push_back(makeInstance(model));
+        } else {
+            dumpster.SelectLod(model, lodSettings, dumpsterLods);
+            drawOpaque(dumpster, trashShader, model, 32.0f, true, dumpsterLods);
+        }
 
 
         // Oak Tree
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -429,13 +785,18 @@ int main() {
         model = glm::translate(model, glm::vec3(2.0, 0.0, -3.0)); 
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(0.15));    
-        trashShader.setMat4("model", model);
-        tree.Draw(trashShader);
+        if (cullModel(tree, model)) {
+        } else if (drawAsImpostor(tree, model)) {
+            treeImpostors.push_back(makeInstance(model));
+        } else {
+            tree.SelectLod(model, lodSettings, treeLods);
+            drawOpaque(tree, trashShader, model, 32.0f, true, treeLods);
+        }
 
 
         // Trash Bag
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -445,12 +806,11 @@ int main() {
         model = glm::translate(model, glm::vec3(-1.0, 0.21, 0.9)); 
         //model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(0.3));    
-        trashShader.setMat4("model", model);
-        trashBag.Draw(trashShader);
+        drawOpaque(trashBag, trashShader, model);
 
         // Streetlight
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -460,13 +820,12 @@ int main() {
         model = glm::translate(model, glm::vec3(-1.2, 1.2, -1.1)); 
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(0.1));    
-        trashShader.setMat4("model", model);
-        streetLight.Draw(trashShader);
+        drawOpaque(streetLight, trashShader, model);
 
 
         // Pile
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -476,14 +835,13 @@ int main() {
         model = glm::translate(model, glm::vec3(-1.5, -0.05, -1.7)); 
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
         model = glm::scale(model, glm::vec3(0.7));    
-        trashShader.setMat4("model", model);
         glDisable(GL_CULL_FACE);
-        pile.Draw(trashShader);
+        drawOpaque(pile, trashShader, model);
         glEnable(GL_CULL_FACE);
 
         // Oil Barrel
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -493,13 +851,12 @@ int main() {
         model = glm::translate(model, glm::vec3(1.3, 0.01, 1.0)); 
         //model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
         //model = glm::scale(model, glm::vec3(0.1));    
-        trashShader.setMat4("model", model);
-        oilBarrel.Draw(trashShader);
+        drawOpaque(oilBarrel, trashShader, model);
 
 
         // Canister
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -509,15 +866,14 @@ int main() {
         model = glm::translate(model, glm::vec3(1.85, 1.75, -1.05)); 
         model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(0.009));    
-        trashShader.setMat4("model", model);
-        canister.Draw(trashShader);
+        drawOpaque(canister, trashShader, model);
 
 
         // Old CocaCola Can
         // view/projection transformations
         trashShader.use();
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
         trashShader.setMat4("projection", projection);
         trashShader.setMat4("view", view);
@@ -527,46 +883,87 @@ int main() {
         model = glm::translate(model, glm::vec3(-0.54, 0.08, -0.5)); 
         model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0, 0.0, 0.0));
         model = glm::scale(model, glm::vec3(0.1));    
-        trashShader.setMat4("model", model);
         trashShader.setFloat("material.shininess", 128.0);
-        oldCan.Draw(trashShader);
+        drawOpaque(oldCan, trashShader, model, 128.0f);
+
+        // the synthetic scene, its trees become impostors in the distance like the hand placed one
+        if (sceneSettings.enabled) {
+            trashShader.setFloat("material.shininess", 32.0);
+            for (const glm::mat4 &tile : syntheticScene.roadTiles)
+                drawOpaque(dustyRoad, trashShader, tile);
+            for (unsigned int asset = 0; asset < rg::SCENE_ASSET_COUNT; asset++) {
+                // the bottles are transparent, they are drawn with the others
+                if (asset == rg::SCENE_ASSET_BOTTLE)
+                    continue;
+                float shininess = asset == rg::SCENE_ASSET_CAN ? 128.0f : 32.0f;
+                trashShader.setFloat("material.shininess", shininess);
+                for (rg::SceneObject &object : syntheticScene.objects[asset]) {
+                    Model &sceneModel = *sceneModels[asset][object.textureSet];
+                    if (asset == rg::SCENE_ASSET_TREE) {
+                        if (cullModel(sceneModel, object.transform))
+                            continue;
+                        if (drawAsImpostor(sceneModel, object.transform)) {
+                            treeImpostors.push_back(makeInstance(object.transform));
+                            continue;
+                        }
+                        sceneModel.SelectLod(object.transform, lodSettings, object.lods);
+                        drawOpaque(sceneModel, trashShader, object.transform, shininess, true, object.lods);
+                        continue;
+                    }
+                    drawOpaque(sceneModel, trashShader, object.transform, shininess);
+                }
+            }
+        }
+
+        if (visibility) {
+            gpuProfiler.BeginPass("visibility resolve");
+            Shader &resolveShader = resolveVariants.get(lightMode);
+            resolveShader.use();
+            setLightUniforms(resolveShader, lightMode);
+            visibilityBuffer.Resolve(resolveShader, view, projection, programState->camera.Position);
+        }
+
+        // Impostors
+        if (!treeImpostors.empty() || !dumpsterImpostors.empty()) {
+            gpuProfiler.BeginPass("impostors");
+            impostorShader.use();
+            setLightUniforms(impostorShader, lightMode);
+            {
+                RG_PROFILE_ZONE("uniform upload");
+                impostorShader.setVec3("viewPos", programState->camera.Position);
+                impostorShader.setFloat("shininess", 32.0);
+                impostorShader.setFloat("specularStrength", 0.1);
+                impostorShader.setMat4("projection", projection);
+                impostorShader.setMat4("view", view);
+            }
+            if (programState->BatchingEnabled) {
+                treeImpostor.Draw(impostorShader, treeImpostors);
+                dumpsterImpostor.Draw(impostorShader, dumpsterImpostors);
+            } else {
+                // one draw call per impostor, for comparison with the batched draws
+                for (const InstanceData &instance : treeImpostors)
+                    treeImpostor.Draw(impostorShader, vector<InstanceData>(1, instance));
+                for (const InstanceData &instance : dumpsterImpostors)
+                    dumpsterImpostor.Draw(impostorShader, vector<InstanceData>(1, instance));
+            }
+        }
 
         // Wooden plank
+        gpuProfiler.BeginPass("plank");
         plankShader.use();
-        plankShader.setInt("flag", flag);
-        plankShader.setVec3("dirLight.direction", dirLight.direction);
-        plankShader.setVec3("dirLight.ambient", dirLight.ambient);
-        plankShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        plankShader.setVec3("dirLight.specular", dirLight.specular);
-
-        plankShader.setVec3("pointLight.position", pointLight.position);
-        plankShader.setVec3("pointLight.ambient", pointLight.ambient);
-        plankShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        plankShader.setVec3("pointLight.specular", pointLight.specular);
-        plankShader.setFloat("pointLight.constant", pointLight.constant);
-        plankShader.setFloat("pointLight.linear", pointLight.linear);
-        plankShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        plankShader.setVec3("spotLight.position", programState->camera.Position);
-        plankShader.setVec3("spotLight.direction", programState->camera.Front);
-        plankShader.setVec3("spotLight.ambient", spotLight.ambient);
-        plankShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        plankShader.setVec3("spotLight.specular", spotLight.specular);
-        plankShader.setFloat("spotLight.constant", spotLight.constant);
-        plankShader.setFloat("spotLight.linear", spotLight.linear);
-        plankShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        plankShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        plankShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-
-        plankShader.setVec3("viewPos", programState->camera.Position);
-        plankShader.setFloat("heightScale", 0.1);
-        plankShader.setFloat("shininess", 32.0);
+        setLightUniforms(plankShader, lightMode);
 
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
-        plankShader.setMat4("projection", projection);
-        plankShader.setMat4("view", view);
+        {
+            RG_PROFILE_ZONE("uniform upload");
+            plankShader.setVec3("viewPos", programState->camera.Position);
+            plankShader.setFloat("heightScale", 0.1);
+            plankShader.setFloat("shininess", 32.0);
+            plankShader.setMat4("projection", projection);
+            plankShader.setMat4("view", view);
+        }
 
         // render the loaded model
         model = glm::mat4(1.0f);
@@ -584,83 +981,126 @@ int main() {
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, spec_map);
 
+        debugViews.BeginDraw(plankShader, &plankVAO, 0);
         renderPlank(plankVAO, plankVBO);
+        debugViews.EndDraw();
+
+        if (deferred) {
+            gpuProfiler.BeginPass("deferred lighting");
+            deferredDirectionalShader.use();
+            setLightUniforms(deferredDirectionalShader, rg::LightMode::Directional);
+            bool directional = lightMode == rg::LightMode::Directional || lightMode == rg::LightMode::Clustered;
+            deferredRenderer.LightPass(deferredDirectionalShader, deferredVolumeShader, view, projection,
+                                       programState->camera.Position, directional);
+        }
 
         // Plastic Bottle
+        gpuProfiler.BeginPass("bottles");
         pbShader.use();
-        pbShader.setInt("flag", flag);
-        pbShader.setVec3("dirLight.direction", dirLight.direction);
-        pbShader.setVec3("dirLight.ambient", dirLight.ambient);
-        pbShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        pbShader.setVec3("dirLight.specular", dirLight.specular);
-
-        pbShader.setVec3("pointLight.position", pointLight.position);
-        pbShader.setVec3("pointLight.ambient", pointLight.ambient);
-        pbShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        pbShader.setVec3("pointLight.specular", pointLight.specular);
-        pbShader.setFloat("pointLight.constant", pointLight.constant);
-        pbShader.setFloat("pointLight.linear", pointLight.linear);
-        pbShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        pbShader.setVec3("spotLight.position", programState->camera.Position);
-        pbShader.setVec3("spotLight.direction", programState->camera.Front);
-        pbShader.setVec3("spotLight.ambient", spotLight.ambient);
-        pbShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        pbShader.setVec3("spotLight.specular", spotLight.specular);
-        pbShader.setFloat("spotLight.constant", spotLight.constant);
-        pbShader.setFloat("spotLight.linear", spotLight.linear);
-        pbShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        pbShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        pbShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-
-        pbShader.setVec3("viewPos", programState->camera.Position);
-        pbShader.setFloat("material.shininess", 32.0);
+        setLightUniforms(pbShader, lightMode);
+
         // view/projection transformations
         projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                      (float) width / (float) height, 0.1f, 100.0f);
         view = programState->camera.GetViewMatrix();
-        pbShader.setMat4("projection", projection);
-        pbShader.setMat4("view", view);
+        {
+            RG_PROFILE_ZONE("uniform upload");
+            pbShader.setVec3("viewPos", programState->camera.Position);
+            pbShader.setFloat("material.shininess", 32.0);
+            pbShader.setMat4("projection", projection);
+            pbShader.setMat4("view", view);
+        }
 
-        // render the loaded model
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.25, 0.01, 0.0)); 
-        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::scale(model, glm::vec3(0.01));
-        pbShader.setMat4("model", model);
-        plasticBottle.Draw(pbShader);
+        // render the bottles of every texture set with a single instanced draw, or one draw per bottle
+        // for comparison
+        for (size_t set = 0; set < bottleInstances.size(); set++) {
+            Model &bottle = *sceneModels[rg::SCENE_ASSET_BOTTLE][set];
+            if (programState->InstancingEnabled) {
+                bottle.DrawInstanced(pbShader, bottleInstances[set]);
+            } else {
+                for (const InstanceData &instance : bottleInstances[set]) {
+                    pbShader.setMat4("model", instance.ModelMatrix);
+                    bottle.Draw(pbShader);
+                }
+            }
+            for (const InstanceData &instance : bottleInstances[set]) {
+                debugViews.AddBounds(bottle.boundsMinimum, bottle.boundsMaximum, instance.ModelMatrix);
+                rg::textureFeedback().Add(bottle, instance.ModelMatrix);
+            }
+        }
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.4, 0.02, -0.5)); 
-        model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::scale(model, glm::vec3(0.01));
-        pbShader.setMat4("model", model);
-        plasticBottle.Draw(pbShader);
-
-
-        // Skybox
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+        // Skybox, left out of the debug views
+        if (debugViews.Active()) {
+            gpuProfiler.BeginPass("debug view");
+            debugViews.EndScene(debugOverdrawShader, debugBoundsShader, programState->camera.GetViewMatrix(), projection);
+        } else {
+            gpuProfiler.BeginPass("skybox");
+            glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+            skyboxShader.use();
+            view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
+            skyboxShader.setMat4("view", view);
+            skyboxShader.setMat4("projection", projection);
+            // skybox cube
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            rg::countDraw(12);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS); // set depth function back to default
+        }
 
+        rg::TextureFeedback &textureFeedback = rg::textureFeedback();
+        if (textureFeedback.enabled) {
+            gpuProfiler.BeginPass("texture feedback");
+            textureFeedback.Render(textureFeedbackShader, programState->camera.GetViewMatrix(), projection, width, height);
+        }
+
+        if (programState->ImGuiEnabled) {
+            gpuProfiler.BeginPass("ImGui");
+            DrawImGui(programState);
+        }
+        gpuProfiler.EndFrame();
+        rg::perfHud().EndFrame(gpuProfiler);
+
+        if (headless) {
+            if (sceneSweep.Active() && benchmark.Measuring())
+                sceneSweep.AddFrame(rg::frameStats(), visibility ? visibilityBuffer.droppedDraws : 0);
+            benchmark.EndFrame();
+            if (sceneSweep.Active() && !benchmark.Running()) {
+                rg::gpuProfiler().Drain();
+                vector<rg::ClusterLight> sweepLights;
+                buildSceneLights(sweepLights, lightMode);
+                if (sceneSweep.Next(benchmark.CpuFrameMs(), benchmark.GpuFrameMs(rg::gpuProfiler()),
+                                    syntheticScene.ObjectCount(), sweepLights.size(), sceneTextureCount())) {
+                    applySweepStep();
+                    benchmark.Restart(rg::gpuProfiler().FrameNumber());
+                }
+            }
+            continue;
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    std::cout << "Startup breakdown:" << std::endl;
+    rg::startupTrace().PrintSummary();
+    rg::glDebugLayer().PrintSummary();
+
+    if (headless) {
+        rg::gpuProfiler().Drain();
+        bool written = benchmark.WriteReport(rg::gpuProfiler(), loadTime.count());
+        if (!benchmarkSettings.textureFeedbackPath.empty())
+            written = rg::textureFeedback().WriteReport(benchmarkSettings.textureFeedbackPath) && written;
+        if (!benchmarkSettings.sceneSweepPath.empty())
+            written = sceneSweep.WriteCsv(benchmarkSettings.sceneSweepPath) && written;
+        delete programState;
+        return written ? 0 : -1;
+    }
+
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
@@ -674,18 +1114,48 @@ int main() {
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 void processInput(GLFWwindow *window) {
+    RG_PROFILE_ZONE("processInput");
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    frameInput.deltaTime = deltaTime;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
         programState->camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        frameInput.keys |= rg::INPUT_KEY_FORWARD;
+    }
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
         programState->camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        frameInput.keys |= rg::INPUT_KEY_BACKWARD;
+    }
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
         programState->camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        frameInput.keys |= rg::INPUT_KEY_LEFT;
+    }
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
         programState->camera.ProcessKeyboard(RIGHT, deltaTime);
+        frameInput.keys |= rg::INPUT_KEY_RIGHT;
+    }
+
+}
 
+// moves the camera to the next frame of the recording or the camera path, control goes back to
+// the input once either runs out
+void advancePlayback() {
+    if (cameraControl == CAMERA_CONTROL_REPLAY) {
+        if (playbackFrame >= inputRecording.frames.size()) {
+            cameraControl = CAMERA_CONTROL_INPUT;
+            return;
+        }
+        inputRecording.Apply(playbackFrame, programState->camera);
+    } else {
+        float t = (float) playbackFrame * rg::FIXED_TIMESTEP;
+        if (t > flythrough.Duration()) {
+            cameraControl = CAMERA_CONTROL_INPUT;
+            return;
+        }
+        flythrough.Apply(t, programState->camera);
+    }
+    playbackFrame++;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -709,16 +1179,23 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
     lastX = xpos;
     lastY = ypos;
 
-    if (programState->CameraMouseMovementUpdateEnabled)
+    if (programState->CameraMouseMovementUpdateEnabled && cameraControl == CAMERA_CONTROL_INPUT) {
         programState->camera.ProcessMouseMovement(xoffset, yoffset);
+        frameInput.mouseX += xoffset;
+        frameInput.mouseY += yoffset;
+    }
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
+    if (cameraControl != CAMERA_CONTROL_INPUT)
+        return;
     programState->camera.ProcessMouseScroll(yoffset);
+    frameInput.scroll += yoffset;
 }
 
 void DrawImGui(ProgramState *programState) {
+    RG_PROFILE_ZONE("DrawImGui");
 
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -732,23 +1209,335 @@ void DrawImGui(ProgramState *programState) {
 
         ImGui::Checkbox("Moonlight", &flag1);
         if(flag1){
-            flag = 1;
+            lightMode = rg::LightMode::Directional;
             flag2 = false;
             flag3 = false;
+            flag4 = false;
         }
         ImGui::Checkbox("Streetlight", &flag2);
         if(flag2){
-            flag = 2;
+            lightMode = rg::LightMode::Point;
             flag1 = false;
             flag3 = false;
+            flag4 = false;
         }
         ImGui::Checkbox("Flashlight", &flag3);
         if(flag3){
-            flag = 3;
+            lightMode = rg::LightMode::Spot;
             flag1 = false;
             flag2 = false;
+            flag4 = false;
+        }
+        ImGui::Checkbox("Many lights (clustered)", &flag4);
+        if(flag4){
+            lightMode = rg::LightMode::Clustered;
+            flag1 = false;
+            flag2 = false;
+            flag3 = false;
+            ImGui::SliderInt("Street lights", &programState->StreetLightCount, 0, 64);
+            ImGui::SliderInt("Small lights", &programState->SmallLightCount, 0, 1024);
+            ImGui::Text("%u light indices, at most %u per cluster, %u dropped", clusteredLights.lightIndexCount,
+                        clusteredLights.maxClusterLights, clusteredLights.droppedLights);
+        }
+
+        ImGui::Separator();
+        ImGui::Checkbox("Impostors", &programState->ImpostorsEnabled);
+        ImGui::SliderFloat("Impostor distance", &programState->ImpostorDistance, 1.0f, 50.0f);
+
+        ImGui::Separator();
+        ImGui::RadioButton("Forward", &programState->RenderPath, RENDER_PATH_FORWARD);
+        ImGui::SameLine();
+        ImGui::RadioButton("Deferred", &programState->RenderPath, RENDER_PATH_DEFERRED);
+        ImGui::SameLine();
+        ImGui::RadioButton("Visibility buffer", &programState->RenderPath, RENDER_PATH_VISIBILITY);
+        if (programState->RenderPath == RENDER_PATH_DEFERRED) {
+            ImGui::Checkbox("Stencil light volumes", &programState->StencilLightVolumes);
+            ImGui::Text("%u light volumes", deferredRenderer.volumeCount);
+        }
+        if (programState->RenderPath == RENDER_PATH_VISIBILITY) {
+            ImGui::Text("%u draws (%u dropped), %u texture layers", visibilityBuffer.drawCount,
+                        visibilityBuffer.droppedDraws, visibilityBuffer.layerCount);
+        }
+
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Performance");
+        rg::PerfHud &hud = rg::perfHud();
+        ImGui::Checkbox("Frustum culling", &programState->CullingEnabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Level of detail", &programState->LodEnabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Instancing", &programState->InstancingEnabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Batching", &programState->BatchingEnabled);
+        ImGui::SliderFloat("LOD bias", &programState->LodBias, -2.0f, 4.0f);
+
+        rg::FrameTimePercentiles cpu = hud.cpu.Percentiles();
+        rg::FrameTimePercentiles gpu = hud.gpu.Percentiles();
+        if (ImGui::BeginTable("frame times", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("ms");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p95");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableSetupColumn("max");
+            ImGui::TableHeadersRow();
+            const char *names[] = {"CPU", "GPU"};
+            const rg::FrameTimePercentiles *rows[] = {&cpu, &gpu};
+            for (int i = 0; i < 2; i++) {
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(names[i]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", rows[i]->p50);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", rows[i]->p95);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", rows[i]->p99);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", rows[i]->max);
+            }
+            ImGui::EndTable();
+        }
+        // both graphs share a scale so they can be compared at a glance
+        float graphMax = std::max(std::max(cpu.max, gpu.max), 1.0f);
+        ImGui::PlotLines("CPU", hud.cpu.Data(), hud.cpu.Size(), hud.cpu.Offset(), NULL, 0.0f, graphMax, ImVec2(0, 60));
+        ImGui::PlotLines("GPU", hud.gpu.Data(), hud.gpu.Size(), hud.gpu.Offset(), NULL, 0.0f, graphMax, ImVec2(0, 60));
+        std::vector<float> histogram = hud.cpu.Histogram(32, graphMax);
+        ImGui::PlotHistogram("CPU histogram", histogram.data(), (int) histogram.size(), 0,
+                             NULL, 0.0f, FLT_MAX, ImVec2(0, 60));
+
+        const rg::FrameStats &stats = hud.lastFrame;
+        ImGui::Text("%u draw calls, %llu triangles", stats.drawCalls, stats.triangles);
+        ImGui::Text("%u bind calls, %u uniform uploads, %u objects culled", stats.bindCalls,
+                    stats.uniformUploads, stats.culledObjects);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("binds the draw code asked for, redundant ones included;\n"
+                              "the GL commands window counts what reaches the driver");
+
+        rg::FlightRecorder &recorder = rg::flightRecorder();
+        ImGui::Checkbox("Dump hitches", &recorder.enabled);
+        ImGui::SameLine();
+        ImGui::SliderFloat("x median", &recorder.thresholdFactor, 1.5f, 10.0f);
+        ImGui::Text("%u hitches dumped, %u skipped (cooldown) %s", recorder.dumps, recorder.skippedHitches,
+                    recorder.lastDumpPath.c_str());
+
+        rg::GlDebugLayer &debugLayer = rg::glDebugLayer();
+        if (debugLayer.Active()) {
+            bool synchronous = debugLayer.Synchronous();
+            if (ImGui::Checkbox("Synchronous GL debug output", &synchronous))
+                debugLayer.SetSynchronous(synchronous);
+            ImGui::Text("%u GL debug messages, %u distinct", debugLayer.Messages(), debugLayer.DistinctMessages());
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Memory");
+        rg::MemoryStats &memory = rg::memoryStats();
+        rg::AssetMemory totals = memory.Totals();
+        if (ImGui::Button("Dump JSON"))
+            memory.WriteJson("memory.json");
+        ImGui::Text("GPU: %.1f MiB buffers, %.1f MiB textures. CPU geometry: %.1f MiB. Peak load scratch: %.1f MiB",
+                    totals.gpuBufferBytes / 1048576.0, totals.gpuTextureBytes / 1048576.0,
+                    totals.cpuGeometryBytes / 1048576.0, totals.decoderScratchBytes / 1048576.0);
+        rg::DriverMemory driver = rg::MemoryStats::QueryDriver();
+        if (driver.source == "GL_NVX_gpu_memory_info")
+            ImGui::Text("Driver (%s): %.1f MiB dedicated, %.1f MiB available, %.1f MiB evicted", driver.source.c_str(),
+                        driver.dedicatedKb / 1024.0, driver.currentAvailableKb / 1024.0, driver.evictedKb / 1024.0);
+        else if (driver.source == "GL_ATI_meminfo")
+            ImGui::Text("Driver (%s): %.1f MiB free for textures, %.1f MiB free for buffers", driver.source.c_str(),
+                        driver.textureFreeKb / 1024.0, driver.bufferFreeKb / 1024.0);
+        else
+            ImGui::Text("The driver reports no memory budget (no NVX_gpu_memory_info or ATI_meminfo)");
+
+        ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                                ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY;
+        if (ImGui::BeginTable("assets", 6, flags, ImVec2(0, 300))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Asset", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Kind");
+            ImGui::TableSetupColumn("GPU buffers KiB", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableSetupColumn("GPU textures KiB",
+                                    ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_DefaultSort);
+            ImGui::TableSetupColumn("CPU geometry KiB", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableSetupColumn("Scratch KiB", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableHeadersRow();
+
+            std::vector<rg::AssetMemory> rows = memory.Assets();
+            const ImGuiTableSortSpecs *sortSpecs = ImGui::TableGetSortSpecs();
+            if (sortSpecs && sortSpecs->SpecsCount > 0) {
+                const ImGuiTableColumnSortSpecs &spec = sortSpecs->Specs[0];
+                auto key = [&spec](const rg::AssetMemory &asset) -> size_t {
+                    switch (spec.ColumnIndex) {
+                        case 2: return asset.gpuBufferBytes;
+                        case 3: return asset.gpuTextureBytes;
+                        case 4: return asset.cpuGeometryBytes;
+                        case 5: return asset.decoderScratchBytes;
+                        default: return 0;
+                    }
+                };
+                bool ascending = spec.SortDirection == ImGuiSortDirection_Ascending;
+                std::stable_sort(rows.begin(), rows.end(), [&](const rg::AssetMemory &a, const rg::AssetMemory &b) {
+                    if (spec.ColumnIndex <= 1) {
+                        const std::string &left = spec.ColumnIndex == 0 ? a.name : a.kind;
+                        const std::string &right = spec.ColumnIndex == 0 ? b.name : b.kind;
+                        return ascending ? left < right : left > right;
+                    }
+                    return ascending ? key(a) < key(b) : key(a) > key(b);
+                });
+            }
+            for (const rg::AssetMemory &asset : rows) {
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(asset.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(asset.kind.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", asset.gpuBufferBytes / 1024.0);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", asset.gpuTextureBytes / 1024.0);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", asset.cpuGeometryBytes / 1024.0);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", asset.decoderScratchBytes / 1024.0);
+            }
+            ImGui::EndTable();
+        }
+
+        rg::TextureFeedback &feedback = rg::textureFeedback();
+        ImGui::Checkbox("Record texture mip feedback", &feedback.enabled);
+        ImGui::SameLine();
+        if (ImGui::Button("Reset"))
+            feedback.Reset();
+        ImGui::SameLine();
+        if (ImGui::Button("Write report"))
+            feedback.WriteReport(TEXTURE_MIPS_PATH);
+        ImGui::Text("%u feedback passes, F4 flies the camera path", feedback.passes);
+        if (feedback.passes > 0 && ImGui::BeginTable("mips", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                                                                 ImGuiTableFlags_ScrollY, ImVec2(0, 200))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Texture", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Loaded");
+            ImGui::TableSetupColumn("Finest mip");
+            ImGui::TableSetupColumn("Needs");
+            ImGui::TableHeadersRow();
+            for (const rg::TextureMipUsage &texture : feedback.Usage()) {
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(texture.path.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%dx%d", texture.width, texture.height);
+                ImGui::TableNextColumn();
+                if (texture.finestMip < 0)
+                    ImGui::TextUnformatted("not seen");
+                else
+                    ImGui::Text("%d", texture.finestMip);
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", texture.MaxSize(feedback.minimumSize));
+            }
+            ImGui::EndTable();
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("GL commands");
+        rg::GlCommandStats &commands = rg::glCommandStats();
+        bool intercept = commands.Installed();
+        if (ImGui::Checkbox("Intercept GL calls", &intercept)) {
+            if (intercept)
+                commands.Install();
+            else
+                commands.Uninstall();
+        }
+        ImGui::SameLine();
+        ImGui::Checkbox("Per call site", &commands.callSites);
+        ImGui::SameLine();
+        if (ImGui::Button("Dump JSON"))
+            commands.WriteJson("gl_commands.json");
+        if (commands.Installed()) {
+            const rg::GlFrameCounters &frame = commands.lastFrame;
+            ImGui::Text("%u draws: %llu indices, %llu vertices, %llu instances", frame.drawCalls, frame.indices,
+                        frame.vertices, frame.instances);
+            ImGui::Text("binds: %u programs, %u VAOs, %u textures, %u buffers, %u framebuffers", frame.programBinds,
+                        frame.vaoBinds, frame.textureBinds, frame.bufferBinds, frame.framebufferBinds);
+            ImGui::Text("%u uniform calls, %u state toggles", frame.uniformCalls, frame.stateToggles);
+            ImGui::Text("%u buffer uploads (%.1f KiB), %u texture uploads", frame.bufferUploads,
+                        frame.bufferBytes / 1024.0, frame.textureUploads);
+            if (ImGui::CollapsingHeader("Entry points")) {
+                for (size_t i = 0; i < frame.calls.size(); i++) {
+                    if (frame.calls[i] > 0)
+                        ImGui::Text("%6u  %s", frame.calls[i], commands.Commands()[i].name.c_str());
+                }
+            }
+            if (commands.callSites && ImGui::CollapsingHeader("Call sites")) {
+                for (size_t i = 0; i < commands.lastCallSites.size() && i < 30; i++) {
+                    const rg::GlCallSite &site = commands.lastCallSites[i];
+                    ImGui::Text("%6u  %-24s %s", site.calls, commands.Commands()[site.command].name.c_str(),
+                                commands.CallSiteName(site.address).c_str());
+                }
+            }
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("GPU profiler");
+        rg::GpuProfiler &profiler = rg::gpuProfiler();
+        const rg::GpuFrameTiming &frame = profiler.Latest();
+        ImGui::Checkbox("Enabled", &profiler.enabled);
+        ImGui::SameLine();
+        if (ImGui::Button("Export CSV"))
+            profiler.WriteCsv("gpu_profile.csv");
+        ImGui::Text("Frame %llu: %.3f ms, %u frames dropped", frame.frame, frame.gpuMs, profiler.droppedFrames);
+        if (!profiler.PipelineStatisticsAvailable())
+            ImGui::Text("ARB_pipeline_statistics_query is not supported, only samples passed are counted");
+        if (ImGui::BeginTable("passes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("ms (avg)");
+            ImGui::TableSetupColumn("Primitives");
+            ImGui::TableSetupColumn("Fragments");
+            ImGui::TableSetupColumn("Samples");
+            ImGui::TableHeadersRow();
+            for (const rg::GpuPassTiming &pass : frame.passes) {
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(pass.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f (%.3f)", pass.gpuMs, pass.averageMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", (unsigned long long) pass.primitivesSubmitted);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", (unsigned long long) pass.fragmentInvocations);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", (unsigned long long) pass.samplesPassed);
+            }
+            ImGui::EndTable();
         }
+        ImGui::End();
+    }
 
+    {
+        ImGui::Begin("Debug views");
+        rg::DebugViews &views = rg::debugViews();
+        int view = (int) views.view;
+        ImGui::Combo("View", &view, rg::DEBUG_VIEW_NAMES, IM_ARRAYSIZE(rg::DEBUG_VIEW_NAMES));
+        views.view = (rg::DebugView) view;
+        if (views.Active() && programState->RenderPath != RENDER_PATH_FORWARD)
+            ImGui::Text("drawn with the forward path");
+        if (views.view == rg::DebugView::Overdraw) {
+            ImGui::SliderFloat("Red at layers", &views.overdrawLayers, 2.0f, 64.0f);
+            ImGui::Text("last dump: %.2f layers on average, %.0f at most", views.averageOverdraw, views.maxOverdraw);
+        } else if (views.view == rg::DebugView::DrawCost) {
+            ImGui::SliderFloat("Tint", &views.tint, 0.0f, 1.0f);
+            ImGui::Text("%u draws, %.3f ms in total, the slowest (red) %.3f ms", views.timedDraws, views.totalDrawMs,
+                        views.maxDrawMs);
+        } else if (views.view == rg::DebugView::Lod) {
+            ImGui::SliderFloat("Tint", &views.tint, 0.0f, 1.0f);
+            ImGui::Text("LOD 0 green, 1 yellow, 2 orange, 3 red, impostors blue");
+        }
+        if (views.Active() && ImGui::Button("Dump image"))
+            views.RequestDump();
+        if (!views.lastDumpPath.empty())
+            ImGui::Text("wrote %s", views.lastDumpPath.c_str());
         ImGui::End();
     }
 
@@ -759,6 +1548,14 @@ void DrawImGui(ProgramState *programState) {
         ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
         ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
         ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
+        if (recordingInput)
+            ImGui::Text("Recording input: %zu frames (F2 stops)", inputRecording.frames.size());
+        else if (cameraControl == CAMERA_CONTROL_REPLAY)
+            ImGui::Text("Replaying frame %u / %zu", playbackFrame, inputRecording.frames.size());
+        else if (cameraControl == CAMERA_CONTROL_FLYTHROUGH)
+            ImGui::Text("Flythrough %.2f / %.2f s", playbackFrame * rg::FIXED_TIMESTEP, flythrough.Duration());
+        else
+            ImGui::Text("F2 record input, F3 replay it, F4 fly the camera path, F5 dump the CPU profile");
         ImGui::End();
     }
 
@@ -777,6 +1574,33 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
         }
     }
+
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS && cameraControl == CAMERA_CONTROL_INPUT) {
+        recordingInput = !recordingInput;
+        if (recordingInput)
+            inputRecording.frames.clear();
+        else
+            inputRecording.Save(INPUT_RECORDING_PATH);
+    }
+    if ((key == GLFW_KEY_F3 || key == GLFW_KEY_F4) && action == GLFW_PRESS) {
+        if (recordingInput) {
+            recordingInput = false;
+            inputRecording.Save(INPUT_RECORDING_PATH);
+        }
+        if (key == GLFW_KEY_F3 && inputRecording.Load(INPUT_RECORDING_PATH))
+            cameraControl = CAMERA_CONTROL_REPLAY;
+        else if (key == GLFW_KEY_F4 && flythrough.keyframes.size() >= 2)
+            cameraControl = CAMERA_CONTROL_FLYTHROUGH;
+        playbackFrame = 0;
+    }
+
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+#if RG_PROFILER_ENABLED
+        rg::profiler().WriteChromeTrace(CPU_PROFILE_PATH);
+#else
+        std::cout << "The CPU profiler is compiled out, configure with -DPROFILER=ON to keep it" << std::endl;
+#endif
+    }
 }
 
 
@@ -790,10 +1614,14 @@ unsigned int loadCubemap(vector<std::string> faces)
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
+        rg::TraceScope trace("load cubemap face", faces[i]);
+        rg::TraceScope decodeTrace("stbi_load");
         unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        decodeTrace.End();
         if (data)
         {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            rg::memoryStats().AddTexture(textureID, faces[0], "cubemap", width, height, nrChannels, false);
             stbi_image_free(data);
         }
         else
@@ -812,6 +1640,148 @@ unsigned int loadCubemap(vector<std::string> faces)
 }
 
 
+// uploads the active light, the shader has to be in use and compiled for the same light
+void setLightUniforms(Shader &shader, rg::LightMode light)
+{
+    RG_PROFILE_ZONE("uniform upload");
+    switch (light) {
+        case rg::LightMode::Directional:
+        case rg::LightMode::Clustered:
+            shader.setVec3("dirLight.direction", dirLight.direction);
+            shader.setVec3("dirLight.ambient", dirLight.ambient);
+            shader.setVec3("dirLight.diffuse", dirLight.diffuse);
+            shader.setVec3("dirLight.specular", dirLight.specular);
+            if (light == rg::LightMode::Clustered)
+                clusteredLights.Bind(shader, CLUSTER_TEXTURE_UNIT);
+            break;
+        case rg::LightMode::Point:
+            shader.setVec3("pointLight.position", pointLight.position);
+            shader.setVec3("pointLight.ambient", pointLight.ambient);
+            shader.setVec3("pointLight.diffuse", pointLight.diffuse);
+            shader.setVec3("pointLight.specular", pointLight.specular);
+            shader.setFloat("pointLight.constant", pointLight.constant);
+            shader.setFloat("pointLight.linear", pointLight.linear);
+            shader.setFloat("pointLight.quadratic", pointLight.quadratic);
+            break;
+        case rg::LightMode::Spot:
+            shader.setVec3("spotLight.position", programState->camera.Position);
+            shader.setVec3("spotLight.direction", programState->camera.Front);
+            shader.setVec3("spotLight.ambient", spotLight.ambient);
+            shader.setVec3("spotLight.diffuse", spotLight.diffuse);
+            shader.setVec3("spotLight.specular", spotLight.specular);
+            shader.setFloat("spotLight.constant", spotLight.constant);
+            shader.setFloat("spotLight.linear", spotLight.linear);
+            shader.setFloat("spotLight.quadratic", spotLight.quadratic);
+            shader.setFloat("spotLight.cutOff", spotLight.cutOff);
+            shader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
+            break;
+    }
+}
+
+// the point and spot lights of a light mode: the streetlight, the flashlight, or for the many lights
+// mode both plus more street lights down the road and small lights scattered over the ground,
+// the scattered ones come from a fixed seed so they stay in place between frames
+void buildSceneLights(std::vector<rg::ClusterLight> &lights, rg::LightMode mode)
+{
+    lights.clear();
+    if (mode == rg::LightMode::Directional)
+        return;
+    rg::ClusterLight light;
+    light.position = pointLight.position;
+    light.ambient = pointLight.ambient;
+    light.diffuse = pointLight.diffuse;
+    light.specular = pointLight.specular;
+    light.constant = pointLight.constant;
+    light.linear = pointLight.linear;
+    light.quadratic = pointLight.quadratic;
+    if (mode != rg::LightMode::Spot)
+        lights.push_back(light);
+
+    // the extra street lights alternate in front of and behind the original one, the synthetic scene
+    // lights the lamps of its own street lights instead
+    light.linear = 0.7f;
+    light.quadratic = 1.8f;
+    int streetLights = mode == rg::LightMode::Clustered && !sceneSettings.enabled ? programState->StreetLightCount : 0;
+    for (int i = 1; i <= streetLights; i++) {
+        float side = i % 2 == 0 ? 1.0f : -1.0f;
+        light.position = pointLight.position + glm::vec3(0.0f, 0.0f, side * 3.0f * ((i + 1) / 2));
+        lights.push_back(light);
+    }
+    if (mode == rg::LightMode::Clustered && sceneSettings.enabled) {
+        for (const glm::vec3 &lamp : syntheticScene.lamps) {
+            light.position = lamp;
+            lights.push_back(light);
+        }
+    }
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    light.ambient = glm::vec3(0.0f);
+    light.linear = 4.5f;
+    light.quadratic = 75.0f;
+    int smallLights = mode == rg::LightMode::Clustered ? programState->SmallLightCount : 0;
+    for (int i = 0; i < smallLights; i++) {
+        light.position = glm::vec3(-4.0f + 8.0f * unit(random), 0.05f + 0.3f * unit(random), -20.0f + 30.0f * unit(random));
+        light.diffuse = glm::mix(glm::vec3(1.0f, 0.45f, 0.1f), glm::vec3(0.3f, 0.6f, 1.0f), unit(random));
+        light.specular = light.diffuse;
+        lights.push_back(light);
+    }
+
+    light.position = programState->camera.Position;
+    light.direction = programState->camera.Front;
+    light.spot = true;
+    light.cutOff = spotLight.cutOff;
+    light.outerCutOff = spotLight.outerCutOff;
+    light.ambient = spotLight.ambient;
+    light.diffuse = spotLight.diffuse;
+    light.specular = spotLight.specular;
+    light.constant = spotLight.constant;
+    light.linear = spotLight.linear;
+    light.quadratic = spotLight.quadratic;
+    if (mode != rg::LightMode::Point)
+        lights.push_back(light);
+}
+
+// draws a model with the trash shader, on the visibility buffer path it only writes the ids (unless a
+// debug view replaces that path). Callers that already ran cullModel pass culled to skip the second test,
+// lods are the placement's levels of detail from Model::SelectLod.
+void drawOpaque(Model &model, Shader &shader, const glm::mat4 &transform, float shininess, bool culled,
+                const rg::LodLevels &lods)
+{
+    if (!culled && cullModel(model, transform))
+        return;
+    if (programState->RenderPath == RENDER_PATH_VISIBILITY && !rg::debugViews().Active()) {
+        visibilityBuffer.Draw(model, transform, shader, shininess, lods);
+        rg::textureFeedback().Add(model, transform, lods);
+        return;
+    }
+    shader.setMat4("model", transform);
+    model.Draw(shader, lods);
+    rg::debugViews().AddBounds(model.boundsMinimum, model.boundsMaximum, transform);
+    rg::textureFeedback().Add(model, transform, lods);
+}
+
+// whether a model placed with this transform lies outside the camera frustum and can be skipped
+bool cullModel(const Model &model, const glm::mat4 &transform)
+{
+    if (!programState->CullingEnabled)
+        return false;
+    glm::vec3 center = glm::vec3(transform * glm::vec4(model.boundsCenter, 1.0f));
+    if (viewFrustum.IntersectsSphere(center, model.boundsRadius * rg::maxAxisScale(transform)))
+        return false;
+    rg::frameStats().culledObjects++;
+    return true;
+}
+
+// whether a model placed with this transform is far enough away to be drawn as its impostor
+bool drawAsImpostor(const Model &model, const glm::mat4 &transform)
+{
+    if (!programState->ImpostorsEnabled)
+        return false;
+    glm::vec3 center = glm::vec3(transform * glm::vec4(model.boundsCenter, 1.0f));
+    return glm::distance(center, programState->camera.Position) > programState->ImpostorDistance;
+}
+
 void renderPlank(unsigned int plankVAO, unsigned int plankVBO)
 {
     if (plankVAO == 0)
@@ -901,18 +1871,23 @@ void renderPlank(unsigned int plankVAO, unsigned int plankVBO)
     }
     glBindVertexArray(plankVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    rg::countDraw(2);
     glBindVertexArray(0);
 }
 
 unsigned int loadTexture(char const *path)
 {
+    rg::TraceScope trace("load texture", path);
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
+    rg::TraceScope decodeTrace("stbi_load");
     unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    decodeTrace.End();
     if (data)
     {
+        rg::textureBudget().Apply(path, data, width, height, nrComponents);
         GLenum format;
         if (nrComponents == 1)
             format = GL_RED;
@@ -922,8 +1897,15 @@ unsigned int loadTexture(char const *path)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        {
+            rg::TraceScope uploadTrace("glTexImage2D");
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        }
+        {
+            rg::TraceScope mipmapTrace("glGenerateMipmap");
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        rg::memoryStats().AddTexture(textureID, path, "texture", width, height, nrComponents, true);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
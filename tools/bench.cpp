@@ -0,0 +1,425 @@
+// Micro-benchmarks of the CPU hot paths of loading and of the render loop, see rg::MicroBench:
+//
+//   bench [--filter TEXT] [--json PATH] [--baseline PATH] [--min-sample-ms MS] [--samples N]
+//         [--max-seconds SECONDS]
+//
+//   convert_vertices/MODEL    Model::ConvertVertices of every mesh of a model, items are vertices
+//   stbi_load/IMAGE           decoding every image under resources/ from memory, items are pixels
+//   uniform/*                 Shader::set* including its glGetUniformLocation, and both halves alone
+//   sampler_names/MODEL       the sampler names Mesh::Draw builds for every mesh of a model
+//   matrices/*                the projection, view and model matrices the render loop builds per object
+//   cull/N                    frustum culling N objects of the synthetic scene as cullModel() does
+//   sort/state/N, sort/depth/N  ordering the visible ones by model and by distance
+//
+// --filter runs the benchmarks whose name contains TEXT. With --baseline the run is compared against
+// an earlier --json and exits with 1 when a benchmark got slower with 95% confidence. Run from the
+// source directory, in the same build type as the comparison.
+
+#include <glad/glad.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <rg/Frustum.h>
+#include <rg/HeadlessContext.h>
+#include <rg/MicroBench.h>
+#include <rg/ShaderPermutations.h>
+#include <rg/SyntheticScene.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// the models main() loads, the first is the road the synthetic scene is tiled from
+const char *const MODEL_FILES[] = {
+        "resources/objects/dusty_road/scene.gltf",
+        "resources/objects/dumpster/scene.gltf",
+        "resources/objects/oak/Oak.obj",
+        "resources/objects/trash_bag/scene.gltf",
+        "resources/objects/rusty_streetlight/Light Pole.obj",
+        "resources/objects/plastic_water_bottle/scene.gltf",
+        "resources/objects/pile/scene.gltf",
+        "resources/objects/oil_barrel/scene.gltf",
+        "resources/objects/canister/scene.gltf",
+        "resources/objects/old_coca_cola_can/scene.gltf",
+};
+
+// indexes MODEL_FILES by rg::SceneAsset
+const unsigned int SCENE_ASSET_MODELS[rg::SCENE_ASSET_COUNT] = {9, 5, 7, 3, 2, 4};
+
+const unsigned int OBJECT_COUNTS[] = {100, 1000, 10000, 100000};
+
+// the directory of the model, which is what the benchmarks are named by
+std::string modelName(const std::string &path) {
+    std::string directory = path.substr(0, path.find_last_of('/'));
+    return directory.substr(directory.find_last_of('/') + 1);
+}
+
+// an assimp scene as Model::loadModel imports it, with the object-space bounds Model computes
+struct ImportedModel {
+    Assimp::Importer importer;
+    const aiScene *scene = nullptr;
+    size_t vertices = 0;
+    glm::vec3 boundsMinimum = glm::vec3(0.0f);
+    glm::vec3 boundsMaximum = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+};
+
+ImportedModel &importModel(unsigned int index) {
+    static std::unique_ptr<ImportedModel> models[std::extent<decltype(MODEL_FILES)>::value];
+    if (models[index])
+        return *models[index];
+    models[index].reset(new ImportedModel());
+    ImportedModel &model = *models[index];
+    model.scene = model.importer.ReadFile(MODEL_FILES[index], Model::importFlags);
+    if (!model.scene || model.scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !model.scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP:: " << model.importer.GetErrorString() << std::endl;
+        model.scene = nullptr;
+        return model;
+    }
+    glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(-std::numeric_limits<float>::max());
+    for (unsigned int i = 0; i < model.scene->mNumMeshes; i++) {
+        vector<Vertex> vertices;
+        Model::ConvertVertices(model.scene->mMeshes[i], vertices);
+        model.vertices += vertices.size();
+        for (const Vertex &vertex : vertices) {
+            minimum = glm::min(minimum, vertex.Position);
+            maximum = glm::max(maximum, vertex.Position);
+        }
+    }
+    if (model.vertices > 0) {
+        model.boundsMinimum = minimum;
+        model.boundsMaximum = maximum;
+        model.boundsCenter = (minimum + maximum) * 0.5f;
+        model.boundsRadius = glm::length(maximum - model.boundsCenter);
+    }
+    return model;
+}
+
+void benchConvertVertices(rg::MicroBench &bench) {
+    for (unsigned int i = 0; i < std::extent<decltype(MODEL_FILES)>::value; i++) {
+        std::string name = "convert_vertices/" + modelName(MODEL_FILES[i]);
+        if (!bench.Selected(name))
+            continue;
+        ImportedModel &model = importModel(i);
+        if (!model.scene)
+            continue;
+        // a new vector per mesh, as processMesh fills one
+        bench.Run(name, (double) model.vertices, [&]() {
+            for (unsigned int mesh = 0; mesh < model.scene->mNumMeshes; mesh++) {
+                vector<Vertex> vertices;
+                Model::ConvertVertices(model.scene->mMeshes[mesh], vertices);
+                rg::doNotOptimize(vertices.data());
+            }
+        });
+    }
+}
+
+void listImages(const std::string &directory, std::vector<std::string> &images) {
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return;
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + "/" + name;
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+            continue;
+        if (S_ISDIR(status.st_mode)) {
+            listImages(path, images);
+            continue;
+        }
+        std::string extension = name.substr(name.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga")
+            images.push_back(path);
+    }
+    closedir(dir);
+}
+
+// decodes from memory, so the disk cache does not decide the result
+void benchImageDecoding(rg::MicroBench &bench) {
+    std::vector<std::string> images;
+    listImages("resources", images);
+    std::sort(images.begin(), images.end());
+    stbi_set_flip_vertically_on_load(false);
+    for (const std::string &path : images) {
+        std::string name = "stbi_load/" + path.substr(std::string("resources/").size());
+        if (!bench.Selected(name))
+            continue;
+        std::ifstream in(path, std::ios::binary);
+        std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        int width = 0, height = 0, components = 0;
+        if (!stbi_info_from_memory(file.data(), (int) file.size(), &width, &height, &components)) {
+            std::cout << "ERROR::BENCH:: could not decode " << path << std::endl;
+            continue;
+        }
+        bench.Run(name, (double) width * height, [&]() {
+            int imageWidth, imageHeight, imageComponents;
+            unsigned char *data = stbi_load_from_memory(file.data(), (int) file.size(), &imageWidth, &imageHeight,
+                                                        &imageComponents, 0);
+            rg::doNotOptimize(data);
+            stbi_image_free(data);
+        });
+    }
+}
+
+void benchUniforms(rg::MicroBench &bench) {
+    Shader shader("resources/shaders/trash.vs", "resources/shaders/trash.fs",
+                  rg::permutationDefines(rg::LightMode::Directional, rg::SHADER_FEATURE_NONE));
+    shader.use();
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::vec3 viewPos(0.0f, 0.0f, 3.0f);
+    int location = glGetUniformLocation(shader.ID, "projection");
+    bench.Run("uniform/glGetUniformLocation", 1.0, [&]() {
+        rg::doNotOptimize(glGetUniformLocation(shader.ID, "material.shininess"));
+    });
+    bench.Run("uniform/glUniformMatrix4fv", 1.0, [&]() {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &projection[0][0]);
+    });
+    bench.Run("uniform/setFloat", 1.0, [&]() {
+        shader.setFloat("material.shininess", 32.0f);
+    });
+    bench.Run("uniform/setVec3", 1.0, [&]() {
+        shader.setVec3("viewPos", viewPos);
+    });
+    bench.Run("uniform/setMat4", 1.0, [&]() {
+        shader.setMat4("projection", projection);
+    });
+    glDeleteProgram(shader.ID);
+}
+
+void benchSamplerNames(rg::MicroBench &bench) {
+    for (const char *path : MODEL_FILES) {
+        std::string name = "sampler_names/" + modelName(path);
+        if (!bench.Selected(name))
+            continue;
+        Model model(path);
+        if (model.meshes.empty())
+            continue;
+        model.SetShaderTextureNamePrefix("material.");
+        size_t textures = 0;
+        for (const Mesh &mesh : model.meshes)
+            textures += mesh.textures.size();
+        // reused between meshes like the scratch vector of Mesh::bindTextures
+        vector<string> names;
+        bench.Run(name, (double) textures, [&]() {
+            for (const Mesh &mesh : model.meshes) {
+                mesh.SamplerNames(names);
+                rg::doNotOptimize(names.data());
+            }
+        });
+    }
+}
+
+// the inputs change every iteration, so nothing is folded into a constant
+void benchMatrices(rg::MicroBench &bench) {
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    unsigned int step = 0;
+    auto angle = [&]() {
+        return (float) (step++ & 1023u) * 0.01f;
+    };
+    bench.Run("matrices/view_projection", 1.0, [&]() {
+        camera.Position.x = angle();
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 800.0f / 600.0f, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        rg::doNotOptimize(projection);
+        rg::doNotOptimize(view);
+    });
+    bench.Run("matrices/model", 1.0, [&]() {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(-1.2f, 0.0f, angle()));
+        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.012f));
+        rg::doNotOptimize(model);
+    });
+    bench.Run("matrices/make_instance", 1.0, [&]() {
+        glm::mat4 model = glm::rotate(glm::mat4(1.0f), angle(), glm::vec3(0.0f, 1.0f, 0.0f));
+        rg::doNotOptimize(makeInstance(model));
+    });
+}
+
+struct CullObject {
+    glm::mat4 transform;
+    unsigned int asset;
+};
+
+struct DrawKey {
+    uint64_t key;
+    unsigned int object;
+};
+
+struct DepthKey {
+    float depth;
+    unsigned int object;
+};
+
+// the synthetic scene scaled to about count objects, seen by the camera main() starts with
+void benchCullingAndSorting(rg::MicroBench &bench) {
+    ImportedModel &road = importModel(0);
+    glm::vec3 assetCenters[rg::SCENE_ASSET_COUNT];
+    float assetRadii[rg::SCENE_ASSET_COUNT];
+    for (unsigned int asset = 0; asset < rg::SCENE_ASSET_COUNT; asset++) {
+        ImportedModel &model = importModel(SCENE_ASSET_MODELS[asset]);
+        assetCenters[asset] = model.boundsCenter;
+        assetRadii[asset] = model.boundsRadius;
+    }
+    glm::mat4 roadTransform = glm::mat4(1.0f);
+    roadTransform = glm::rotate(roadTransform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    roadTransform = glm::scale(roadTransform, glm::vec3(0.0025f));
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 800.0f / 600.0f, 0.1f, 100.0f);
+    rg::Frustum frustum(projection * camera.GetViewMatrix());
+
+    for (unsigned int count : OBJECT_COUNTS) {
+        std::string suffix = std::to_string(count);
+        if (!bench.Selected("cull/" + suffix) && !bench.Selected("sort/state/" + suffix) &&
+            !bench.Selected("sort/depth/" + suffix))
+            continue;
+        rg::SyntheticSceneSettings settings;
+        unsigned int total = 0;
+        for (unsigned int assetCount : settings.counts)
+            total += assetCount;
+        double scale = (double) count / total;
+        for (unsigned int &assetCount : settings.counts)
+            assetCount = (unsigned int) std::lround(assetCount * scale);
+        settings.roadTiles = std::max(1u, (unsigned int) std::lround(settings.roadTiles * scale));
+        rg::SyntheticScene scene;
+        scene.Generate(settings, roadTransform, road.boundsMinimum, road.boundsMaximum);
+        std::vector<CullObject> objects;
+        for (unsigned int asset = 0; asset < rg::SCENE_ASSET_COUNT; asset++) {
+            for (const rg::SceneObject &object : scene.objects[asset])
+                objects.push_back({object.transform, asset});
+        }
+
+        std::vector<unsigned int> visible;
+        auto cull = [&]() {
+            visible.clear();
+            for (unsigned int i = 0; i < objects.size(); i++) {
+                const CullObject &object = objects[i];
+                glm::vec3 center = glm::vec3(object.transform * glm::vec4(assetCenters[object.asset], 1.0f));
+                if (frustum.IntersectsSphere(center, assetRadii[object.asset] * rg::maxAxisScale(object.transform)))
+                    visible.push_back(i);
+            }
+        };
+        bench.Run("cull/" + suffix, (double) objects.size(), [&]() {
+            cull();
+            rg::doNotOptimize(visible.data());
+        });
+        cull();
+
+        auto distance = [&](unsigned int i) {
+            return glm::distance(glm::vec3(objects[i].transform[3]), camera.Position);
+        };
+        // by model to save state changes, front to back within one for early depth rejection; the
+        // bits of a positive float sort like the float
+        std::vector<DrawKey> drawKeys;
+        bench.Run("sort/state/" + suffix, (double) visible.size(), [&]() {
+            drawKeys.clear();
+            for (unsigned int i : visible) {
+                float depth = distance(i);
+                uint32_t depthBits;
+                std::memcpy(&depthBits, &depth, sizeof(depthBits));
+                drawKeys.push_back({(uint64_t) objects[i].asset << 32 | depthBits, i});
+            }
+            std::sort(drawKeys.begin(), drawKeys.end(), [](const DrawKey &a, const DrawKey &b) {
+                return a.key < b.key;
+            });
+            rg::doNotOptimize(drawKeys.data());
+        });
+        // back to front, as blended objects need it
+        std::vector<DepthKey> depthKeys;
+        bench.Run("sort/depth/" + suffix, (double) visible.size(), [&]() {
+            depthKeys.clear();
+            for (unsigned int i : visible)
+                depthKeys.push_back({distance(i), i});
+            std::sort(depthKeys.begin(), depthKeys.end(), [](const DepthKey &a, const DepthKey &b) {
+                return a.depth > b.depth;
+            });
+            rg::doNotOptimize(depthKeys.data());
+        });
+    }
+}
+
+int main(int argc, char **argv) {
+    rg::MicroBench bench;
+    std::string jsonPath, baselinePath;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--filter" && hasValue) {
+            bench.filter = argv[++i];
+        } else if (argument == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (argument == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (argument == "--min-sample-ms" && hasValue) {
+            bench.minSampleMs = std::max(std::atof(argv[++i]), 0.01);
+        } else if (argument == "--samples" && hasValue) {
+            bench.samples = std::max(std::atoi(argv[++i]), 2);
+        } else if (argument == "--max-seconds" && hasValue) {
+            bench.maxSeconds = std::atof(argv[++i]);
+        } else {
+            std::cout << "usage: bench [--filter TEXT] [--json PATH] [--baseline PATH] [--min-sample-ms MS]"
+                         " [--samples N] [--max-seconds SECONDS]" << std::endl;
+            return 2;
+        }
+    }
+    bench.minSamples = std::min(bench.minSamples, bench.samples);
+#ifndef NDEBUG
+    std::cout << "BENCH:: this is not a release build, the numbers say little about a release build" << std::endl;
+#endif
+
+    benchConvertVertices(bench);
+    benchImageDecoding(bench);
+    benchMatrices(bench);
+    benchCullingAndSorting(bench);
+
+    // the GL side only where a benchmark of it is selected, loading the models takes a while
+    bool uniforms = bench.Selected("uniform/glGetUniformLocation") || bench.Selected("uniform/glUniformMatrix4fv") ||
+                    bench.Selected("uniform/setFloat") || bench.Selected("uniform/setVec3") ||
+                    bench.Selected("uniform/setMat4");
+    bool samplerNames = false;
+    for (const char *path : MODEL_FILES)
+        samplerNames = samplerNames || bench.Selected("sampler_names/" + modelName(path));
+    rg::HeadlessContext context;
+    context.debug = false;
+    if (uniforms || samplerNames) {
+        if (!context.Create() || !gladLoadGLLoader((GLADloadproc) rg::HeadlessContext::GetProcAddress)) {
+            std::cout << "ERROR::BENCH:: no OpenGL context, skipping the uniform and sampler name benchmarks"
+                      << std::endl;
+        } else {
+            if (uniforms)
+                benchUniforms(bench);
+            if (samplerNames)
+                benchSamplerNames(bench);
+        }
+    }
+
+    if (!jsonPath.empty())
+        bench.Write(jsonPath);
+    unsigned int slower = 0;
+    if (!baselinePath.empty()) {
+        std::vector<rg::BenchResult> baseline;
+        if (!rg::MicroBench::Read(baselinePath, baseline))
+            return 2;
+        slower = bench.Compare(baseline);
+        std::cout << "BENCH:: " << slower << " benchmarks slower than " << baselinePath << std::endl;
+    }
+    return slower == 0 ? 0 : 1;
+}
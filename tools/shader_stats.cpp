@@ -0,0 +1,180 @@
+// Offline cost report of every shader variant the application compiles: ALU instructions, texture
+// fetches, register pressure and varyings per stage, see rg::ShaderCost. Runs without a window:
+//
+//   shader_stats [--backend spirv|driver] [--glslang PATH] [--glslang-args ARGS] [--json PATH]
+//                [--baseline PATH] [--tolerance PERCENT] [--verbose]
+//
+// The spirv backend compiles through glslangValidator (found by CMake, or --glslang) and analyzes the
+// SPIR-V, the same numbers on every machine. The driver backend compiles through an EGL context and
+// collects what the driver reports in the style of Mesa's shader-db, which depends on the GPU. With
+// --baseline the run is compared against an earlier --json and exits with 1 when a metric grew by more
+// than --tolerance percent (0 by default) or a variant stopped compiling. Run from the source directory.
+
+#include <glad/glad.h>
+#include <rg/HeadlessContext.h>
+#include <rg/ShaderPermutations.h>
+#include <rg/ShaderStats.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef RG_GLSLANG_VALIDATOR
+#define RG_GLSLANG_VALIDATOR ""
+#endif
+
+// keep in sync with the shaders main() compiles
+struct ShaderProgram {
+    const char *name;
+    const char *vertexPath;
+    const char *fragmentPath;
+    // permuted sources are compiled for every light mode with each feature set in variants
+    bool permuted;
+    std::vector<unsigned int> variants;
+    // the defines of a program that is not permuted
+    std::vector<std::string> defines;
+};
+
+const std::vector<ShaderProgram> &shaderPrograms() {
+    static const std::vector<ShaderProgram> programs = {
+            {"bottle", "resources/shaders/bottle.vs", "resources/shaders/bottle.fs", true,
+             {rg::SHADER_FEATURE_NONE, rg::SHADER_FEATURE_INSTANCED, rg::SHADER_FEATURE_DEBUG_VIEW,
+              rg::SHADER_FEATURE_INSTANCED | rg::SHADER_FEATURE_DEBUG_VIEW}, {}},
+            {"trash", "resources/shaders/trash.vs", "resources/shaders/trash.fs", true,
+             {rg::SHADER_FEATURE_NONE, rg::SHADER_FEATURE_GBUFFER, rg::SHADER_FEATURE_VISIBILITY,
+              rg::SHADER_FEATURE_DEBUG_VIEW}, {}},
+            {"plank", "resources/shaders/plank.vs", "resources/shaders/plank.fs", true,
+             {rg::SHADER_FEATURE_NONE, rg::SHADER_FEATURE_GBUFFER, rg::SHADER_FEATURE_DEBUG_VIEW}, {}},
+            {"impostor", "resources/shaders/impostor.vs", "resources/shaders/impostor.fs", true,
+             {rg::SHADER_FEATURE_NONE, rg::SHADER_FEATURE_GBUFFER, rg::SHADER_FEATURE_DEBUG_VIEW}, {}},
+            {"visibility_resolve", "resources/shaders/visibility_resolve.vs", "resources/shaders/visibility_resolve.fs",
+             true, {rg::SHADER_FEATURE_NONE}, {}},
+            {"skybox", "resources/shaders/skybox.vs", "resources/shaders/skybox.fs", false, {}, {}},
+            {"impostor_bake", "resources/shaders/impostor_bake.vs", "resources/shaders/impostor_bake.fs", false, {}, {}},
+            {"deferred_light", "resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs", false, {},
+             {"DIRECTIONAL"}},
+            {"deferred_light", "resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs", false, {}, {}},
+            {"debug_overdraw", "resources/shaders/debug_overdraw.vs", "resources/shaders/debug_overdraw.fs", false, {}, {}},
+            {"debug_bounds", "resources/shaders/debug_bounds.vs", "resources/shaders/debug_bounds.fs", false, {}, {}},
+            {"texture_feedback", "resources/shaders/texture_feedback.vs", "resources/shaders/texture_feedback.fs", false,
+             {}, {}},
+    };
+    return programs;
+}
+
+struct Variant {
+    std::string name;
+    const ShaderProgram *program;
+    std::vector<std::string> defines;
+};
+
+// every variant once, the unlit features compile the same source for every light mode
+std::vector<Variant> shaderVariants() {
+    std::vector<Variant> variants;
+    auto add = [&](const ShaderProgram &program, const std::vector<std::string> &defines) {
+        std::string name = program.name;
+        for (const std::string &define : defines)
+            name += " " + define;
+        for (const Variant &variant : variants) {
+            if (variant.name == name)
+                return;
+        }
+        variants.push_back({name, &program, defines});
+    };
+    for (const ShaderProgram &program : shaderPrograms()) {
+        if (!program.permuted) {
+            add(program, program.defines);
+            continue;
+        }
+        for (unsigned int features : program.variants) {
+            for (rg::LightMode light : rg::ALL_LIGHT_MODES)
+                add(program, rg::permutationDefines(light, features));
+        }
+    }
+    return variants;
+}
+
+int main(int argc, char **argv) {
+    std::string backend, glslang = RG_GLSLANG_VALIDATOR, glslangArguments, jsonPath, baselinePath;
+    double tolerance = 0.0;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--backend" && hasValue) {
+            backend = argv[++i];
+        } else if (argument == "--glslang" && hasValue) {
+            glslang = argv[++i];
+        } else if (argument == "--glslang-args" && hasValue) {
+            glslangArguments = argv[++i];
+        } else if (argument == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (argument == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (argument == "--tolerance" && hasValue) {
+            tolerance = std::atof(argv[++i]);
+        } else if (argument == "--verbose") {
+            verbose = true;
+        } else {
+            std::cout << "usage: shader_stats [--backend spirv|driver] [--glslang PATH] [--glslang-args ARGS]"
+                         " [--json PATH] [--baseline PATH] [--tolerance PERCENT] [--verbose]" << std::endl;
+            return 2;
+        }
+    }
+    if (backend.empty())
+        backend = glslang.empty() ? "driver" : "spirv";
+    if (backend != "spirv" && backend != "driver") {
+        std::cout << "ERROR::SHADER_STATS:: unknown backend " << backend << std::endl;
+        return 2;
+    }
+    if (backend == "spirv" && glslang.empty()) {
+        std::cout << "ERROR::SHADER_STATS:: glslangValidator was not found, pass --glslang PATH" << std::endl;
+        return 2;
+    }
+
+    // the driver backend needs a debug context and shaders that are really compiled
+    rg::HeadlessContext context;
+    rg::DriverShaderStats driverStats;
+    driverStats.verbose = verbose;
+    if (backend == "driver") {
+        setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+        context.debug = true;
+        if (!context.Create() || !gladLoadGLLoader((GLADloadproc) rg::HeadlessContext::GetProcAddress) ||
+            !driverStats.Begin())
+            return 2;
+    }
+
+    std::vector<rg::ShaderCost> costs;
+    bool compiled = true;
+    for (const Variant &variant : shaderVariants()) {
+        std::string vertexSource = Shader::injectDefines(readFileContents(variant.program->vertexPath), variant.defines);
+        std::string fragmentSource = Shader::injectDefines(readFileContents(variant.program->fragmentPath),
+                                                           variant.defines);
+        rg::ShaderCost vertex, fragment;
+        vertex.name = fragment.name = variant.name;
+        vertex.stage = "vertex";
+        fragment.stage = "fragment";
+        if (backend == "spirv") {
+            compiled = rg::spirvShaderCost(glslang, glslangArguments, vertexSource, "vertex", vertex) && compiled;
+            compiled = rg::spirvShaderCost(glslang, glslangArguments, fragmentSource, "fragment", fragment) && compiled;
+        } else {
+            compiled = driverStats.Compile(vertexSource, fragmentSource, vertex, fragment) && compiled;
+        }
+        costs.push_back(vertex);
+        costs.push_back(fragment);
+    }
+    rg::printShaderCosts(costs);
+    if (!jsonPath.empty())
+        rg::writeShaderCosts(jsonPath, backend, costs);
+
+    unsigned int regressions = 0;
+    if (!baselinePath.empty()) {
+        std::vector<rg::ShaderCost> baseline;
+        if (!rg::readShaderCosts(baselinePath, baseline))
+            return 2;
+        regressions = rg::compareShaderCosts(baseline, costs, tolerance);
+        std::cout << "SHADER_STATS:: " << regressions << " regressions against " << baselinePath << std::endl;
+    }
+    return compiled && regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,693 @@
+// Renders the synthetic scene along the camera path once per draw submission strategy and reports
+// the CPU time of submitting a frame and its GPU time, to choose the default with numbers. Runs
+// headless through rg::HeadlessContext, on Mesa llvmpipe as well as on a real driver:
+//
+//   submit_bench [--scene SPEC] [--strategies NAME,...] [--width W] [--height H] [--warmup N]
+//                [--frames N] [--path CAMERA_PATH] [--json PATH]
+//
+//   naive         what the app does: per object and mesh Model::Draw, every uniform and sampler looked
+//                 up by name
+//   state_sorted  mesh by mesh, its vertex array and textures bound once for all objects, the model
+//                 matrix uploaded to a cached location
+//   ubo           state_sorted with the model matrices of all objects in one uniform buffer, a range
+//                 of it bound per draw
+//   instanced     one glDrawElementsInstanced per mesh through Model::DrawInstanced
+//   base_vertex   every mesh in one vertex and element buffer, one vertex array for the whole frame,
+//                 glDrawElementsBaseVertex with the constants of ubo
+//   mdi           the buffers of base_vertex with one glMultiDrawElementsIndirect per texture set, the
+//                 matrices as instance attributes offset by baseInstance; needs GL 4.3 or
+//                 ARB_multi_draw_indirect and is skipped without
+//
+// The CPU time covers the frame's GL calls from the first uniform to the last draw, culling is done
+// before and is the same for all. The GPU is idled with glFinish after every frame, so a full command
+// queue never shows up as submit time, and the time until glFinish returns is reported as well:
+// llvmpipe answers the timer queries before it rasterizes, so there the GPU time is close to zero and
+// the time until idle is the number to compare; it also bins the triangles inside the draw calls, so
+// its submit time includes part of the rasterization. Every strategy draws the full detail
+// meshes without impostors. The last frame is read back and compared with the one of naive, a
+// strategy that draws something else shows differing pixels.
+
+#include <glad/glad.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <rg/Benchmark.h>
+#include <rg/Frustum.h>
+#include <rg/GpuProfiler.h>
+#include <rg/HeadlessContext.h>
+#include <rg/MicroBench.h>
+#include <rg/ShaderPermutations.h>
+#include <rg/SyntheticScene.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// glMultiDrawElementsIndirect is GL 4.3, beyond the 3.3 core glad is generated for
+typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect,
+                                                       GLsizei drawcount, GLsizei stride);
+
+enum Strategy {
+    STRATEGY_NAIVE,
+    STRATEGY_STATE_SORTED,
+    STRATEGY_UBO,
+    STRATEGY_INSTANCED,
+    STRATEGY_BASE_VERTEX,
+    STRATEGY_MDI,
+    STRATEGY_COUNT
+};
+
+const char *const STRATEGY_NAMES[STRATEGY_COUNT] = {"naive", "state_sorted", "ubo", "instanced", "base_vertex",
+                                                    "mdi"};
+
+// the trash shader variants the strategies draw with
+enum Program {
+    PROGRAM_UNIFORM,
+    PROGRAM_UBO,
+    PROGRAM_INSTANCED,
+    PROGRAM_COUNT
+};
+
+const Program STRATEGY_PROGRAMS[STRATEGY_COUNT] = {PROGRAM_UNIFORM, PROGRAM_UNIFORM, PROGRAM_UBO, PROGRAM_INSTANCED,
+                                                   PROGRAM_UBO, PROGRAM_INSTANCED};
+
+// binding point of the ObjectConstants block of trash.vs
+const unsigned int OBJECT_CONSTANTS_BINDING = 1;
+
+// keep in sync with the scene models main() loads, indexed by rg::SceneAsset
+const char *const SCENE_ASSET_FILES[rg::SCENE_ASSET_COUNT] = {
+        "resources/objects/old_coca_cola_can/scene.gltf",
+        "resources/objects/plastic_water_bottle/scene.gltf",
+        "resources/objects/oil_barrel/scene.gltf",
+        "resources/objects/trash_bag/scene.gltf",
+        "resources/objects/oak/Oak.obj",
+        "resources/objects/rusty_streetlight/Light Pole.obj",
+};
+
+// DrawElementsIndirectCommand of the GL specification
+struct IndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// one model and every place the scene puts it
+struct DrawGroup {
+    std::unique_ptr<Model> model;
+    std::vector<glm::mat4> transforms;
+    // the transforms that survived culling this frame
+    std::vector<glm::mat4> visible;
+    // index of the first visible one among the visible objects of all groups
+    unsigned int firstObject = 0;
+};
+
+// textures bound together, with the sampler locations per program
+struct TextureSet {
+    std::vector<unsigned int> textures;
+    std::vector<std::string> samplers;
+    std::vector<int> locations[PROGRAM_COUNT];
+};
+
+// a mesh of a group with its range in the merged buffers
+struct SubmitMesh {
+    unsigned int group;
+    Mesh *mesh;
+    unsigned int textureSet;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+};
+
+struct StrategyResult {
+    bool available = false;
+    double drawCalls = 0.0;
+    rg::BenchResult submit;
+    rg::FrameTimePercentiles submitMs;
+    rg::FrameTimePercentiles gpuMs;
+    // from the start of the submission until glFinish returned
+    rg::FrameTimePercentiles frameMs;
+    // of the last frame against the one of naive, negative when there is nothing to compare with
+    double differingPixels = -1.0;
+};
+
+class Submitter {
+public:
+    std::vector<DrawGroup> groups;
+    std::vector<SubmitMesh> meshes;
+    std::vector<TextureSet> textureSets;
+    std::unique_ptr<Shader> programs[PROGRAM_COUNT];
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+
+    Submitter() = default;
+    Submitter(const Submitter &) = delete;
+    Submitter &operator=(const Submitter &) = delete;
+
+    // the groups have to be filled
+    void Setup() {
+        for (unsigned int program = 0; program < PROGRAM_COUNT; program++) {
+            std::vector<std::string> defines = rg::permutationDefines(
+                    rg::LightMode::Directional,
+                    program == PROGRAM_INSTANCED ? rg::SHADER_FEATURE_INSTANCED : rg::SHADER_FEATURE_NONE);
+            if (program == PROGRAM_UBO)
+                defines.push_back("OBJECT_UBO");
+            programs[program].reset(new Shader("resources/shaders/trash.vs", "resources/shaders/trash.fs", defines));
+        }
+        unsigned int blockIndex = glGetUniformBlockIndex(programs[PROGRAM_UBO]->ID, "ObjectConstants");
+        glUniformBlockBinding(programs[PROGRAM_UBO]->ID, blockIndex, OBJECT_CONSTANTS_BINDING);
+        modelLocation = glGetUniformLocation(programs[PROGRAM_UNIFORM]->ID, "model");
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        constantsStride = ((sizeof(glm::mat4) + alignment - 1) / alignment) * alignment;
+
+        // the meshes of one texture set next to each other, so mdi needs one call per set
+        std::map<std::string, unsigned int> setIndex;
+        vector<string> samplers;
+        for (unsigned int group = 0; group < groups.size(); group++) {
+            for (Mesh &mesh : groups[group].model->meshes) {
+                mesh.SamplerNames(samplers);
+                std::ostringstream key;
+                for (unsigned int i = 0; i < mesh.textures.size(); i++)
+                    key << mesh.textures[i].id << " " << samplers[i] << " ";
+                auto found = setIndex.find(key.str());
+                if (found == setIndex.end()) {
+                    found = setIndex.emplace(key.str(), (unsigned int) textureSets.size()).first;
+                    textureSets.emplace_back();
+                    TextureSet &set = textureSets.back();
+                    for (const Texture &texture : mesh.textures)
+                        set.textures.push_back(texture.id);
+                    set.samplers = samplers;
+                    for (unsigned int program = 0; program < PROGRAM_COUNT; program++) {
+                        for (const std::string &sampler : samplers)
+                            set.locations[program].push_back(
+                                    glGetUniformLocation(programs[program]->ID, sampler.c_str()));
+                    }
+                }
+                meshes.push_back({group, &mesh, found->second, 0, mesh.lods[0].indexCount, 0});
+            }
+        }
+        std::stable_sort(meshes.begin(), meshes.end(), [](const SubmitMesh &a, const SubmitMesh &b) {
+            return a.textureSet < b.textureSet;
+        });
+        setupMergedBuffers();
+        glGenBuffers(1, &constantsBuffer);
+        glGenBuffers(1, &indirectBuffer);
+    }
+
+    // culls every group against the frustum, the same work for every strategy
+    void Cull(const rg::Frustum &frustum) {
+        unsigned int objects = 0;
+        for (DrawGroup &group : groups) {
+            group.visible.clear();
+            group.firstObject = objects;
+            for (const glm::mat4 &transform : group.transforms) {
+                glm::vec3 center = glm::vec3(transform * glm::vec4(group.model->boundsCenter, 1.0f));
+                if (frustum.IntersectsSphere(center, group.model->boundsRadius * rg::maxAxisScale(transform)))
+                    group.visible.push_back(transform);
+            }
+            objects += (unsigned int) group.visible.size();
+        }
+        visibleObjects = objects;
+    }
+
+    // the GL calls of one frame, returns the draw calls made
+    unsigned int Submit(Strategy strategy, const Camera &camera, const glm::mat4 &view, const glm::mat4 &projection) {
+        Shader &shader = *programs[STRATEGY_PROGRAMS[strategy]];
+        setFrameUniforms(shader, camera, view, projection);
+        switch (strategy) {
+            case STRATEGY_NAIVE: return submitNaive(shader);
+            case STRATEGY_STATE_SORTED: return submitStateSorted();
+            case STRATEGY_UBO: return submitConstants(false);
+            case STRATEGY_INSTANCED: return submitInstanced(shader);
+            case STRATEGY_BASE_VERTEX: return submitConstants(true);
+            case STRATEGY_MDI: return submitIndirect();
+            default: return 0;
+        }
+    }
+
+private:
+    int modelLocation = -1;
+    size_t constantsStride = 256;
+    unsigned int visibleObjects = 0;
+    unsigned int mergedVAO = 0, indirectVAO = 0, mergedVBO = 0, mergedEBO = 0;
+    unsigned int constantsBuffer = 0, instanceBuffer = 0, indirectBuffer = 0;
+    std::vector<unsigned char> constants;
+    std::vector<InstanceData> instances;
+    std::vector<IndirectCommand> commands;
+
+    void setupMergedBuffers() {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (SubmitMesh &mesh : meshes) {
+            mesh.baseVertex = (int) vertices.size();
+            mesh.firstIndex = (unsigned int) indices.size();
+            vertices.insert(vertices.end(), mesh.mesh->vertices.begin(), mesh.mesh->vertices.end());
+            // the full detail level, the coarser ones follow it in the elements
+            indices.insert(indices.end(), mesh.mesh->elements.begin(),
+                           mesh.mesh->elements.begin() + mesh.mesh->lods[0].indexCount);
+        }
+        glGenBuffers(1, &mergedVBO);
+        glGenBuffers(1, &mergedEBO);
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, mergedVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the layout of Mesh::setupMesh, the indirect one adds the instance attributes of Mesh
+        unsigned int *vaos[] = {&mergedVAO, &indirectVAO};
+        for (unsigned int *vao : vaos) {
+            glGenVertexArrays(1, vao);
+            glBindVertexArray(*vao);
+            glBindBuffer(GL_ARRAY_BUFFER, mergedVBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mergedEBO);
+            if (vao == &mergedVAO)
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(),
+                             GL_STATIC_DRAW);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) 0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, Normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, TexCoords));
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, Tangent));
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, Bitangent));
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void *) (offsetof(InstanceData, ModelMatrix) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        for (unsigned int i = 0; i < 3; i++) {
+            glEnableVertexAttribArray(9 + i);
+            glVertexAttribPointer(9 + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void *) (offsetof(InstanceData, NormalMatrix) + i * sizeof(glm::vec3)));
+            glVertexAttribDivisor(9 + i, 1);
+        }
+        glEnableVertexAttribArray(12);
+        glVertexAttribPointer(12, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *) offsetof(InstanceData, Tint));
+        glVertexAttribDivisor(12, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void setFrameUniforms(Shader &shader, const Camera &camera, const glm::mat4 &view, const glm::mat4 &projection) {
+        shader.use();
+        shader.setVec3("dirLight.direction", glm::vec3(1.0, -2.0, 0.5));
+        shader.setVec3("dirLight.ambient", glm::vec3(0.05, 0.05, -0.05));
+        shader.setVec3("dirLight.diffuse", glm::vec3(0.6, 0.6, 0.6));
+        shader.setVec3("dirLight.specular", glm::vec3(0.5, 0.5, 0.5));
+        shader.setVec3("viewPos", camera.Position);
+        shader.setFloat("material.shininess", 32.0f);
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+    }
+
+    void bindTextureSet(const TextureSet &set, Program program) {
+        for (unsigned int i = 0; i < set.textures.size(); i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glUniform1i(set.locations[program][i], i);
+            glBindTexture(GL_TEXTURE_2D, set.textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    unsigned int submitNaive(Shader &shader) {
+        unsigned int draws = 0;
+        for (DrawGroup &group : groups) {
+            for (const glm::mat4 &transform : group.visible) {
+                shader.setMat4("model", transform);
+                group.model->Draw(shader);
+                draws += (unsigned int) group.model->meshes.size();
+            }
+        }
+        return draws;
+    }
+
+    unsigned int submitStateSorted() {
+        unsigned int draws = 0;
+        for (const SubmitMesh &mesh : meshes) {
+            const DrawGroup &group = groups[mesh.group];
+            if (group.visible.empty())
+                continue;
+            bindTextureSet(textureSets[mesh.textureSet], PROGRAM_UNIFORM);
+            glBindVertexArray(mesh.mesh->VAO);
+            for (const glm::mat4 &transform : group.visible) {
+                glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &transform[0][0]);
+                glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, (void *) 0);
+                draws++;
+            }
+        }
+        glBindVertexArray(0);
+        return draws;
+    }
+
+    // the model matrices of every visible object, one aligned block each
+    void uploadConstants() {
+        constants.resize(std::max<size_t>(visibleObjects, 1) * constantsStride);
+        for (const DrawGroup &group : groups) {
+            for (unsigned int i = 0; i < group.visible.size(); i++)
+                std::memcpy(&constants[(group.firstObject + i) * constantsStride], &group.visible[i][0][0],
+                            sizeof(glm::mat4));
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, constantsBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, constants.size(), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, constants.size(), constants.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // ubo, and base_vertex when merged
+    unsigned int submitConstants(bool merged) {
+        uploadConstants();
+        unsigned int draws = 0;
+        if (merged)
+            glBindVertexArray(mergedVAO);
+        for (const SubmitMesh &mesh : meshes) {
+            const DrawGroup &group = groups[mesh.group];
+            if (group.visible.empty())
+                continue;
+            bindTextureSet(textureSets[mesh.textureSet], PROGRAM_UBO);
+            if (!merged)
+                glBindVertexArray(mesh.mesh->VAO);
+            for (unsigned int i = 0; i < group.visible.size(); i++) {
+                glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_CONSTANTS_BINDING, constantsBuffer,
+                                  (GLintptr) ((group.firstObject + i) * constantsStride), sizeof(glm::mat4));
+                if (merged)
+                    glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+                                             (void *) (mesh.firstIndex * sizeof(unsigned int)), mesh.baseVertex);
+                else
+                    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, (void *) 0);
+                draws++;
+            }
+        }
+        glBindVertexArray(0);
+        return draws;
+    }
+
+    unsigned int submitInstanced(Shader &shader) {
+        unsigned int draws = 0;
+        for (DrawGroup &group : groups) {
+            if (group.visible.empty())
+                continue;
+            instances.clear();
+            for (const glm::mat4 &transform : group.visible)
+                instances.push_back(makeInstance(transform));
+            group.model->DrawInstanced(shader, instances);
+            draws += (unsigned int) group.model->meshes.size();
+        }
+        return draws;
+    }
+
+    unsigned int submitIndirect() {
+        instances.clear();
+        for (const DrawGroup &group : groups) {
+            for (const glm::mat4 &transform : group.visible)
+                instances.push_back(makeInstance(transform));
+        }
+        if (instances.empty())
+            return 0;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // one command per visible object and mesh, the meshes are ordered by texture set
+        commands.clear();
+        std::vector<std::pair<unsigned int, size_t>> setStarts;
+        for (const SubmitMesh &mesh : meshes) {
+            const DrawGroup &group = groups[mesh.group];
+            if (group.visible.empty())
+                continue;
+            if (setStarts.empty() || setStarts.back().first != mesh.textureSet)
+                setStarts.emplace_back(mesh.textureSet, commands.size());
+            for (unsigned int i = 0; i < group.visible.size(); i++)
+                commands.push_back({mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, group.firstObject + i});
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(IndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(IndirectCommand), commands.data());
+
+        glBindVertexArray(indirectVAO);
+        for (size_t i = 0; i < setStarts.size(); i++) {
+            size_t end = i + 1 < setStarts.size() ? setStarts[i + 1].second : commands.size();
+            bindTextureSet(textureSets[setStarts[i].first], PROGRAM_INSTANCED);
+            multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                      (void *) (setStarts[i].second * sizeof(IndirectCommand)),
+                                      (GLsizei) (end - setStarts[i].second), 0);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return (unsigned int) setStarts.size();
+    }
+};
+
+bool hasExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void readPixels(const rg::OffscreenTarget &target, std::vector<unsigned char> &pixels) {
+    pixels.resize((size_t) target.width * target.height * 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// share of the pixels with a channel off by more than a rounding difference
+double differingPixels(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b) {
+    if (a.size() != b.size() || a.empty())
+        return -1.0;
+    size_t differing = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        for (size_t c = 0; c < 3; c++) {
+            if (std::abs((int) a[i + c] - (int) b[i + c]) > 2) {
+                differing++;
+                break;
+            }
+        }
+    }
+    return (double) differing / (a.size() / 4);
+}
+
+int main(int argc, char **argv) {
+    rg::BenchmarkSettings settings;
+    settings.headless = true;
+    settings.warmupFrames = 20;
+    settings.measuredFrames = 200;
+    std::string sceneSpec, strategyList, jsonPath = "submit_bench.json";
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--scene" && hasValue) {
+            sceneSpec = argv[++i];
+        } else if (argument == "--strategies" && hasValue) {
+            strategyList = argv[++i];
+        } else if (argument == "--width" && hasValue) {
+            settings.width = std::atoi(argv[++i]);
+        } else if (argument == "--height" && hasValue) {
+            settings.height = std::atoi(argv[++i]);
+        } else if (argument == "--warmup" && hasValue) {
+            settings.warmupFrames = (unsigned int) std::atoi(argv[++i]);
+        } else if (argument == "--frames" && hasValue) {
+            settings.measuredFrames = (unsigned int) std::atoi(argv[++i]);
+        } else if (argument == "--path" && hasValue) {
+            settings.cameraPath = argv[++i];
+        } else if (argument == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else {
+            std::cout << "usage: submit_bench [--scene SPEC] [--strategies NAME,...] [--width W] [--height H]"
+                         " [--warmup N] [--frames N] [--path CAMERA_PATH] [--json PATH]" << std::endl;
+            return 2;
+        }
+    }
+    bool selected[STRATEGY_COUNT] = {};
+    std::istringstream names(strategyList);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        bool known = false;
+        for (unsigned int i = 0; i < STRATEGY_COUNT; i++) {
+            if (name == STRATEGY_NAMES[i])
+                selected[i] = known = true;
+        }
+        if (!known) {
+            std::cout << "ERROR::SUBMIT_BENCH:: unknown strategy " << name << std::endl;
+            return 2;
+        }
+    }
+    if (strategyList.empty())
+        std::fill(selected, selected + STRATEGY_COUNT, true);
+    rg::SyntheticSceneSettings sceneSettings;
+    if (settings.width <= 0 || settings.height <= 0 || settings.measuredFrames == 0 ||
+        (!sceneSpec.empty() && !rg::parseSyntheticScene(sceneSpec, sceneSettings)))
+        return 2;
+
+    rg::HeadlessContext context;
+    context.debug = false;
+    if (!context.Create() || !gladLoadGLLoader((GLADloadproc) rg::HeadlessContext::GetProcAddress))
+        return 2;
+    const char *renderer = (const char *) glGetString(GL_RENDERER);
+    const char *version = (const char *) glGetString(GL_VERSION);
+    std::cout << "SUBMIT_BENCH:: " << (renderer ? renderer : "") << ", " << (version ? version : "") << std::endl;
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    Submitter submitter;
+    if (major * 10 + minor >= 43 || (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance")))
+        submitter.multiDrawElementsIndirect = (MultiDrawElementsIndirectProc) rg::HeadlessContext::GetProcAddress(
+                "glMultiDrawElementsIndirect");
+    if (!submitter.multiDrawElementsIndirect && selected[STRATEGY_MDI]) {
+        std::cout << "SUBMIT_BENCH:: no multi-draw indirect, skipping mdi" << std::endl;
+        selected[STRATEGY_MDI] = false;
+    }
+
+    rg::OffscreenTarget target;
+    rg::Benchmark benchmark(settings);
+    if (!target.Create(settings.width, settings.height) || !benchmark.Load())
+        return 2;
+
+    // the road as main() places it, the synthetic scene tiles it
+    glm::mat4 roadTransform = glm::mat4(1.0f);
+    roadTransform = glm::rotate(roadTransform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    roadTransform = glm::scale(roadTransform, glm::vec3(0.0025f));
+    submitter.groups.resize(rg::SCENE_ASSET_COUNT + 1);
+    DrawGroup &road = submitter.groups[rg::SCENE_ASSET_COUNT];
+    road.model.reset(new Model("resources/objects/dusty_road/scene.gltf"));
+    rg::SyntheticScene scene;
+    scene.Generate(sceneSettings, roadTransform, road.model->boundsMinimum, road.model->boundsMaximum);
+    road.transforms = scene.roadTiles;
+    road.transforms.push_back(roadTransform);
+    unsigned int objects = 0;
+    for (unsigned int asset = 0; asset < rg::SCENE_ASSET_COUNT; asset++) {
+        DrawGroup &group = submitter.groups[asset];
+        group.model.reset(new Model(SCENE_ASSET_FILES[asset]));
+        for (const rg::SceneObject &object : scene.objects[asset])
+            group.transforms.push_back(object.transform);
+        objects += (unsigned int) group.transforms.size();
+    }
+    for (DrawGroup &group : submitter.groups)
+        group.model->SetShaderTextureNamePrefix("material.");
+    submitter.Setup();
+    std::cout << "SUBMIT_BENCH:: " << objects << " objects, " << submitter.meshes.size() << " meshes, "
+              << submitter.textureSets.size() << " texture sets" << std::endl;
+
+    rg::GpuProfiler profiler;
+    profiler.waitForResults = true;
+    profiler.historyFrames = settings.measuredFrames;
+    glEnable(GL_DEPTH_TEST);
+    StrategyResult results[STRATEGY_COUNT];
+    std::vector<unsigned char> naivePixels, pixels;
+    for (unsigned int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+        if (!selected[strategy])
+            continue;
+        benchmark.Restart(profiler.FrameNumber());
+        std::vector<float> submitMs, frameMs;
+        std::vector<double> submitNs;
+        unsigned long long drawCalls = 0;
+        Camera camera;
+        while (benchmark.Running()) {
+            benchmark.BeginFrame(camera);
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
+                                                    (float) settings.width / (float) settings.height, 0.1f, 100.0f);
+            glm::mat4 view = camera.GetViewMatrix();
+            submitter.Cull(rg::Frustum(projection * view));
+            target.Bind();
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            profiler.BeginFrame();
+            auto start = std::chrono::steady_clock::now();
+            unsigned int draws = submitter.Submit((Strategy) strategy, camera, view, projection);
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            profiler.EndFrame();
+            glFinish();
+            std::chrono::duration<float, std::milli> frame = std::chrono::steady_clock::now() - start;
+            if (benchmark.Measuring()) {
+                submitNs.push_back(elapsed.count());
+                submitMs.push_back((float) (elapsed.count() / 1e6));
+                frameMs.push_back(frame.count());
+                drawCalls += draws;
+            }
+            benchmark.EndFrame();
+        }
+        profiler.Drain();
+
+        StrategyResult &result = results[strategy];
+        result.available = true;
+        result.drawCalls = (double) drawCalls / std::max<size_t>(submitMs.size(), 1);
+        result.submit = rg::benchStatistics(STRATEGY_NAMES[strategy], submitNs, 1, result.drawCalls);
+        result.submitMs = rg::framePercentiles(submitMs);
+        result.gpuMs = benchmark.GpuFrameMs(profiler);
+        result.frameMs = rg::framePercentiles(frameMs);
+        readPixels(target, pixels);
+        if (strategy == STRATEGY_NAIVE)
+            naivePixels = pixels;
+        result.differingPixels = differingPixels(naivePixels, pixels);
+        std::cout << "SUBMIT_BENCH:: " << std::left << std::setw(13) << STRATEGY_NAMES[strategy] << std::right
+                  << std::fixed << std::setprecision(3) << " submit " << result.submit.mean / 1e6 << " ms +- "
+                  << (result.submit.ciHigh - result.submit.mean) / 1e6 << " (p95 " << result.submitMs.p95
+                  << "), gpu " << result.gpuMs.mean << " ms (p95 " << result.gpuMs.p95 << "), until idle "
+                  << result.frameMs.mean << " ms, "
+                  << std::setprecision(0) << result.drawCalls << " draw calls";
+        if (result.differingPixels >= 0.0)
+            std::cout << std::setprecision(2) << ", " << result.differingPixels * 100.0 << "% pixels differ";
+        std::cout << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+    }
+
+    std::ofstream out(jsonPath);
+    if (!out) {
+        std::cout << "ERROR::SUBMIT_BENCH:: could not write " << jsonPath << std::endl;
+        return 1;
+    }
+    out << "{\n"
+        << "  \"renderer\": " << rg::Benchmark::jsonString(renderer ? renderer : "") << ",\n"
+        << "  \"version\": " << rg::Benchmark::jsonString(version ? version : "") << ",\n"
+        << "  \"width\": " << settings.width << ",\n"
+        << "  \"height\": " << settings.height << ",\n"
+        << "  \"warmup_frames\": " << settings.warmupFrames << ",\n"
+        << "  \"measured_frames\": " << settings.measuredFrames << ",\n"
+        << "  \"objects\": " << objects << ",\n"
+        << "  \"strategies\": [";
+    bool first = true;
+    for (unsigned int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+        const StrategyResult &result = results[strategy];
+        if (!result.available)
+            continue;
+        out << (first ? "" : ",") << "\n    {\"name\": \"" << STRATEGY_NAMES[strategy] << "\", \"draw_calls\": "
+            << result.drawCalls << ", \"submit_mean_ms\": " << result.submit.mean / 1e6
+            << ", \"submit_ci95_low_ms\": " << result.submit.ciLow / 1e6 << ", \"submit_ci95_high_ms\": "
+            << result.submit.ciHigh / 1e6 << ", \"submit_p95_ms\": " << result.submitMs.p95 << ", \"gpu_mean_ms\": "
+            << result.gpuMs.mean << ", \"gpu_p95_ms\": " << result.gpuMs.p95 << ", \"frame_mean_ms\": " << result.frameMs.mean
+            << ", \"frame_p95_ms\": " << result.frameMs.p95 << ", \"differing_pixels\": "
+            << result.differingPixels << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+    std::cout << "SUBMIT_BENCH:: wrote " << jsonPath << std::endl;
+    return 0;
+}